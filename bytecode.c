@@ -3,17 +3,21 @@
 
 PICCOLO_DYNARRAY_IMPL(uint8_t, Byte)
 PICCOLO_DYNARRAY_IMPL(int, Int)
+PICCOLO_DYNARRAY_IMPL(struct piccolo_InlineCache, InlineCache)
 
 void piccolo_initBytecode(struct piccolo_Bytecode* bytecode) {
     piccolo_initByteArray(&bytecode->code);
     piccolo_initIntArray(&bytecode->charIdxs);
     piccolo_initValueArray(&bytecode->constants);
+    piccolo_initInlineCacheArray(&bytecode->caches);
+    bytecode->maxStack = 0;
 }
 
 void piccolo_freeBytecode(struct piccolo_Engine* engine, struct piccolo_Bytecode* bytecode) {
     piccolo_freeByteArray(engine, &bytecode->code);
     piccolo_freeIntArray(engine, &bytecode->charIdxs);
     piccolo_freeValueArray(engine, &bytecode->constants);
+    piccolo_freeInlineCacheArray(engine, &bytecode->caches);
 }
 
 void piccolo_writeBytecode(struct piccolo_Engine* engine, struct piccolo_Bytecode* bytecode, uint8_t byte, int charIdx) {
@@ -21,12 +25,16 @@ void piccolo_writeBytecode(struct piccolo_Engine* engine, struct piccolo_Bytecod
     piccolo_writeIntArray(engine, &bytecode->charIdxs, charIdx);
 }
 
-void piccolo_writeParameteredBytecode(struct piccolo_Engine* engine, struct piccolo_Bytecode* bytecode, uint8_t byte, uint16_t param, int charIdx) {
-    piccolo_writeBytecode(engine, bytecode, byte, charIdx);
+void piccolo_writeParam(struct piccolo_Engine* engine, struct piccolo_Bytecode* bytecode, uint16_t param, int charIdx) {
     piccolo_writeBytecode(engine, bytecode, (param & 0xFF00) >> 8, charIdx);
     piccolo_writeBytecode(engine, bytecode, (param & 0x00FF) >> 0, charIdx);
 }
 
+void piccolo_writeParameteredBytecode(struct piccolo_Engine* engine, struct piccolo_Bytecode* bytecode, uint8_t byte, uint16_t param, int charIdx) {
+    piccolo_writeBytecode(engine, bytecode, byte, charIdx);
+    piccolo_writeParam(engine, bytecode, param, charIdx);
+}
+
 int piccolo_writeConst(struct piccolo_Engine* engine, struct piccolo_Bytecode* bytecode, piccolo_Value constant, int charIdx) {
     int constIdx = bytecode->constants.count;
     piccolo_writeValueArray(engine, &bytecode->constants, constant);
@@ -34,6 +42,14 @@ int piccolo_writeConst(struct piccolo_Engine* engine, struct piccolo_Bytecode* b
     return constIdx;
 }
 
+int piccolo_addInlineCache(struct piccolo_Engine* engine, struct piccolo_Bytecode* bytecode) {
+    struct piccolo_InlineCache cache;
+    cache.key = NULL;
+    cache.slot = 0;
+    piccolo_writeInlineCacheArray(engine, &bytecode->caches, cache);
+    return bytecode->caches.count - 1;
+}
+
 void piccolo_patchParam(struct piccolo_Bytecode* bytecode, int addr, uint16_t param) {
     bytecode->code.values[addr + 1] = (param & 0xFF00) >> 8;
     bytecode->code.values[addr + 2] = (param & 0x00FF) >> 0;
@@ -14,15 +14,18 @@ enum piccolo_OpCode {
     PICCOLO_OP_ADD, PICCOLO_OP_SUB, PICCOLO_OP_MUL, PICCOLO_OP_DIV, PICCOLO_OP_MOD,
     PICCOLO_OP_EQUAL, PICCOLO_OP_GREATER, PICCOLO_OP_LESS,
     PICCOLO_OP_NEGATE, PICCOLO_OP_NOT,
+    PICCOLO_OP_BIT_AND, PICCOLO_OP_BIT_OR, PICCOLO_OP_BIT_XOR, PICCOLO_OP_SHIFT_LEFT, PICCOLO_OP_SHIFT_RIGHT, PICCOLO_OP_BIT_NOT,
 
     PICCOLO_OP_POP_STACK,
     PICCOLO_OP_PEEK_STACK,
     PICCOLO_OP_SWAP_STACK,
 
     PICCOLO_OP_CREATE_ARRAY,
+    PICCOLO_OP_UNPACK,
     PICCOLO_OP_CREATE_RANGE,
     PICCOLO_OP_GET_IDX,
     PICCOLO_OP_SET_IDX,
+    PICCOLO_OP_GET_MEMBER,
 
     PICCOLO_OP_HASHMAP,
 
@@ -30,7 +33,6 @@ enum piccolo_OpCode {
     PICCOLO_OP_SET_GLOBAL,
     PICCOLO_OP_GET_LOCAL,
     PICCOLO_OP_SET_LOCAL,
-    PICCOLO_OP_PUSH_LOCAL,
     PICCOLO_OP_POP_LOCALS,
 
     PICCOLO_OP_JUMP,
@@ -39,6 +41,9 @@ enum piccolo_OpCode {
     PICCOLO_OP_REV_JUMP_FALSE,
 
     PICCOLO_OP_CALL,
+    PICCOLO_OP_TAIL_CALL,
+    PICCOLO_OP_INVOKE,
+    PICCOLO_OP_RETURN_VALUES,
 
     PICCOLO_OP_CLOSURE,
     PICCOLO_OP_GET_UPVAL,
@@ -47,30 +52,68 @@ enum piccolo_OpCode {
 
     PICCOLO_OP_GET_LEN,
     PICCOLO_OP_APPEND,
+    PICCOLO_OP_ACC_CREATE,
+    PICCOLO_OP_ACC_APPEND,
     PICCOLO_OP_IN,
     PICCOLO_OP_ITER_FIRST,
     PICCOLO_OP_ITER_CONT,
     PICCOLO_OP_ITER_NEXT,
     PICCOLO_OP_ITER_GET,
+    PICCOLO_OP_RANGE_FIRST,
+
+    PICCOLO_OP_EXECUTE_PACKAGE,
+
+    // Written over the generic instruction by the engine once its operands have been numbers
+    PICCOLO_OP_ADD_NUM_NUM, PICCOLO_OP_SUB_NUM_NUM, PICCOLO_OP_MUL_NUM_NUM, PICCOLO_OP_DIV_NUM_NUM,
+    PICCOLO_OP_GREATER_NUM_NUM, PICCOLO_OP_LESS_NUM_NUM,
+
+    // Superinstructions, see piccolo_fuseInstructions
+    PICCOLO_OP_ADD_CONST_LOCAL, PICCOLO_OP_ADD_CONST_GLOBAL,
+    PICCOLO_OP_LESS_JUMP_FALSE, PICCOLO_OP_GREATER_JUMP_FALSE,
+    PICCOLO_OP_NOT_EQUAL,
+    PICCOLO_OP_ITER_LOOP,
+
+    // Register forms, emitted by PICCOLO_BACKEND_REGISTER. Operands are local slots, or constants if PICCOLO_REG_CONST_BIT is set
+    PICCOLO_OP_REG_MOVE,
+    PICCOLO_OP_REG_ADD, PICCOLO_OP_REG_SUB, PICCOLO_OP_REG_MUL, PICCOLO_OP_REG_DIV, PICCOLO_OP_REG_MOD,
+    PICCOLO_OP_REG_LESS_JUMP_FALSE, PICCOLO_OP_REG_LESS_EQ_JUMP_FALSE,
+    PICCOLO_OP_REG_GREATER_JUMP_FALSE, PICCOLO_OP_REG_GREATER_EQ_JUMP_FALSE,
+    PICCOLO_OP_REG_EQUAL_JUMP_FALSE, PICCOLO_OP_REG_NOT_EQUAL_JUMP_FALSE
+};
+
+#define PICCOLO_REG_CONST_BIT 0x8000
 
-    PICCOLO_OP_EXECUTE_PACKAGE
+/*
+    Remembers how GET_MEMBER or INVOKE resolved a name for the last receiver it saw. key is the
+    package, or the property or method table of a native struct, and slot is the global slot,
+    payload offset or method index.
+ */
+struct piccolo_InlineCache {
+    const void* key;
+    int slot;
 };
 
 PICCOLO_DYNARRAY_HEADER(uint8_t, Byte)
 PICCOLO_DYNARRAY_HEADER(int, Int)
+PICCOLO_DYNARRAY_HEADER(struct piccolo_InlineCache, InlineCache)
 
 struct piccolo_Bytecode {
     struct piccolo_ByteArray code;
     struct piccolo_IntArray charIdxs;
     struct piccolo_ValueArray constants;
+    struct piccolo_InlineCacheArray caches;
+    // Largest number of stack values a frame running this bytecode uses, including its arguments
+    int maxStack;
 };
 
 void piccolo_initBytecode(struct piccolo_Bytecode* bytecode);
 void piccolo_freeBytecode(struct piccolo_Engine* engine, struct piccolo_Bytecode* bytecode);
 
 void piccolo_writeBytecode(struct piccolo_Engine* engine, struct piccolo_Bytecode* bytecode, uint8_t byte, int charIdx);
+void piccolo_writeParam(struct piccolo_Engine* engine, struct piccolo_Bytecode* bytecode, uint16_t param, int charIdx);
 void piccolo_writeParameteredBytecode(struct piccolo_Engine* engine, struct piccolo_Bytecode* bytecode, uint8_t byte, uint16_t param, int charIdx);
 int piccolo_writeConst(struct piccolo_Engine* engine, struct piccolo_Bytecode* bytecode, piccolo_Value value, int charIdx);
+int piccolo_addInlineCache(struct piccolo_Engine* engine, struct piccolo_Bytecode* bytecode);
 void piccolo_patchParam(struct piccolo_Bytecode* bytecode, int addr, uint16_t param);
 
 #endif
@@ -4,11 +4,13 @@
 #include "parser.h"
 #include "bytecode.h"
 #include "typecheck.h"
+#include "optimizer.h"
 
 #include "debug/expr.h"
 
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 
 #include "debug/disassembler.h"
 #include "util/strutil.h"
@@ -29,6 +31,11 @@ static void initCompiler(struct piccolo_Compiler* compiler, struct piccolo_Packa
     compiler->enclosing = NULL;
     piccolo_initVariableArray(&compiler->locals);
     piccolo_initUpvalueArray(&compiler->upvals);
+    compiler->stackDepth = 0;
+    compiler->maxStackDepth = 0;
+    compiler->blockTop = 0;
+    compiler->nextReserved = 0;
+    compiler->reservedEnd = 0;
 }
 
 static void freeCompiler(struct piccolo_Engine* engine, struct piccolo_Compiler* compiler) {
@@ -66,11 +73,12 @@ static int getGlobalSlot(struct piccolo_Compiler* compiler, struct piccolo_Token
     return -1;
 }
 
-static int getLocalSlot(struct piccolo_Compiler* compiler, struct piccolo_Token token) {
+// Returns the index of the local in compiler->locals, its stack slot is stored in the variable
+static int getLocalIdx(struct piccolo_Compiler* compiler, struct piccolo_Token token) {
     for(int i = 0; i < compiler->locals.count; i++) {
         struct piccolo_Variable var = compiler->locals.values[i];
         if(var.nameLen == token.length && memcmp(var.nameStart, token.start, var.nameLen) == 0)
-            return var.slot;
+            return i;
     }
     return -1;
 }
@@ -79,8 +87,8 @@ static int resolveUpvalue(struct piccolo_Engine* engine, struct piccolo_Compiler
     if(compiler->enclosing == NULL)
         return -1;
 
-    int enclosingSlot = getLocalSlot(compiler->enclosing, name);
-    if(enclosingSlot == -1) {
+    int enclosingIdx = getLocalIdx(compiler->enclosing, name);
+    if(enclosingIdx == -1) {
         int slot = resolveUpvalue(engine, compiler->enclosing, name);
         if(slot == -1)
             return -1;
@@ -97,6 +105,7 @@ static int resolveUpvalue(struct piccolo_Engine* engine, struct piccolo_Compiler
         return result;
     }
 
+    int enclosingSlot = compiler->enclosing->locals.values[enclosingIdx].slot;
     for(int i = 0; i < compiler->upvals.count; i++)
         if(compiler->upvals.values[i].slot == enclosingSlot && compiler->upvals.values[i].local)
             return i;
@@ -106,8 +115,8 @@ static int resolveUpvalue(struct piccolo_Engine* engine, struct piccolo_Compiler
     struct piccolo_Upvalue upval;
     upval.slot = enclosingSlot;
     upval.local = true;
-    upval.Mutable = compiler->enclosing->locals.values[enclosingSlot].Mutable;
-    upval.decl = compiler->enclosing->locals.values[enclosingSlot].decl;
+    upval.Mutable = compiler->enclosing->locals.values[enclosingIdx].Mutable;
+    upval.decl = compiler->enclosing->locals.values[enclosingIdx].decl;
     piccolo_writeUpvalueArray(engine, &compiler->upvals, upval);
 
     return slot;
@@ -196,8 +205,8 @@ struct piccolo_VarData piccolo_getVariable(struct piccolo_Engine* engine, struct
     struct piccolo_VarData result;
     result.decl = NULL;
     if(globalSlot == -1) {
-        int localSlot = getLocalSlot(compiler, name);
-        if(localSlot == -1) {
+        int localIdx = getLocalIdx(compiler, name);
+        if(localIdx == -1) {
             int upvalueSlot = resolveUpvalue(engine, compiler, name);
             if(upvalueSlot == -1) {
                 result.slot = -1;
@@ -210,11 +219,11 @@ struct piccolo_VarData piccolo_getVariable(struct piccolo_Engine* engine, struct
                 result.decl = NULL;
             }
         } else {
-            result.slot = localSlot;
+            result.slot = compiler->locals.values[localIdx].slot;
             result.getOp = PICCOLO_OP_GET_LOCAL;
             result.setOp = PICCOLO_OP_SET_LOCAL;
-            result.Mutable = compiler->locals.values[localSlot].Mutable;
-            result.decl = compiler->locals.values[localSlot].decl;
+            result.Mutable = compiler->locals.values[localIdx].Mutable;
+            result.decl = compiler->locals.values[localIdx].decl;
         }
     } else {
         result.slot = globalSlot;
@@ -286,9 +295,11 @@ static void markReqEval(struct piccolo_ExprNode* expr) {
         }
         case PICCOLO_EXPR_BINARY: {
             struct piccolo_BinaryNode* binary = (struct piccolo_BinaryNode*)expr;
-            binary->a->reqEval = expr->reqEval;
+            // The short circuiting operators always need their operands for the jumps
+            bool shortCircuit = binary->op.type == PICCOLO_TOKEN_AND || binary->op.type == PICCOLO_TOKEN_OR;
+            binary->a->reqEval = expr->reqEval || shortCircuit;
             markReqEval(binary->a);
-            binary->b->reqEval = expr->reqEval;
+            binary->b->reqEval = expr->reqEval || shortCircuit;
             markReqEval(binary->b);
             break;
         }
@@ -309,12 +320,28 @@ static void markReqEval(struct piccolo_ExprNode* expr) {
             markReqEval(fnLiteral->value);
             break;
         }
+        case PICCOLO_EXPR_TUPLE: {
+            struct piccolo_TupleNode* tuple = (struct piccolo_TupleNode*)expr;
+            struct piccolo_ExprNode* curr = tuple->first;
+            while(curr != NULL) {
+                curr->reqEval = expr->reqEval;
+                markReqEval(curr);
+                curr = curr->nextExpr;
+            }
+            break;
+        }
         case PICCOLO_EXPR_VAR_DECL: {
             struct piccolo_VarDeclNode* varDecl = (struct piccolo_VarDeclNode*)expr;
             varDecl->value->reqEval = true;
             markReqEval(varDecl->value);
             break;
         }
+        case PICCOLO_EXPR_DESTRUCTURE: {
+            struct piccolo_DestructureNode* destructure = (struct piccolo_DestructureNode*)expr;
+            destructure->value->reqEval = true;
+            markReqEval(destructure->value);
+            break;
+        }
         case PICCOLO_EXPR_VAR_SET: {
             struct piccolo_VarSetNode* varSet = (struct piccolo_VarSetNode*)expr;
             varSet->value->reqEval = true;
@@ -449,6 +476,26 @@ static void findGlobals(struct piccolo_Engine* engine, struct piccolo_Compiler*
                 findGlobals(engine, compiler, varDecl->value);
                 break;
             }
+            case PICCOLO_EXPR_DESTRUCTURE: {
+                struct piccolo_DestructureNode* destructure = (struct piccolo_DestructureNode*)curr;
+                for(struct piccolo_VarDeclNode* varDecl = destructure->first; varDecl != NULL; varDecl = (struct piccolo_VarDeclNode*)varDecl->expr.nextExpr) {
+                    if(getGlobalSlot(compiler, varDecl->name) != -1) {
+                        piccolo_compilationError(engine, compiler, varDecl->name.charIdx, "Variable '%.*s' already defined.", varDecl->name.length, varDecl->name.start);
+                    } else {
+                        struct piccolo_Variable var = createVar(varDecl->name, compiler->globals->count);
+                        var.Mutable = varDecl->Mutable;
+                        var.decl = varDecl;
+                        piccolo_writeVariableArray(engine, compiler->globals, var);
+                    }
+                }
+                findGlobals(engine, compiler, destructure->value);
+                break;
+            }
+            case PICCOLO_EXPR_TUPLE: {
+                struct piccolo_TupleNode* tuple = (struct piccolo_TupleNode*)curr;
+                findGlobals(engine, compiler, tuple->first);
+                break;
+            }
             case PICCOLO_EXPR_SUBSCRIPT_SET: {
                 struct piccolo_SubscriptSetNode* subscriptSet = (struct piccolo_SubscriptSetNode*)curr;
                 findGlobals(engine, compiler, subscriptSet->value);
@@ -492,11 +539,205 @@ static void findGlobals(struct piccolo_Engine* engine, struct piccolo_Compiler*
     }
 }
 
+/*
+    Escape analysis for array and hashmap literals. A literal that a local is declared with
+    doesn't escape when every later use of the local picks one of its elements with a constant
+    index or key, or asks an array for its length. Such a local never exists as an object, its
+    elements are kept in consecutive local slots instead and the uses become GET_LOCAL and
+    SET_LOCAL. Any other use, including one from a nested function, lets the literal escape.
+ */
+static int literalSize(struct piccolo_ExprNode* literal) {
+    int size = 0;
+    if(literal->type == PICCOLO_EXPR_ARRAY_LITERAL) {
+        for(struct piccolo_ExprNode* curr = ((struct piccolo_ArrayLiteralNode*)literal)->first; curr != NULL; curr = curr->nextExpr)
+            size++;
+    } else {
+        for(struct piccolo_HashmapEntryNode* curr = ((struct piccolo_HashmapLiteralNode*)literal)->first; curr != NULL; curr = (struct piccolo_HashmapEntryNode*)curr->expr.nextExpr)
+            size++;
+    }
+    return size;
+}
+
+static bool tokensEqual(const char* a, int aLen, const char* b, int bLen) {
+    return aLen == bLen && memcmp(a, b, aLen) == 0;
+}
+
+// Position of the hashmap literal's entry with the given key, -1 if there is none
+static int scalarKey(struct piccolo_HashmapLiteralNode* hashmap, const char* key, int keyLen) {
+    int idx = 0;
+    for(struct piccolo_HashmapEntryNode* curr = hashmap->first; curr != NULL; curr = (struct piccolo_HashmapEntryNode*)curr->expr.nextExpr) {
+        struct piccolo_Token* token = &((struct piccolo_LiteralNode*)curr->key)->token;
+        if(tokensEqual(token->start + 1, (int)token->length - 2, key, keyLen))
+            return idx;
+        idx++;
+    }
+    return -1;
+}
+
+// Position of the element a constant index picks from the literal, -1 if it isn't constant or picks none
+static int scalarIndex(struct piccolo_ExprNode* literal, struct piccolo_ExprNode* index) {
+    if(index->type != PICCOLO_EXPR_LITERAL)
+        return -1;
+    struct piccolo_Token* token = &((struct piccolo_LiteralNode*)index)->token;
+    if(literal->type == PICCOLO_EXPR_HASHMAP_LITERAL) {
+        if(token->type != PICCOLO_TOKEN_STRING)
+            return -1;
+        return scalarKey((struct piccolo_HashmapLiteralNode*)literal, token->start + 1, (int)token->length - 2);
+    }
+    bool decimalInt = token->type == PICCOLO_TOKEN_INT && !(token->length > 2 && (token->start[1] == 'x' || token->start[1] == 'X' || token->start[1] == 'b' || token->start[1] == 'B'));
+    if(token->type != PICCOLO_TOKEN_NUM && !decimalInt)
+        return -1;
+    double value = strtod(token->start, NULL);
+    if(value < 0 || value >= literalSize(literal) || value != (int)value)
+        return -1;
+    return (int)value;
+}
+
+static bool isScalarCandidate(struct piccolo_ExprNode* value) {
+    if(value->type == PICCOLO_EXPR_ARRAY_LITERAL)
+        return ((struct piccolo_ArrayLiteralNode*)value)->first != NULL;
+    if(value->type != PICCOLO_EXPR_HASHMAP_LITERAL || ((struct piccolo_HashmapLiteralNode*)value)->first == NULL)
+        return false;
+    // Every key has to be a distinct string literal
+    int idx = 0;
+    struct piccolo_HashmapLiteralNode* hashmap = (struct piccolo_HashmapLiteralNode*)value;
+    for(struct piccolo_HashmapEntryNode* curr = hashmap->first; curr != NULL; curr = (struct piccolo_HashmapEntryNode*)curr->expr.nextExpr) {
+        if(curr->key->type != PICCOLO_EXPR_LITERAL)
+            return false;
+        struct piccolo_Token* token = &((struct piccolo_LiteralNode*)curr->key)->token;
+        if(token->type != PICCOLO_TOKEN_STRING || scalarKey(hashmap, token->start + 1, (int)token->length - 2) != idx)
+            return false;
+        idx++;
+    }
+    return true;
+}
+
+static bool isDeclVar(struct piccolo_ExprNode* expr, struct piccolo_VarDeclNode* decl) {
+    if(expr->type != PICCOLO_EXPR_VAR)
+        return false;
+    struct piccolo_Token* name = &((struct piccolo_VarNode*)expr)->name;
+    return tokensEqual(name->start, (int)name->length, decl->name.start, (int)decl->name.length);
+}
+
+// The element a member access like map.key or array.length picks, -1 if it picks none
+static int scalarMember(struct piccolo_ExprNode* literal, struct piccolo_Token* subscript) {
+    if(literal->type == PICCOLO_EXPR_HASHMAP_LITERAL)
+        return scalarKey((struct piccolo_HashmapLiteralNode*)literal, subscript->start, (int)subscript->length);
+    return tokensEqual(subscript->start, (int)subscript->length, "length", 6) ? literalSize(literal) : -1;
+}
+
+static bool escapes(struct piccolo_ExprNode* expr, struct piccolo_VarDeclNode* decl, bool inFn);
+
+static bool escapesList(struct piccolo_ExprNode* first, struct piccolo_VarDeclNode* decl, bool inFn) {
+    for(struct piccolo_ExprNode* curr = first; curr != NULL; curr = curr->nextExpr)
+        if(escapes(curr, decl, inFn))
+            return true;
+    return false;
+}
+
+static bool escapes(struct piccolo_ExprNode* expr, struct piccolo_VarDeclNode* decl, bool inFn) {
+    switch(expr->type) {
+        case PICCOLO_EXPR_VAR:
+            return isDeclVar(expr, decl);
+        case PICCOLO_EXPR_ARRAY_LITERAL:
+            return escapesList(((struct piccolo_ArrayLiteralNode*)expr)->first, decl, inFn);
+        case PICCOLO_EXPR_TUPLE:
+            return escapesList(((struct piccolo_TupleNode*)expr)->first, decl, inFn);
+        case PICCOLO_EXPR_HASHMAP_LITERAL: {
+            for(struct piccolo_HashmapEntryNode* curr = ((struct piccolo_HashmapLiteralNode*)expr)->first; curr != NULL; curr = (struct piccolo_HashmapEntryNode*)curr->expr.nextExpr)
+                if(escapes(curr->key, decl, inFn) || escapes(curr->value, decl, inFn))
+                    return true;
+            return false;
+        }
+        case PICCOLO_EXPR_RANGE: {
+            struct piccolo_RangeNode* range = (struct piccolo_RangeNode*)expr;
+            return escapes(range->left, decl, inFn) || escapes(range->right, decl, inFn);
+        }
+        case PICCOLO_EXPR_SUBSCRIPT: {
+            struct piccolo_SubscriptNode* subscript = (struct piccolo_SubscriptNode*)expr;
+            if(!inFn && isDeclVar(subscript->value, decl) && scalarMember(decl->value, &subscript->subscript) != -1)
+                return false;
+            return escapes(subscript->value, decl, inFn);
+        }
+        case PICCOLO_EXPR_INDEX: {
+            struct piccolo_IndexNode* index = (struct piccolo_IndexNode*)expr;
+            if(!inFn && isDeclVar(index->target, decl) && scalarIndex(decl->value, index->index) != -1)
+                return false;
+            return escapes(index->target, decl, inFn) || escapes(index->index, decl, inFn);
+        }
+        case PICCOLO_EXPR_UNARY:
+            return escapes(((struct piccolo_UnaryNode*)expr)->value, decl, inFn);
+        case PICCOLO_EXPR_BINARY: {
+            struct piccolo_BinaryNode* binary = (struct piccolo_BinaryNode*)expr;
+            return escapes(binary->a, decl, inFn) || escapes(binary->b, decl, inFn);
+        }
+        case PICCOLO_EXPR_BLOCK:
+            return escapesList(((struct piccolo_BlockNode*)expr)->first, decl, inFn);
+        case PICCOLO_EXPR_FN_LITERAL:
+            return escapes(((struct piccolo_FnLiteralNode*)expr)->value, decl, true);
+        case PICCOLO_EXPR_VAR_DECL:
+            return escapes(((struct piccolo_VarDeclNode*)expr)->value, decl, inFn);
+        case PICCOLO_EXPR_DESTRUCTURE:
+            return escapes(((struct piccolo_DestructureNode*)expr)->value, decl, inFn);
+        case PICCOLO_EXPR_VAR_SET: {
+            struct piccolo_VarSetNode* varSet = (struct piccolo_VarSetNode*)expr;
+            return tokensEqual(varSet->name.start, (int)varSet->name.length, decl->name.start, (int)decl->name.length) || escapes(varSet->value, decl, inFn);
+        }
+        case PICCOLO_EXPR_SUBSCRIPT_SET: {
+            struct piccolo_SubscriptSetNode* subscriptSet = (struct piccolo_SubscriptSetNode*)expr;
+            if(!inFn && isDeclVar(subscriptSet->target, decl) && decl->value->type == PICCOLO_EXPR_HASHMAP_LITERAL && scalarMember(decl->value, &subscriptSet->subscript) != -1)
+                return escapes(subscriptSet->value, decl, inFn);
+            return escapes(subscriptSet->target, decl, inFn) || escapes(subscriptSet->value, decl, inFn);
+        }
+        case PICCOLO_EXPR_INDEX_SET: {
+            struct piccolo_IndexSetNode* indexSet = (struct piccolo_IndexSetNode*)expr;
+            if(!inFn && isDeclVar(indexSet->target, decl) && scalarIndex(decl->value, indexSet->index) != -1)
+                return escapes(indexSet->value, decl, inFn);
+            return escapes(indexSet->target, decl, inFn) || escapes(indexSet->index, decl, inFn) || escapes(indexSet->value, decl, inFn);
+        }
+        case PICCOLO_EXPR_IF: {
+            struct piccolo_IfNode* ifNode = (struct piccolo_IfNode*)expr;
+            return escapes(ifNode->condition, decl, inFn) || escapes(ifNode->trueVal, decl, inFn) ||
+                   (ifNode->falseVal != NULL && escapes(ifNode->falseVal, decl, inFn));
+        }
+        case PICCOLO_EXPR_WHILE: {
+            struct piccolo_WhileNode* whileNode = (struct piccolo_WhileNode*)expr;
+            return escapes(whileNode->condition, decl, inFn) || escapes(whileNode->value, decl, inFn);
+        }
+        case PICCOLO_EXPR_FOR: {
+            struct piccolo_ForNode* forNode = (struct piccolo_ForNode*)expr;
+            return escapes(forNode->container, decl, inFn) || escapes(forNode->value, decl, inFn);
+        }
+        case PICCOLO_EXPR_CALL: {
+            struct piccolo_CallNode* call = (struct piccolo_CallNode*)expr;
+            // A method call compiles its receiver on its own, see compileCall
+            struct piccolo_ExprNode* function = call->function;
+            if(function->type == PICCOLO_EXPR_SUBSCRIPT)
+                function = ((struct piccolo_SubscriptNode*)function)->value;
+            return escapes(function, decl, inFn) || escapesList(call->firstArg, decl, inFn);
+        }
+        default:
+            return false;
+    }
+}
+
+// The number of local slots a declaration takes up
+static int declSlots(struct piccolo_VarDeclNode* varDecl) {
+    return varDecl->scalarReplaced ? literalSize(varDecl->value) : 1;
+}
+
 #define COMPILE_PARAMS struct piccolo_Engine* engine, struct piccolo_Bytecode* bytecode, struct piccolo_Compiler* compiler, bool local
 #define COMPILE_ARGS engine, bytecode, compiler, local
 
 static void compileExpr(struct piccolo_ExprNode* expr, COMPILE_PARAMS);
 
+// Keeps track of how many values the emitted code leaves on the stack, see piccolo_Bytecode.maxStack
+static void adjustStack(struct piccolo_Compiler* compiler, int change) {
+    compiler->stackDepth += change;
+    if(compiler->stackDepth > compiler->maxStackDepth)
+        compiler->maxStackDepth = compiler->stackDepth;
+}
+
 static void compileLiteral(struct piccolo_LiteralNode* literal, COMPILE_PARAMS) {
     if(!literal->expr.reqEval)
         return;
@@ -507,6 +748,26 @@ static void compileLiteral(struct piccolo_LiteralNode* literal, COMPILE_PARAMS)
             piccolo_writeConst(engine, bytecode, PICCOLO_NUM_VAL(value), literal->token.charIdx);
             break;
         }
+        case PICCOLO_TOKEN_INT: {
+            // Hex and binary literals may set the sign bit, 0xffffffffffffffff is -1
+            const char* start = literal->token.start;
+            int base = 10;
+            if(literal->token.length > 2 && (start[1] == 'x' || start[1] == 'X')) {
+                base = 16;
+                start += 2;
+            } else if(literal->token.length > 2 && (start[1] == 'b' || start[1] == 'B')) {
+                base = 2;
+                start += 2;
+            }
+            errno = 0;
+            unsigned long long value = strtoull(start, NULL, base);
+            if(errno == ERANGE || (base == 10 && value > INT64_MAX)) {
+                piccolo_compilationError(engine, compiler, literal->token.charIdx, "Integer literal too large.");
+                return;
+            }
+            piccolo_writeConst(engine, bytecode, PICCOLO_INT_VAL(engine, (int64_t)value), literal->token.charIdx);
+            break;
+        }
         case PICCOLO_TOKEN_STRING: {
             struct piccolo_ObjString* value = piccolo_copyString(engine, literal->token.start + 1, (int)literal->token.length - 2);
             piccolo_writeConst(engine, bytecode, PICCOLO_OBJ_VAL(value), literal->token.charIdx);
@@ -525,9 +786,10 @@ static void compileLiteral(struct piccolo_LiteralNode* literal, COMPILE_PARAMS)
             break;
         }
         default: {
-
+            return;
         }
     }
+    adjustStack(compiler, 1);
 }
 
 static void compileVar(struct piccolo_VarNode* var, COMPILE_PARAMS) {
@@ -540,13 +802,117 @@ static void compileVar(struct piccolo_VarNode* var, COMPILE_PARAMS) {
     if(!var->expr.reqEval)
         return;
     piccolo_writeParameteredBytecode(engine, bytecode, varData.getOp, varData.slot, var->name.charIdx);
+    adjustStack(compiler, 1);
+}
+
+/*
+    The register backend addresses locals and constants directly instead of moving them through
+    the stack. It handles assignments to locals and loop and if conditions whose operands are
+    locals or number literals, everything else is compiled the same way as with the stack backend.
+ */
+static bool isRegisterOperand(struct piccolo_ExprNode* expr, struct piccolo_Bytecode* bytecode, struct piccolo_Compiler* compiler) {
+    if(expr->type == PICCOLO_EXPR_VAR) {
+        struct piccolo_VarNode* var = (struct piccolo_VarNode*)expr;
+        if(getGlobalSlot(compiler, var->name) != -1)
+            return false;
+        int localIdx = getLocalIdx(compiler, var->name);
+        return localIdx != -1 && compiler->locals.values[localIdx].slot < PICCOLO_REG_CONST_BIT;
+    }
+    if(expr->type == PICCOLO_EXPR_LITERAL) {
+        struct piccolo_LiteralNode* literal = (struct piccolo_LiteralNode*)expr;
+        return literal->token.type == PICCOLO_TOKEN_NUM && bytecode->constants.count < PICCOLO_REG_CONST_BIT;
+    }
+    return false;
+}
+
+static uint16_t registerOperand(struct piccolo_ExprNode* expr, COMPILE_PARAMS) {
+    if(expr->type == PICCOLO_EXPR_VAR) {
+        struct piccolo_VarNode* var = (struct piccolo_VarNode*)expr;
+        struct piccolo_VarData varData = piccolo_getVariable(engine, compiler, var->name);
+        var->decl = varData.decl;
+        return varData.slot;
+    }
+    struct piccolo_LiteralNode* literal = (struct piccolo_LiteralNode*)expr;
+    int constIdx = bytecode->constants.count;
+    piccolo_writeValueArray(engine, &bytecode->constants, PICCOLO_NUM_VAL(strtod(literal->token.start, NULL)));
+    return constIdx | PICCOLO_REG_CONST_BIT;
+}
+
+static bool compileRegisterAssign(struct piccolo_ExprNode* value, int dst, int charIdx, COMPILE_PARAMS) {
+    if(isRegisterOperand(value, bytecode, compiler)) {
+        uint16_t src = registerOperand(value, COMPILE_ARGS);
+        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_REG_MOVE, dst, charIdx);
+        piccolo_writeParam(engine, bytecode, src, charIdx);
+        return true;
+    }
+    if(value->type != PICCOLO_EXPR_BINARY)
+        return false;
+    struct piccolo_BinaryNode* binary = (struct piccolo_BinaryNode*)value;
+    enum piccolo_OpCode op;
+    switch(binary->op.type) {
+        case PICCOLO_TOKEN_PLUS: op = PICCOLO_OP_REG_ADD; break;
+        case PICCOLO_TOKEN_MINUS: op = PICCOLO_OP_REG_SUB; break;
+        case PICCOLO_TOKEN_STAR: op = PICCOLO_OP_REG_MUL; break;
+        case PICCOLO_TOKEN_SLASH: op = PICCOLO_OP_REG_DIV; break;
+        case PICCOLO_TOKEN_PERCENT: op = PICCOLO_OP_REG_MOD; break;
+        default: return false;
+    }
+    if(!isRegisterOperand(binary->a, bytecode, compiler) || !isRegisterOperand(binary->b, bytecode, compiler))
+        return false;
+    uint16_t a = registerOperand(binary->a, COMPILE_ARGS);
+    uint16_t b = registerOperand(binary->b, COMPILE_ARGS);
+    piccolo_writeParameteredBytecode(engine, bytecode, op, dst, binary->op.charIdx);
+    piccolo_writeParam(engine, bytecode, a, binary->op.charIdx);
+    piccolo_writeParam(engine, bytecode, b, binary->op.charIdx);
+    return true;
+}
+
+// Compiles the condition and a jump that is taken when it is false. Returns the address of the jump.
+static int compileConditionJump(struct piccolo_ExprNode* condition, int charIdx, COMPILE_PARAMS) {
+    if(engine->backend == PICCOLO_BACKEND_REGISTER && condition->type == PICCOLO_EXPR_BINARY) {
+        struct piccolo_BinaryNode* binary = (struct piccolo_BinaryNode*)condition;
+        enum piccolo_OpCode op = PICCOLO_OP_JUMP_FALSE;
+        switch(binary->op.type) {
+            case PICCOLO_TOKEN_LESS: op = PICCOLO_OP_REG_LESS_JUMP_FALSE; break;
+            case PICCOLO_TOKEN_LESS_EQ: op = PICCOLO_OP_REG_LESS_EQ_JUMP_FALSE; break;
+            case PICCOLO_TOKEN_GREATER: op = PICCOLO_OP_REG_GREATER_JUMP_FALSE; break;
+            case PICCOLO_TOKEN_GREATER_EQ: op = PICCOLO_OP_REG_GREATER_EQ_JUMP_FALSE; break;
+            case PICCOLO_TOKEN_EQ_EQ: op = PICCOLO_OP_REG_EQUAL_JUMP_FALSE; break;
+            case PICCOLO_TOKEN_BANG_EQ: op = PICCOLO_OP_REG_NOT_EQUAL_JUMP_FALSE; break;
+            default: break;
+        }
+        if(op != PICCOLO_OP_JUMP_FALSE &&
+           isRegisterOperand(binary->a, bytecode, compiler) && isRegisterOperand(binary->b, bytecode, compiler)) {
+            uint16_t a = registerOperand(binary->a, COMPILE_ARGS);
+            uint16_t b = registerOperand(binary->b, COMPILE_ARGS);
+            int jumpAddr = bytecode->code.count;
+            piccolo_writeParameteredBytecode(engine, bytecode, op, a, binary->op.charIdx);
+            piccolo_writeParam(engine, bytecode, b, binary->op.charIdx);
+            piccolo_writeParam(engine, bytecode, 0, binary->op.charIdx);
+            return jumpAddr;
+        }
+    }
+    compileExpr(condition, COMPILE_ARGS);
+    int jumpAddr = bytecode->code.count;
+    piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_JUMP_FALSE, 0, charIdx);
+    adjustStack(compiler, -1);
+    return jumpAddr;
+}
+
+static void patchConditionJump(struct piccolo_Bytecode* bytecode, int jumpAddr, int targetAddr) {
+    if(bytecode->code.values[jumpAddr] == PICCOLO_OP_JUMP_FALSE)
+        piccolo_patchParam(bytecode, jumpAddr, targetAddr - jumpAddr);
+    else
+        piccolo_patchParam(bytecode, jumpAddr + 4, targetAddr - jumpAddr);
 }
 
 static void compileRange(struct piccolo_RangeNode* range, COMPILE_PARAMS) {
     compileExpr(range->left, COMPILE_ARGS);
     compileExpr(range->right, COMPILE_ARGS);
-    if(range->expr.reqEval)
+    if(range->expr.reqEval) {
         piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_CREATE_RANGE, range->charIdx);
+        adjustStack(compiler, -1);
+    }
 }
 
 static void compileArrayLiteral(struct piccolo_ArrayLiteralNode* arrayLiteral, COMPILE_PARAMS) {
@@ -557,38 +923,88 @@ static void compileArrayLiteral(struct piccolo_ArrayLiteralNode* arrayLiteral, C
         compileExpr(curr, COMPILE_ARGS);
         curr = curr->nextExpr;
     }
-    if(arrayLiteral->expr.reqEval)
+    if(arrayLiteral->expr.reqEval) {
         piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_CREATE_ARRAY, count, 0);
+        adjustStack(compiler, 1 - count);
+    }
 }
 
 static void compileHashmapLiteral(struct piccolo_HashmapLiteralNode* hashmapLiteral, COMPILE_PARAMS) {
-    if(hashmapLiteral->expr.reqEval)
+    if(hashmapLiteral->expr.reqEval) {
         piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_HASHMAP, 0);
+        adjustStack(compiler, 1);
+    }
     struct piccolo_HashmapEntryNode* curr = hashmapLiteral->first;
     while(curr != NULL) {
-        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_PEEK_STACK, 1, 0);
+        if(hashmapLiteral->expr.reqEval) {
+            piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_PEEK_STACK, 1, 0);
+            adjustStack(compiler, 1);
+        }
         compileExpr(curr->key, COMPILE_ARGS);
         compileExpr(curr->value, COMPILE_ARGS);
-        piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_SET_IDX, 0);
-        piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_POP_STACK, 0);
+        if(hashmapLiteral->expr.reqEval) {
+            piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_SET_IDX, 0);
+            piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_POP_STACK, 0);
+            adjustStack(compiler, -3);
+        }
         curr = (struct piccolo_HashmapEntryNode*)curr->expr.nextExpr;
     }
 }
 
+// The declaration of a local whose literal was scalar replaced, if target is one
+static struct piccolo_VarDeclNode* scalarTarget(struct piccolo_ExprNode* target, COMPILE_PARAMS) {
+    if(target->type != PICCOLO_EXPR_VAR)
+        return NULL;
+    struct piccolo_VarNode* var = (struct piccolo_VarNode*)target;
+    struct piccolo_VarData varData = piccolo_getVariable(engine, compiler, var->name);
+    if(varData.slot == -1 || varData.decl == NULL || !varData.decl->scalarReplaced)
+        return NULL;
+    var->decl = varData.decl;
+    return varData.decl;
+}
+
+static int scalarSlot(struct piccolo_VarDeclNode* decl, int element, COMPILE_PARAMS) {
+    return piccolo_getVariable(engine, compiler, decl->name).slot + element;
+}
+
 static void compileSubscript(struct piccolo_SubscriptNode* subscript, COMPILE_PARAMS) {
+    struct piccolo_VarDeclNode* scalar = scalarTarget(subscript->value, COMPILE_ARGS);
+    if(scalar != NULL) {
+        if(!subscript->expr.reqEval)
+            return;
+        if(scalar->value->type == PICCOLO_EXPR_ARRAY_LITERAL)
+            piccolo_writeConst(engine, bytecode, PICCOLO_NUM_VAL(literalSize(scalar->value)), subscript->subscript.charIdx);
+        else
+            piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_GET_LOCAL, scalarSlot(scalar, scalarMember(scalar->value, &subscript->subscript), COMPILE_ARGS), subscript->subscript.charIdx);
+        adjustStack(compiler, 1);
+        return;
+    }
     compileExpr(subscript->value, COMPILE_ARGS);
     if(subscript->expr.reqEval) {
         struct piccolo_ObjString* subscriptStr = piccolo_copyString(engine, subscript->subscript.start, subscript->subscript.length);
-        piccolo_writeConst(engine, bytecode, PICCOLO_OBJ_VAL(subscriptStr), subscript->subscript.charIdx);
-        piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_GET_IDX, subscript->subscript.charIdx);
+        int nameIdx = bytecode->constants.count;
+        piccolo_writeValueArray(engine, &bytecode->constants, PICCOLO_OBJ_VAL(subscriptStr));
+        int cacheIdx = piccolo_addInlineCache(engine, bytecode);
+        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_GET_MEMBER, nameIdx, subscript->subscript.charIdx);
+        piccolo_writeParam(engine, bytecode, cacheIdx, subscript->subscript.charIdx);
     }
 }
 
 static void compileIndex(struct piccolo_IndexNode* index, COMPILE_PARAMS) {
+    struct piccolo_VarDeclNode* scalar = scalarTarget(index->target, COMPILE_ARGS);
+    if(scalar != NULL) {
+        if(index->expr.reqEval) {
+            piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_GET_LOCAL, scalarSlot(scalar, scalarIndex(scalar->value, index->index), COMPILE_ARGS), index->charIdx);
+            adjustStack(compiler, 1);
+        }
+        return;
+    }
     compileExpr(index->target, COMPILE_ARGS);
     compileExpr(index->index, COMPILE_ARGS);
-    if(index->expr.reqEval)
+    if(index->expr.reqEval) {
         piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_GET_IDX, index->charIdx);
+        adjustStack(compiler, -1);
+    }
 }
 
 static void compileUnary(struct piccolo_UnaryNode* unary, COMPILE_PARAMS) {
@@ -604,6 +1020,10 @@ static void compileUnary(struct piccolo_UnaryNode* unary, COMPILE_PARAMS) {
             piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_NOT, unary->op.charIdx);
             break;
         }
+        case PICCOLO_TOKEN_TILDE: {
+            piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_BIT_NOT, unary->op.charIdx);
+            break;
+        }
         default: {
 
         }
@@ -616,6 +1036,11 @@ static void compileBinary(struct piccolo_BinaryNode* binary, COMPILE_PARAMS) {
        binary->op.type == PICCOLO_TOKEN_STAR ||
        binary->op.type == PICCOLO_TOKEN_SLASH ||
        binary->op.type == PICCOLO_TOKEN_PERCENT ||
+       binary->op.type == PICCOLO_TOKEN_AMPERSAND ||
+       binary->op.type == PICCOLO_TOKEN_PIPE ||
+       binary->op.type == PICCOLO_TOKEN_CARET ||
+       binary->op.type == PICCOLO_TOKEN_LESS_LESS ||
+       binary->op.type == PICCOLO_TOKEN_GREATER_GREATER ||
        binary->op.type == PICCOLO_TOKEN_EQ_EQ ||
        binary->op.type == PICCOLO_TOKEN_BANG_EQ ||
        binary->op.type == PICCOLO_TOKEN_GREATER ||
@@ -651,6 +1076,26 @@ static void compileBinary(struct piccolo_BinaryNode* binary, COMPILE_PARAMS) {
                 op = PICCOLO_OP_MOD;
                 break;
             }
+            case PICCOLO_TOKEN_AMPERSAND: {
+                op = PICCOLO_OP_BIT_AND;
+                break;
+            }
+            case PICCOLO_TOKEN_PIPE: {
+                op = PICCOLO_OP_BIT_OR;
+                break;
+            }
+            case PICCOLO_TOKEN_CARET: {
+                op = PICCOLO_OP_BIT_XOR;
+                break;
+            }
+            case PICCOLO_TOKEN_LESS_LESS: {
+                op = PICCOLO_OP_SHIFT_LEFT;
+                break;
+            }
+            case PICCOLO_TOKEN_GREATER_GREATER: {
+                op = PICCOLO_OP_SHIFT_RIGHT;
+                break;
+            }
             case PICCOLO_TOKEN_EQ_EQ:
             case PICCOLO_TOKEN_BANG_EQ: {
                 op = PICCOLO_OP_EQUAL;
@@ -676,6 +1121,7 @@ static void compileBinary(struct piccolo_BinaryNode* binary, COMPILE_PARAMS) {
         }
 
         piccolo_writeBytecode(engine, bytecode, op, binary->op.charIdx);
+        adjustStack(compiler, -1);
         if(binary->op.type == PICCOLO_TOKEN_BANG_EQ ||
            binary->op.type == PICCOLO_TOKEN_GREATER_EQ ||
            binary->op.type == PICCOLO_TOKEN_LESS_EQ) {
@@ -689,6 +1135,7 @@ static void compileBinary(struct piccolo_BinaryNode* binary, COMPILE_PARAMS) {
         }
         int shortCircuitJumpAddr = bytecode->code.count;
         piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_JUMP_FALSE, 0, binary->op.charIdx);
+        adjustStack(compiler, -1);
         compileExpr(binary->b, COMPILE_ARGS);
         int skipConstAddr = bytecode->code.count;
         piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_JUMP, 0, binary->op.charIdx);
@@ -698,23 +1145,191 @@ static void compileBinary(struct piccolo_BinaryNode* binary, COMPILE_PARAMS) {
 
         piccolo_patchParam(bytecode, shortCircuitJumpAddr, constAddr - shortCircuitJumpAddr);
         piccolo_patchParam(bytecode, skipConstAddr, endAddr - skipConstAddr);
+        if(!binary->expr.reqEval) {
+            piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_POP_STACK, binary->op.charIdx);
+            adjustStack(compiler, -1);
+        }
     }
 }
 
+/*
+    Counts the local variable declarations in an expression, leaving out nested blocks and
+    functions, which have their own locals.
+ */
+static int countLocalDecls(struct piccolo_ExprNode* expr) {
+    switch(expr->type) {
+        case PICCOLO_EXPR_RANGE: {
+            struct piccolo_RangeNode* range = (struct piccolo_RangeNode*)expr;
+            return countLocalDecls(range->left) + countLocalDecls(range->right);
+        }
+        case PICCOLO_EXPR_ARRAY_LITERAL: {
+            struct piccolo_ArrayLiteralNode* arrayLiteral = (struct piccolo_ArrayLiteralNode*)expr;
+            int count = 0;
+            for(struct piccolo_ExprNode* curr = arrayLiteral->first; curr != NULL; curr = curr->nextExpr)
+                count += countLocalDecls(curr);
+            return count;
+        }
+        case PICCOLO_EXPR_HASHMAP_LITERAL: {
+            struct piccolo_HashmapLiteralNode* hashmap = (struct piccolo_HashmapLiteralNode*)expr;
+            int count = 0;
+            for(struct piccolo_HashmapEntryNode* curr = hashmap->first; curr != NULL; curr = (struct piccolo_HashmapEntryNode*)curr->expr.nextExpr)
+                count += countLocalDecls(curr->key) + countLocalDecls(curr->value);
+            return count;
+        }
+        case PICCOLO_EXPR_SUBSCRIPT: {
+            return countLocalDecls(((struct piccolo_SubscriptNode*)expr)->value);
+        }
+        case PICCOLO_EXPR_INDEX: {
+            struct piccolo_IndexNode* index = (struct piccolo_IndexNode*)expr;
+            return countLocalDecls(index->target) + countLocalDecls(index->index);
+        }
+        case PICCOLO_EXPR_UNARY: {
+            return countLocalDecls(((struct piccolo_UnaryNode*)expr)->value);
+        }
+        case PICCOLO_EXPR_BINARY: {
+            struct piccolo_BinaryNode* binary = (struct piccolo_BinaryNode*)expr;
+            return countLocalDecls(binary->a) + countLocalDecls(binary->b);
+        }
+        case PICCOLO_EXPR_TUPLE: {
+            int count = 0;
+            for(struct piccolo_ExprNode* curr = ((struct piccolo_TupleNode*)expr)->first; curr != NULL; curr = curr->nextExpr)
+                count += countLocalDecls(curr);
+            return count;
+        }
+        case PICCOLO_EXPR_VAR_DECL: {
+            struct piccolo_VarDeclNode* varDecl = (struct piccolo_VarDeclNode*)expr;
+            return declSlots(varDecl) + countLocalDecls(varDecl->value);
+        }
+        case PICCOLO_EXPR_DESTRUCTURE: {
+            struct piccolo_DestructureNode* destructure = (struct piccolo_DestructureNode*)expr;
+            return destructure->count + countLocalDecls(destructure->value);
+        }
+        case PICCOLO_EXPR_VAR_SET: {
+            return countLocalDecls(((struct piccolo_VarSetNode*)expr)->value);
+        }
+        case PICCOLO_EXPR_SUBSCRIPT_SET: {
+            struct piccolo_SubscriptSetNode* subscriptSet = (struct piccolo_SubscriptSetNode*)expr;
+            return countLocalDecls(subscriptSet->target) + countLocalDecls(subscriptSet->value);
+        }
+        case PICCOLO_EXPR_INDEX_SET: {
+            struct piccolo_IndexSetNode* indexSet = (struct piccolo_IndexSetNode*)expr;
+            return countLocalDecls(indexSet->target) + countLocalDecls(indexSet->index) + countLocalDecls(indexSet->value);
+        }
+        case PICCOLO_EXPR_IF: {
+            struct piccolo_IfNode* ifNode = (struct piccolo_IfNode*)expr;
+            int count = countLocalDecls(ifNode->condition) + countLocalDecls(ifNode->trueVal);
+            if(ifNode->falseVal != NULL)
+                count += countLocalDecls(ifNode->falseVal);
+            return count;
+        }
+        case PICCOLO_EXPR_WHILE: {
+            struct piccolo_WhileNode* whileNode = (struct piccolo_WhileNode*)expr;
+            return countLocalDecls(whileNode->condition) + countLocalDecls(whileNode->value);
+        }
+        case PICCOLO_EXPR_FOR: {
+            struct piccolo_ForNode* forNode = (struct piccolo_ForNode*)expr;
+            return countLocalDecls(forNode->container) + countLocalDecls(forNode->value);
+        }
+        case PICCOLO_EXPR_CALL: {
+            struct piccolo_CallNode* call = (struct piccolo_CallNode*)expr;
+            int count = countLocalDecls(call->function);
+            for(struct piccolo_ExprNode* curr = call->firstArg; curr != NULL; curr = curr->nextExpr)
+                count += countLocalDecls(curr);
+            return count;
+        }
+        default:
+            return 0;
+    }
+}
+
+/*
+    Locals live on the stack right after the locals of the enclosing blocks. A declaration that
+    is a statement of its block leaves its value exactly there, so that value becomes the local.
+    Declarations nested inside of another expression may have temporaries below them, so slots
+    for them are reserved before the statement that contains them. When the block ends its value
+    is moved into its first local's slot and the rest of the locals are popped.
+ */
 static void compileBlock(struct piccolo_BlockNode* block, COMPILE_PARAMS) {
     if(block->first == NULL) {
-        if(block->expr.reqEval)
+        if(block->expr.reqEval) {
             piccolo_writeConst(engine, bytecode, PICCOLO_NIL_VAL(), 0);
+            adjustStack(compiler, 1);
+        }
     } else {
         struct piccolo_ExprNode *curr = block->first;
         int localCount = compiler->locals.count;
+        int outerBlockTop = compiler->blockTop;
+        int outerNextReserved = compiler->nextReserved;
+        int outerReservedEnd = compiler->reservedEnd;
+        int blockStart = compiler->stackDepth;
+        compiler->blockTop = blockStart;
+        for(struct piccolo_ExprNode* stmt = block->first; stmt != NULL; stmt = stmt->nextExpr) {
+            if(stmt->type != PICCOLO_EXPR_VAR_DECL)
+                continue;
+            struct piccolo_VarDeclNode* varDecl = (struct piccolo_VarDeclNode*)stmt;
+            varDecl->scalarReplaced = !stmt->reqEval && isScalarCandidate(varDecl->value) && !escapesList(stmt->nextExpr, varDecl, false);
+        }
         while (curr != NULL) {
+            int reserved = countLocalDecls(curr);
+            if(curr->type == PICCOLO_EXPR_VAR_DECL)
+                reserved -= declSlots((struct piccolo_VarDeclNode*)curr);
+            else if(curr->type == PICCOLO_EXPR_DESTRUCTURE)
+                reserved -= ((struct piccolo_DestructureNode*)curr)->count;
+            for(int i = 0; i < reserved; i++)
+                piccolo_writeConst(engine, bytecode, PICCOLO_NIL_VAL(), 0);
+            adjustStack(compiler, reserved);
+            compiler->nextReserved = compiler->blockTop;
+            compiler->blockTop += reserved;
+            compiler->reservedEnd = compiler->blockTop;
             compileExpr(curr, engine, bytecode, compiler, true);
             curr = curr->nextExpr;
         }
-        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_POP_LOCALS, compiler->locals.count - localCount, 0);
-        piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_CLOSE_UPVALS, 0);
+        int blockLocals = compiler->blockTop - blockStart;
+        if(blockLocals > 0) {
+            piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_CLOSE_UPVALS, blockStart, 0);
+            if(block->expr.reqEval)
+                piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_SET_LOCAL, blockStart, 0);
+            piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_POP_LOCALS, blockLocals, 0);
+            adjustStack(compiler, -blockLocals);
+        }
         compiler->locals.count = localCount;
+        compiler->blockTop = outerBlockTop;
+        compiler->nextReserved = outerNextReserved;
+        compiler->reservedEnd = outerReservedEnd;
+    }
+}
+
+/*
+    Marks the calls and tuples whose result becomes the result of the function. The code after a
+    tail call is still compiled as usual, it runs when the called value turns out to be a native.
+ */
+static void markTailCalls(struct piccolo_ExprNode* expr) {
+    switch(expr->type) {
+        case PICCOLO_EXPR_CALL: {
+            ((struct piccolo_CallNode*)expr)->tailCall = true;
+            break;
+        }
+        case PICCOLO_EXPR_TUPLE: {
+            ((struct piccolo_TupleNode*)expr)->returned = true;
+            break;
+        }
+        case PICCOLO_EXPR_IF: {
+            struct piccolo_IfNode* ifNode = (struct piccolo_IfNode*)expr;
+            markTailCalls(ifNode->trueVal);
+            if(ifNode->falseVal != NULL)
+                markTailCalls(ifNode->falseVal);
+            break;
+        }
+        case PICCOLO_EXPR_BLOCK: {
+            struct piccolo_ExprNode* last = ((struct piccolo_BlockNode*)expr)->first;
+            while(last != NULL && last->nextExpr != NULL)
+                last = last->nextExpr;
+            if(last != NULL)
+                markTailCalls(last);
+            break;
+        }
+        default:
+            break;
     }
 }
 
@@ -733,13 +1348,16 @@ static void compileFnLiteral(struct piccolo_FnLiteralNode* fnLiteral, COMPILE_PA
     }
     struct piccolo_ObjFunction* function = piccolo_newFunction(engine);
     function->arity = fnLiteral->params.count;
+    adjustStack(&fnCompiler, fnLiteral->params.count);
+    markTailCalls(fnLiteral->value);
     compileExpr(fnLiteral->value, engine, &function->bytecode, &fnCompiler, false);
-    piccolo_writeParameteredBytecode(engine, &function->bytecode, PICCOLO_OP_POP_LOCALS, fnLiteral->params.count, 0);
-    piccolo_writeBytecode(engine, &function->bytecode, PICCOLO_OP_CLOSE_UPVALS, 0);
     piccolo_writeBytecode(engine, &function->bytecode, PICCOLO_OP_RETURN, 0);
+    function->bytecode.maxStack = fnCompiler.maxStackDepth;
+    piccolo_fuseInstructions(&function->bytecode);
 
     if(fnLiteral->expr.reqEval) {
         piccolo_writeConst(engine, bytecode, PICCOLO_OBJ_VAL(function), 0);
+        adjustStack(compiler, 1);
         piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_CLOSURE, fnCompiler.upvals.count, 0);
         for(int i = 0; i < fnCompiler.upvals.count; i++) {
             int slot = fnCompiler.upvals.values[i].slot;
@@ -752,30 +1370,161 @@ static void compileFnLiteral(struct piccolo_FnLiteralNode* fnLiteral, COMPILE_PA
     compiler->hadError |= fnCompiler.hadError;
 }
 
+// Declares a local whose literal doesn't escape, with its elements in consecutive slots
+static void compileScalarDecl(struct piccolo_VarDeclNode* varDecl, COMPILE_PARAMS) {
+    int count = literalSize(varDecl->value);
+    if(varDecl->value->type == PICCOLO_EXPR_ARRAY_LITERAL) {
+        for(struct piccolo_ExprNode* curr = ((struct piccolo_ArrayLiteralNode*)varDecl->value)->first; curr != NULL; curr = curr->nextExpr)
+            compileExpr(curr, COMPILE_ARGS);
+    } else {
+        for(struct piccolo_HashmapEntryNode* curr = ((struct piccolo_HashmapLiteralNode*)varDecl->value)->first; curr != NULL; curr = (struct piccolo_HashmapEntryNode*)curr->expr.nextExpr)
+            compileExpr(curr->value, COMPILE_ARGS);
+    }
+    bool inPlace = compiler->nextReserved == compiler->reservedEnd;
+    int slot = inPlace ? compiler->blockTop : compiler->nextReserved;
+    if(inPlace) {
+        compiler->blockTop += count;
+    } else {
+        compiler->nextReserved += count;
+        for(int i = count - 1; i >= 0; i--) {
+            piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_SET_LOCAL, slot + i, varDecl->name.charIdx);
+            piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_POP_STACK, varDecl->name.charIdx);
+        }
+        adjustStack(compiler, -count);
+    }
+    struct piccolo_VarData varData = piccolo_getVariable(engine, compiler, varDecl->name);
+    if(varData.slot != -1) {
+        piccolo_compilationError(engine, compiler, varDecl->name.charIdx, "Variable '%.*s' already defined.", varDecl->name.length, varDecl->name.start);
+    } else {
+        struct piccolo_Variable var = createVar(varDecl->name, slot);
+        var.Mutable = varDecl->Mutable;
+        var.decl = varDecl;
+        piccolo_writeVariableArray(engine, &compiler->locals, var);
+    }
+}
+
 static void compileVarDecl(struct piccolo_VarDeclNode* varDecl, COMPILE_PARAMS) {
+    if(local && varDecl->scalarReplaced) {
+        compileScalarDecl(varDecl, COMPILE_ARGS);
+        return;
+    }
     compileExpr(varDecl->value, COMPILE_ARGS);
     if(local) { // Act locally
+        // Only the declaration a block statement consists of has no reserved slot, see compileBlock
+        bool inPlace = compiler->nextReserved == compiler->reservedEnd;
+        int slot = inPlace ? compiler->blockTop++ : compiler->nextReserved++;
+        if(!inPlace)
+            piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_SET_LOCAL, slot, varDecl->name.charIdx);
         struct piccolo_VarData varData = piccolo_getVariable(engine, compiler, varDecl->name);
         if(varData.slot != -1) {
             piccolo_compilationError(engine, compiler, varDecl->name.charIdx, "Variable '%.*s' already defined.", varDecl->name.length, varDecl->name.start);
         } else {
-            int slot = compiler->locals.count;
             struct piccolo_Variable var = createVar(varDecl->name, slot);
             var.Mutable = varDecl->Mutable;
             var.decl = varDecl;
             piccolo_writeVariableArray(engine, &compiler->locals, var);
-            piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_PUSH_LOCAL, 0);
         }
+        if(inPlace && varDecl->expr.reqEval) {
+            piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_GET_LOCAL, slot, varDecl->name.charIdx);
+            adjustStack(compiler, 1);
+        }
+        if(inPlace || varDecl->expr.reqEval)
+            return;
     } else { // Think globally
         int slot = getGlobalSlot(compiler, varDecl->name);
         piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_SET_GLOBAL, slot, varDecl->name.charIdx);
     }
-    if(!varDecl->expr.reqEval)
+    if(!varDecl->expr.reqEval) {
         piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_POP_STACK, varDecl->name.charIdx);
+        adjustStack(compiler, -1);
+    }
+}
+
+/*
+    A tuple that is the result of its function leaves its values on the stack for RETURN_VALUES,
+    which hands them to a destructuring caller without allocating. Other tuples become arrays.
+ */
+static void compileTuple(struct piccolo_TupleNode* tuple, COMPILE_PARAMS) {
+    for(struct piccolo_ExprNode* curr = tuple->first; curr != NULL; curr = curr->nextExpr)
+        compileExpr(curr, COMPILE_ARGS);
+    if(tuple->returned) {
+        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_RETURN_VALUES, tuple->count, tuple->charIdx);
+        piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_RETURN, tuple->charIdx);
+        adjustStack(compiler, 1 - tuple->count);
+    } else if(tuple->expr.reqEval) {
+        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_CREATE_ARRAY, tuple->count, tuple->charIdx);
+        adjustStack(compiler, 1 - tuple->count);
+    }
+}
+
+static void compileDestructure(struct piccolo_DestructureNode* destructure, COMPILE_PARAMS) {
+    int count = destructure->count;
+    // A tuple literal is taken apart as it is built, a wrong count is reported by the typechecker
+    if(destructure->value->type == PICCOLO_EXPR_TUPLE && ((struct piccolo_TupleNode*)destructure->value)->count == count) {
+        for(struct piccolo_ExprNode* curr = ((struct piccolo_TupleNode*)destructure->value)->first; curr != NULL; curr = curr->nextExpr)
+            compileExpr(curr, COMPILE_ARGS);
+    } else {
+        compileExpr(destructure->value, COMPILE_ARGS);
+        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_UNPACK, count, destructure->charIdx);
+        adjustStack(compiler, count - 1);
+    }
+
+    // The values are on the stack in order, so they are stored starting from the last one
+    if(local) {
+        bool inPlace = compiler->nextReserved == compiler->reservedEnd;
+        int firstSlot = inPlace ? compiler->blockTop : compiler->nextReserved;
+        if(inPlace) {
+            compiler->blockTop += count;
+        } else {
+            compiler->nextReserved += count;
+            for(int i = count - 1; i >= 0; i--) {
+                piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_SET_LOCAL, firstSlot + i, destructure->charIdx);
+                piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_POP_STACK, destructure->charIdx);
+            }
+            adjustStack(compiler, -count);
+        }
+        int i = 0;
+        for(struct piccolo_VarDeclNode* varDecl = destructure->first; varDecl != NULL; varDecl = (struct piccolo_VarDeclNode*)varDecl->expr.nextExpr) {
+            struct piccolo_VarData varData = piccolo_getVariable(engine, compiler, varDecl->name);
+            if(varData.slot != -1) {
+                piccolo_compilationError(engine, compiler, varDecl->name.charIdx, "Variable '%.*s' already defined.", varDecl->name.length, varDecl->name.start);
+            } else {
+                struct piccolo_Variable var = createVar(varDecl->name, firstSlot + i);
+                var.Mutable = varDecl->Mutable;
+                var.decl = varDecl;
+                piccolo_writeVariableArray(engine, &compiler->locals, var);
+            }
+            i++;
+        }
+    } else {
+        struct piccolo_VarDeclNode* varDecls[count];
+        int i = 0;
+        for(struct piccolo_VarDeclNode* varDecl = destructure->first; varDecl != NULL; varDecl = (struct piccolo_VarDeclNode*)varDecl->expr.nextExpr)
+            varDecls[i++] = varDecl;
+        for(i = count - 1; i >= 0; i--) {
+            piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_SET_GLOBAL, getGlobalSlot(compiler, varDecls[i]->name), varDecls[i]->name.charIdx);
+            piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_POP_STACK, varDecls[i]->name.charIdx);
+        }
+        adjustStack(compiler, -count);
+    }
+
+    if(destructure->expr.reqEval) {
+        piccolo_writeConst(engine, bytecode, PICCOLO_NIL_VAL(), destructure->charIdx);
+        adjustStack(compiler, 1);
+    }
 }
 
 static void compileVarSet(struct piccolo_VarSetNode* varSet, COMPILE_PARAMS) {
     struct piccolo_VarData varData = piccolo_getVariable(engine, compiler, varSet->name);
+    if(engine->backend == PICCOLO_BACKEND_REGISTER && varData.slot != -1 && varData.setOp == PICCOLO_OP_SET_LOCAL && varData.Mutable &&
+       compileRegisterAssign(varSet->value, varData.slot, varSet->name.charIdx, COMPILE_ARGS)) {
+        varSet->decl = varData.decl;
+        if(varSet->expr.reqEval) {
+            piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_GET_LOCAL, varData.slot, varSet->name.charIdx);
+            adjustStack(compiler, 1);
+        }
+        return;
+    }
     compileExpr(varSet->value, COMPILE_ARGS);
     if(varData.slot == -1) {
         piccolo_compilationError(engine, compiler, varSet->name.charIdx, "Variable '%.*s' is not defined.", varSet->name.length, varSet->name.start);
@@ -787,30 +1536,60 @@ static void compileVarSet(struct piccolo_VarSetNode* varSet, COMPILE_PARAMS) {
         }
         piccolo_writeParameteredBytecode(engine, bytecode, varData.setOp, varData.slot, varSet->name.charIdx);
     }
-    if(!varSet->expr.reqEval)
+    if(!varSet->expr.reqEval) {
         piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_POP_STACK, varSet->name.charIdx);
+        adjustStack(compiler, -1);
+    }
+}
+
+static void compileScalarSet(struct piccolo_VarDeclNode* scalar, int element, struct piccolo_ExprNode* value, bool reqEval, int charIdx, COMPILE_PARAMS) {
+    compileExpr(value, COMPILE_ARGS);
+    piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_SET_LOCAL, scalarSlot(scalar, element, COMPILE_ARGS), charIdx);
+    if(!reqEval) {
+        piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_POP_STACK, charIdx);
+        adjustStack(compiler, -1);
+    }
 }
 
 static void compileSubscriptSet(struct piccolo_SubscriptSetNode* subscriptSet, COMPILE_PARAMS) {
+    struct piccolo_VarDeclNode* scalar = scalarTarget(subscriptSet->target, COMPILE_ARGS);
+    if(scalar != NULL) {
+        int element = scalarMember(scalar->value, &subscriptSet->subscript);
+        compileScalarSet(scalar, element, subscriptSet->value, subscriptSet->expr.reqEval, subscriptSet->subscript.charIdx, COMPILE_ARGS);
+        return;
+    }
     compileExpr(subscriptSet->target, COMPILE_ARGS);
 
     struct piccolo_ObjString* subscriptStr = piccolo_copyString(engine, subscriptSet->subscript.start, subscriptSet->subscript.length);
     piccolo_writeConst(engine, bytecode, PICCOLO_OBJ_VAL(subscriptStr), subscriptSet->subscript.charIdx);
+    adjustStack(compiler, 1);
 
     compileExpr(subscriptSet->value, COMPILE_ARGS);
 
     piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_SET_IDX, subscriptSet->subscript.charIdx);
-    if(!subscriptSet->expr.reqEval)
+    adjustStack(compiler, -2);
+    if(!subscriptSet->expr.reqEval) {
         piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_POP_STACK, subscriptSet->subscript.charIdx);
+        adjustStack(compiler, -1);
+    }
 }
 
 static void compileIndexSet(struct piccolo_IndexSetNode* indexSet, COMPILE_PARAMS) {
+    struct piccolo_VarDeclNode* scalar = scalarTarget(indexSet->target, COMPILE_ARGS);
+    if(scalar != NULL) {
+        int element = scalarIndex(scalar->value, indexSet->index);
+        compileScalarSet(scalar, element, indexSet->value, indexSet->expr.reqEval, indexSet->charIdx, COMPILE_ARGS);
+        return;
+    }
     compileExpr(indexSet->target, COMPILE_ARGS);
     compileExpr(indexSet->index, COMPILE_ARGS);
     compileExpr(indexSet->value, COMPILE_ARGS);
     piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_SET_IDX, indexSet->charIdx);
-    if(!indexSet->expr.reqEval)
+    adjustStack(compiler, -2);
+    if(!indexSet->expr.reqEval) {
         piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_POP_STACK, indexSet->charIdx);
+        adjustStack(compiler, -1);
+    }
 }
 
 /*
@@ -823,23 +1602,24 @@ static void compileIndexSet(struct piccolo_IndexSetNode* indexSet, COMPILE_PARAM
     end:
 */
 static void compileIf(struct piccolo_IfNode* ifNode, COMPILE_PARAMS) {
-    compileExpr(ifNode->condition, COMPILE_ARGS);
-
-    int skipTrueAddr = bytecode->code.count;
-    piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_JUMP_FALSE, 0, ifNode->conditionCharIdx);
+    int skipTrueAddr = compileConditionJump(ifNode->condition, ifNode->conditionCharIdx, COMPILE_ARGS);
+    int branchDepth = compiler->stackDepth;
     compileExpr(ifNode->trueVal, COMPILE_ARGS);
+    compiler->stackDepth = branchDepth;
 
     int skipFalseAddr = bytecode->code.count;
     piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_JUMP, 0, ifNode->conditionCharIdx);
 
     int falseStartAddr = bytecode->code.count;
-    piccolo_patchParam(bytecode, skipTrueAddr, falseStartAddr - skipTrueAddr);
+    patchConditionJump(bytecode, skipTrueAddr, falseStartAddr);
 
     if(ifNode->falseVal != NULL) {
         compileExpr(ifNode->falseVal, COMPILE_ARGS);
     } else {
-        if(ifNode->expr.reqEval)
+        if(ifNode->expr.reqEval) {
             piccolo_writeConst(engine, bytecode, PICCOLO_NIL_VAL(), 0);
+            adjustStack(compiler, 1);
+        }
     }
 
     int endAddr = bytecode->code.count;
@@ -847,115 +1627,167 @@ static void compileIf(struct piccolo_IfNode* ifNode, COMPILE_PARAMS) {
 }
 
 static void compileWhile(struct piccolo_WhileNode* whileNode, COMPILE_PARAMS) {
-    if(whileNode->expr.reqEval)
+    if(whileNode->expr.reqEval) {
         piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_CREATE_ARRAY, 0, 0);
+        adjustStack(compiler, 1);
+    }
     int loopStartAddr = bytecode->code.count;
-    compileExpr(whileNode->condition, COMPILE_ARGS);
-    int skipLoopAddr = bytecode->code.count;
-    piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_JUMP_FALSE, 0, whileNode->conditionCharIdx);
+    int skipLoopAddr = compileConditionJump(whileNode->condition, whileNode->conditionCharIdx, COMPILE_ARGS);
     compileExpr(whileNode->value, COMPILE_ARGS);
-    if(whileNode->expr.reqEval)
+    if(whileNode->expr.reqEval) {
         piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_APPEND, 0);
+        adjustStack(compiler, -1);
+    }
     int valueEndAddr = bytecode->code.count;
     piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_REV_JUMP, valueEndAddr - loopStartAddr, whileNode->conditionCharIdx);
     int loopEndAddr = bytecode->code.count;
-    piccolo_patchParam(bytecode, skipLoopAddr, loopEndAddr - skipLoopAddr);
+    patchConditionJump(bytecode, skipLoopAddr, loopEndAddr);
 }
 
-static void compileFor(struct piccolo_ForNode* forNode, COMPILE_PARAMS) {
-    /*
-
-        Not req val:
-
-            container idx
-            container idx container
-            container idx container idx
-            container idx element
-            container idx
-            - for loop body -
-            container idx
-            container idxNext
-        
-
-        Req Val:
+static void endFor(struct piccolo_ForNode* forNode, int slot, int breakLoopAddr, COMPILE_PARAMS) {
+    int loopEndAddr = bytecode->code.count;
+    piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_CLOSE_UPVALS, slot, forNode->charIdx);
+    if(forNode->expr.reqEval) {
+        // The result replaces the loop variable, everything above it is popped
+        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_GET_LOCAL, slot + 1, forNode->charIdx);
+        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_SET_LOCAL, slot, forNode->charIdx);
+        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_POP_LOCALS, 4, forNode->charIdx);
+        adjustStack(compiler, 1);
+        adjustStack(compiler, -4);
+    } else {
+        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_POP_LOCALS, 3, forNode->charIdx);
+        adjustStack(compiler, -3);
+    }
 
-            container idx result
-            container idx result container
-            container idx result container idx
-            container idx result element
-            container idx result
-            - for loop body -
-            container idx result bodyVal
-            container idx (result + bodyVal)
-            container (result + bodyVal) idx
-            container (result + bodyVal) idxNext
-            container (idx + 1) (result + bodyVal)
+    piccolo_patchParam(bytecode, breakLoopAddr, loopEndAddr - breakLoopAddr);
+}
 
-    */
+static void compileCountedFor(struct piccolo_ForNode* forNode, int slot, COMPILE_PARAMS) {
+    /*
+        A loop over a range literal counts from the start to the end of the range in
+        place of the container and idx instead of creating the range.
 
-    struct piccolo_VarData varData = piccolo_getVariable(engine, compiler, forNode->name);
-    int slot = -1;
-    if(varData.slot != -1) {
-        piccolo_compilationError(engine, compiler, forNode->name.charIdx, "Variable %.*s is already defined", forNode->name.length, forNode->name.start);
-    } else {
-        slot = compiler->locals.count;
-        struct piccolo_Variable var = createVar(forNode->name, slot);
-        var.Mutable = false;
-        piccolo_writeVariableArray(engine, &compiler->locals, var);
-        piccolo_writeConst(engine, bytecode, PICCOLO_NIL_VAL(), 0);
-        piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_PUSH_LOCAL, 0);
-        piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_POP_STACK, 0);
-    }
+            [result] end counter
+     */
+    struct piccolo_RangeNode* range = (struct piccolo_RangeNode*)forNode->container;
+    int endSlot = compiler->stackDepth;
+    int counterSlot = endSlot + 1;
 
-    compileExpr(forNode->container, COMPILE_ARGS); // container
-    piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_ITER_FIRST, forNode->charIdx); // idx
+    compileExpr(range->left, COMPILE_ARGS);
+    compileExpr(range->right, COMPILE_ARGS);
+    piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_RANGE_FIRST, range->charIdx); // end counter
     if(forNode->expr.reqEval)
-        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_CREATE_ARRAY, 0, forNode->charIdx); // result
+        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_ACC_CREATE, slot + 1, forNode->charIdx);
 
-    int peekDist = forNode->expr.reqEval ? 3 : 2;
     int loopStartAddr = bytecode->code.count;
-    
-    piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_PEEK_STACK, peekDist, forNode->charIdx);
-    piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_PEEK_STACK, peekDist, forNode->charIdx);
-    piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_ITER_CONT, forNode->charIdx);
+
+    piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_GET_LOCAL, counterSlot, forNode->charIdx);
+    piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_GET_LOCAL, endSlot, forNode->charIdx);
+    piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_LESS, forNode->charIdx);
     int breakLoopAddr = bytecode->code.count;
     piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_JUMP_FALSE, 0, forNode->charIdx);
+    adjustStack(compiler, 2);
+    adjustStack(compiler, -2);
 
-    piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_PEEK_STACK, peekDist, forNode->charIdx); // container
-    piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_PEEK_STACK, peekDist, forNode->charIdx); // idx
-    piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_ITER_GET, forNode->charIdx); // element
+    piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_GET_LOCAL, counterSlot, forNode->charIdx);
     piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_SET_LOCAL, slot, forNode->charIdx);
     piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_POP_STACK, forNode->charIdx);
 
     compileExpr(forNode->value, COMPILE_ARGS);
 
     if(forNode->expr.reqEval) {
-        piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_APPEND, forNode->charIdx);
-        piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_SWAP_STACK, forNode->charIdx);
+        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_ACC_APPEND, slot + 1, forNode->charIdx);
+        adjustStack(compiler, -1);
     }
 
-    piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_ITER_NEXT, peekDist, forNode->charIdx);
-
-    if(forNode->expr.reqEval) {
-        piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_SWAP_STACK, forNode->charIdx);
-    }
+    // Fused into ADD_CONST_LOCAL
+    piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_GET_LOCAL, counterSlot, forNode->charIdx);
+    piccolo_writeConst(engine, bytecode, PICCOLO_NUM_VAL(1), forNode->charIdx);
+    piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_ADD, forNode->charIdx);
+    piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_SET_LOCAL, counterSlot, forNode->charIdx);
+    piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_POP_STACK, forNode->charIdx);
+    adjustStack(compiler, 2);
+    adjustStack(compiler, -2);
 
     piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_REV_JUMP, bytecode->code.count - loopStartAddr, 0);
 
-    int loopEndAddr = bytecode->code.count;
+    endFor(forNode, slot, breakLoopAddr, COMPILE_ARGS);
+}
+
+static void compileFor(struct piccolo_ForNode* forNode, COMPILE_PARAMS) {
+    /*
+
+        The loop variable gets a slot below the loop's values, it's popped together with them.
+        If the value of the loop is needed, the result array gets the slot above the loop
+        variable. ACC_CREATE fills that slot once the container is known, so the array can be
+        sized for the container, and ACC_APPEND adds to it without moving it.
+
+            [result] container idx
+            [result] container idx container
+            [result] container idx container idx
+            [result] container idx element
+            [result] container idx
+            - for loop body -
+            [result] container idx [bodyVal]
+            [result] container idx
+            [result] container idxNext
+
+    */
+
+    struct piccolo_VarData varData = piccolo_getVariable(engine, compiler, forNode->name);
+    int slot = compiler->stackDepth;
+    if(varData.slot != -1) {
+        piccolo_compilationError(engine, compiler, forNode->name.charIdx, "Variable %.*s is already defined", forNode->name.length, forNode->name.start);
+    } else {
+        struct piccolo_Variable var = createVar(forNode->name, slot);
+        var.Mutable = false;
+        piccolo_writeVariableArray(engine, &compiler->locals, var);
+    }
+    piccolo_writeConst(engine, bytecode, PICCOLO_NIL_VAL(), 0);
+    adjustStack(compiler, 1);
     if(forNode->expr.reqEval) {
-        piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_SWAP_STACK, forNode->charIdx);
-        piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_POP_STACK, forNode->charIdx);
-        piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_SWAP_STACK, forNode->charIdx);
-        piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_POP_STACK, forNode->charIdx);
+        piccolo_writeConst(engine, bytecode, PICCOLO_NIL_VAL(), 0);
+        adjustStack(compiler, 1);
+    }
+
+    if(forNode->container->type == PICCOLO_EXPR_RANGE) {
+        compileCountedFor(forNode, slot, COMPILE_ARGS);
     } else {
+        compileExpr(forNode->container, COMPILE_ARGS); // container
+        piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_ITER_FIRST, forNode->charIdx); // idx
+        adjustStack(compiler, 1);
+        if(forNode->expr.reqEval)
+            piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_ACC_CREATE, slot + 1, forNode->charIdx);
+
+        int loopStartAddr = bytecode->code.count;
+
+        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_PEEK_STACK, 2, forNode->charIdx);
+        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_PEEK_STACK, 2, forNode->charIdx);
+        piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_ITER_CONT, forNode->charIdx);
+        int breakLoopAddr = bytecode->code.count;
+        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_JUMP_FALSE, 0, forNode->charIdx);
+        // Both the condition and the element are computed from a peeked container and idx
+        adjustStack(compiler, 2);
+        adjustStack(compiler, -2);
+
+        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_PEEK_STACK, 2, forNode->charIdx); // container
+        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_PEEK_STACK, 2, forNode->charIdx); // idx
+        piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_ITER_GET, forNode->charIdx); // element
+        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_SET_LOCAL, slot, forNode->charIdx);
         piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_POP_STACK, forNode->charIdx);
-        piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_POP_STACK, forNode->charIdx);
-    }
-    
-    piccolo_patchParam(bytecode, breakLoopAddr, loopEndAddr - breakLoopAddr);
 
-    piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_POP_LOCALS, 1, 0);
+        compileExpr(forNode->value, COMPILE_ARGS);
+
+        if(forNode->expr.reqEval) {
+            piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_ACC_APPEND, slot + 1, forNode->charIdx);
+            adjustStack(compiler, -1);
+        }
+
+        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_ITER_NEXT, 2, forNode->charIdx);
+        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_REV_JUMP, bytecode->code.count - loopStartAddr, 0);
+
+        endFor(forNode, slot, breakLoopAddr, COMPILE_ARGS);
+    }
 
     if(varData.slot == -1) {
         compiler->locals.count--;
@@ -964,7 +1796,14 @@ static void compileFor(struct piccolo_ForNode* forNode, COMPILE_PARAMS) {
 }
 
 static void compileCall(struct piccolo_CallNode* call, COMPILE_PARAMS) {
-    compileExpr(call->function, COMPILE_ARGS);
+    // obj.method(args) leaves the receiver where the function would be and looks the method up with INVOKE
+    struct piccolo_SubscriptNode* method = NULL;
+    if(call->function->type == PICCOLO_EXPR_SUBSCRIPT) {
+        method = (struct piccolo_SubscriptNode*)call->function;
+        compileExpr(method->value, COMPILE_ARGS);
+    } else {
+        compileExpr(call->function, COMPILE_ARGS);
+    }
     int argCount = 0;
     struct piccolo_ExprNode* currArg = call->firstArg;
     while(currArg != NULL) {
@@ -972,9 +1811,20 @@ static void compileCall(struct piccolo_CallNode* call, COMPILE_PARAMS) {
         argCount++;
         currArg = currArg->nextExpr;
     }
-    piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_CALL, argCount, call->charIdx);
-    if(!call->expr.reqEval)
+    if(method != NULL) {
+        struct piccolo_ObjString* nameStr = piccolo_copyString(engine, method->subscript.start, method->subscript.length);
+        int nameIdx = bytecode->constants.count;
+        piccolo_writeValueArray(engine, &bytecode->constants, PICCOLO_OBJ_VAL(nameStr));
+        int cacheIdx = piccolo_addInlineCache(engine, bytecode);
+        piccolo_writeParameteredBytecode(engine, bytecode, PICCOLO_OP_INVOKE, nameIdx, method->subscript.charIdx);
+        piccolo_writeParam(engine, bytecode, cacheIdx, method->subscript.charIdx);
+    }
+    piccolo_writeParameteredBytecode(engine, bytecode, call->tailCall ? PICCOLO_OP_TAIL_CALL : PICCOLO_OP_CALL, argCount, call->charIdx);
+    adjustStack(compiler, -argCount);
+    if(!call->expr.reqEval) {
         piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_POP_STACK, call->charIdx);
+        adjustStack(compiler, -1);
+    }
 }
 
 static void compileImport(struct piccolo_ImportNode* import, COMPILE_PARAMS) {
@@ -984,8 +1834,11 @@ static void compileImport(struct piccolo_ImportNode* import, COMPILE_PARAMS) {
     } else {
         piccolo_writeConst(engine, bytecode, PICCOLO_OBJ_VAL(package), import->packageName.charIdx);
         piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_EXECUTE_PACKAGE, import->packageName.charIdx);
-        if(!import->expr.reqEval)
+        adjustStack(compiler, 1);
+        if(!import->expr.reqEval) {
             piccolo_writeBytecode(engine, bytecode, PICCOLO_OP_POP_STACK, import->packageName.charIdx);
+            adjustStack(compiler, -1);
+        }
     }
     import->package = package;
 }
@@ -1037,10 +1890,18 @@ static void compileExpr(struct piccolo_ExprNode* expr, COMPILE_PARAMS) {
             compileFnLiteral((struct piccolo_FnLiteralNode*)expr, COMPILE_ARGS);
             break;
         }
+        case PICCOLO_EXPR_TUPLE: {
+            compileTuple((struct piccolo_TupleNode*)expr, COMPILE_ARGS);
+            break;
+        }
         case PICCOLO_EXPR_VAR_DECL: {
             compileVarDecl((struct piccolo_VarDeclNode*)expr, COMPILE_ARGS);
             break;
         }
+        case PICCOLO_EXPR_DESTRUCTURE: {
+            compileDestructure((struct piccolo_DestructureNode*)expr, COMPILE_ARGS);
+            break;
+        }
         case PICCOLO_EXPR_VAR_SET: {
             compileVarSet((struct piccolo_VarSetNode*)expr, COMPILE_ARGS);
             break;
@@ -1132,6 +1993,8 @@ bool piccolo_compilePackage(struct piccolo_Engine* engine, struct piccolo_Packag
     freeCompiler(engine, &compiler);
 
     piccolo_writeBytecode(engine, &package->bytecode, PICCOLO_OP_RETURN, 0);
+    package->bytecode.maxStack = compiler.maxStackDepth;
+    piccolo_fuseInstructions(&package->bytecode);
     // piccolo_disassembleBytecode(&package->bytecode);
 
     package->compiled = true;
@@ -49,6 +49,14 @@ struct piccolo_Compiler {
     struct piccolo_UpvalueArray upvals;
     struct piccolo_Compiler* enclosing;
     bool hadError;
+
+    // Number of values the code compiled so far keeps on the stack of the frame, and its maximum
+    int stackDepth;
+    int maxStackDepth;
+    // Stack slot of the next local of the innermost block, and the slots reserved for its current statement
+    int blockTop;
+    int nextReserved;
+    int reservedEnd;
 };
 
 struct piccolo_Package* piccolo_resolvePackage(struct piccolo_Engine* engine, struct piccolo_Compiler* compiler, const char* sourceFilepath, const char* name, size_t nameLen);
@@ -6,6 +6,13 @@ static uint16_t getInstructionParam(struct piccolo_Bytecode* bytecode, int offse
     return (bytecode->code.values[offset + 1] << 8) + (bytecode->code.values[offset + 2] << 0);
 }
 
+static void printRegOperand(uint16_t operand) {
+    if(operand & PICCOLO_REG_CONST_BIT)
+        printf(" c%d", operand & ~PICCOLO_REG_CONST_BIT);
+    else
+        printf(" r%d", operand);
+}
+
 int piccolo_disassembleInstruction(struct piccolo_Bytecode* bytecode, int offset) {
 #define SIMPLE_INSTRUCTION(opcode)       \
     case PICCOLO_ ## opcode: {           \
@@ -18,6 +25,23 @@ int piccolo_disassembleInstruction(struct piccolo_Bytecode* bytecode, int offset
         return offset + 3;               \
     }
 
+#define REG_INSTRUCTION(opcode, params)  \
+    case PICCOLO_ ## opcode: {           \
+        printf(#opcode);                 \
+        for(int i = 0; i < params; i++)  \
+            printRegOperand(getInstructionParam(bytecode, offset + 2 * i)); \
+        printf("\n");                    \
+        return offset + 1 + 2 * params;  \
+    }
+#define REG_JUMP_INSTRUCTION(opcode)     \
+    case PICCOLO_ ## opcode: {           \
+        printf(#opcode);                 \
+        printRegOperand(getInstructionParam(bytecode, offset));     \
+        printRegOperand(getInstructionParam(bytecode, offset + 2)); \
+        printf(" %d\n", getInstructionParam(bytecode, offset + 4)); \
+        return offset + 7;               \
+    }
+
     printf("%4d | ", offset);
     switch(bytecode->code.values[offset]) {
         SIMPLE_INSTRUCTION(OP_RETURN)
@@ -38,15 +62,28 @@ int piccolo_disassembleInstruction(struct piccolo_Bytecode* bytecode, int offset
         SIMPLE_INSTRUCTION(OP_LESS)
         SIMPLE_INSTRUCTION(OP_NEGATE)
         SIMPLE_INSTRUCTION(OP_NOT)
+        SIMPLE_INSTRUCTION(OP_BIT_AND)
+        SIMPLE_INSTRUCTION(OP_BIT_OR)
+        SIMPLE_INSTRUCTION(OP_BIT_XOR)
+        SIMPLE_INSTRUCTION(OP_SHIFT_LEFT)
+        SIMPLE_INSTRUCTION(OP_SHIFT_RIGHT)
+        SIMPLE_INSTRUCTION(OP_BIT_NOT)
 
         SIMPLE_INSTRUCTION(OP_POP_STACK)
         PARAM_INSTRUCTION(OP_PEEK_STACK)
         SIMPLE_INSTRUCTION(OP_SWAP_STACK)
 
         PARAM_INSTRUCTION(OP_CREATE_ARRAY)
+        PARAM_INSTRUCTION(OP_UNPACK)
         SIMPLE_INSTRUCTION(OP_CREATE_RANGE)
         SIMPLE_INSTRUCTION(OP_GET_IDX)
         SIMPLE_INSTRUCTION(OP_SET_IDX)
+        case PICCOLO_OP_GET_MEMBER: {
+            printf("OP_GET_MEMBER { ");
+            piccolo_printValue(bytecode->constants.values[getInstructionParam(bytecode, offset)]);
+            printf(" } %d\n", getInstructionParam(bytecode, offset + 2));
+            return offset + 5;
+        }
 
         SIMPLE_INSTRUCTION(OP_HASHMAP)
 
@@ -54,7 +91,6 @@ int piccolo_disassembleInstruction(struct piccolo_Bytecode* bytecode, int offset
         PARAM_INSTRUCTION(OP_SET_GLOBAL)
         PARAM_INSTRUCTION(OP_GET_LOCAL)
         PARAM_INSTRUCTION(OP_SET_LOCAL)
-        SIMPLE_INSTRUCTION(OP_PUSH_LOCAL)
         PARAM_INSTRUCTION(OP_POP_LOCALS)
 
         PARAM_INSTRUCTION(OP_JUMP)
@@ -63,6 +99,14 @@ int piccolo_disassembleInstruction(struct piccolo_Bytecode* bytecode, int offset
         PARAM_INSTRUCTION(OP_REV_JUMP_FALSE)
 
         PARAM_INSTRUCTION(OP_CALL)
+        PARAM_INSTRUCTION(OP_TAIL_CALL)
+        PARAM_INSTRUCTION(OP_RETURN_VALUES)
+        case PICCOLO_OP_INVOKE: {
+            printf("OP_INVOKE { ");
+            piccolo_printValue(bytecode->constants.values[getInstructionParam(bytecode, offset)]);
+            printf(" } %d\n", getInstructionParam(bytecode, offset + 2));
+            return offset + 5;
+        }
 
         case PICCOLO_OP_CLOSURE: {
             int upvals = getInstructionParam(bytecode, offset);
@@ -74,20 +118,54 @@ int piccolo_disassembleInstruction(struct piccolo_Bytecode* bytecode, int offset
         }
         PARAM_INSTRUCTION(OP_GET_UPVAL)
         PARAM_INSTRUCTION(OP_SET_UPVAL)
-        SIMPLE_INSTRUCTION(OP_CLOSE_UPVALS)
+        PARAM_INSTRUCTION(OP_CLOSE_UPVALS)
 
         SIMPLE_INSTRUCTION(OP_GET_LEN)
         SIMPLE_INSTRUCTION(OP_APPEND)
+        PARAM_INSTRUCTION(OP_ACC_CREATE)
+        PARAM_INSTRUCTION(OP_ACC_APPEND)
         SIMPLE_INSTRUCTION(OP_IN)
+        SIMPLE_INSTRUCTION(OP_ITER_FIRST)
         SIMPLE_INSTRUCTION(OP_ITER_CONT)
         PARAM_INSTRUCTION(OP_ITER_NEXT)
         SIMPLE_INSTRUCTION(OP_ITER_GET)
+        SIMPLE_INSTRUCTION(OP_RANGE_FIRST)
 
         SIMPLE_INSTRUCTION(OP_EXECUTE_PACKAGE)
+
+        SIMPLE_INSTRUCTION(OP_ADD_NUM_NUM)
+        SIMPLE_INSTRUCTION(OP_SUB_NUM_NUM)
+        SIMPLE_INSTRUCTION(OP_MUL_NUM_NUM)
+        SIMPLE_INSTRUCTION(OP_DIV_NUM_NUM)
+        SIMPLE_INSTRUCTION(OP_GREATER_NUM_NUM)
+        SIMPLE_INSTRUCTION(OP_LESS_NUM_NUM)
+
+        PARAM_INSTRUCTION(OP_ADD_CONST_LOCAL)
+        PARAM_INSTRUCTION(OP_ADD_CONST_GLOBAL)
+        SIMPLE_INSTRUCTION(OP_LESS_JUMP_FALSE)
+        SIMPLE_INSTRUCTION(OP_GREATER_JUMP_FALSE)
+        SIMPLE_INSTRUCTION(OP_NOT_EQUAL)
+        PARAM_INSTRUCTION(OP_ITER_LOOP)
+
+        REG_INSTRUCTION(OP_REG_MOVE, 2)
+        REG_INSTRUCTION(OP_REG_ADD, 3)
+        REG_INSTRUCTION(OP_REG_SUB, 3)
+        REG_INSTRUCTION(OP_REG_MUL, 3)
+        REG_INSTRUCTION(OP_REG_DIV, 3)
+        REG_INSTRUCTION(OP_REG_MOD, 3)
+        REG_JUMP_INSTRUCTION(OP_REG_LESS_JUMP_FALSE)
+        REG_JUMP_INSTRUCTION(OP_REG_LESS_EQ_JUMP_FALSE)
+        REG_JUMP_INSTRUCTION(OP_REG_GREATER_JUMP_FALSE)
+        REG_JUMP_INSTRUCTION(OP_REG_GREATER_EQ_JUMP_FALSE)
+        REG_JUMP_INSTRUCTION(OP_REG_EQUAL_JUMP_FALSE)
+        REG_JUMP_INSTRUCTION(OP_REG_NOT_EQUAL_JUMP_FALSE)
     }
     printf("Unknown Opcode.\n");
     return offset + 1;
 #undef SIMPLE_INSTRUCTION
+#undef PARAM_INSTRUCTION
+#undef REG_INSTRUCTION
+#undef REG_JUMP_INSTRUCTION
 }
 
 void piccolo_disassembleBytecode(struct piccolo_Bytecode* bytecode) {
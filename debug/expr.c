@@ -104,12 +104,27 @@ void piccolo_printExpr(struct piccolo_ExprNode* expr, int offset) {
             piccolo_printExpr(fnLiteral->value, offset + 1);
             break;
         }
+        case PICCOLO_EXPR_TUPLE: {
+            struct piccolo_TupleNode* tuple = (struct piccolo_TupleNode*)expr;
+            printf(tuple->returned ? "TUPLE (RETURNED) -> %s\n" : "TUPLE -> %s\n", typeBuf);
+            piccolo_printExpr(tuple->first, offset + 1);
+            break;
+        }
         case PICCOLO_EXPR_VAR_DECL: {
             struct piccolo_VarDeclNode* varDecl = (struct piccolo_VarDeclNode*)expr;
             printf("VAR DECL %.*s -> %s\n", (int)varDecl->name.length, varDecl->name.start, typeBuf);
             piccolo_printExpr(varDecl->value, offset + 1);
             break;
         }
+        case PICCOLO_EXPR_DESTRUCTURE: {
+            struct piccolo_DestructureNode* destructure = (struct piccolo_DestructureNode*)expr;
+            printf("DESTRUCTURE ");
+            for(struct piccolo_VarDeclNode* curr = destructure->first; curr != NULL; curr = (struct piccolo_VarDeclNode*)curr->expr.nextExpr)
+                printf("%.*s ", (int)curr->name.length, curr->name.start);
+            printf("-> %s\n", typeBuf);
+            piccolo_printExpr(destructure->value, offset + 1);
+            break;
+        }
         case PICCOLO_EXPR_VAR_SET: {
             struct piccolo_VarSetNode* varSet = (struct piccolo_VarSetNode*)expr;
             printf("VAR SET %.*s -> %s\n", (int)varSet->name.length, varSet->name.start, typeBuf);
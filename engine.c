@@ -5,8 +5,10 @@
 #include <stdarg.h>
 #include <string.h>
 #include <math.h>
+#include <inttypes.h>
 
 #include "util/strutil.h"
+#include "util/clock.h"
 #include "object.h"
 #include "gc.h"
 #include "limits.h"
@@ -19,28 +21,58 @@
 #endif
 
 #define PICCOLO_MAX_FRAMES 1024
+#define PICCOLO_MAX_STACK (1024 * 1024)
 
 PICCOLO_DYNARRAY_IMPL(struct piccolo_Package*, Package)
 PICCOLO_DYNARRAY_IMPL(const char*, String)
+PICCOLO_DYNARRAY_IMPL(struct piccolo_Obj*, ObjRef)
 PICCOLO_DYNARRAY_IMPL(struct piccolo_CallFrame, CallFrame)
 
 void piccolo_initEngine(struct piccolo_Engine* engine, void (*printError)(const char* format, va_list)) {
-    piccolo_initValueArray(&engine->locals);
     engine->printError = printError;
-    engine->stackTop = engine->stack;
     engine->openUpvals = NULL;
     engine->liveMemory = 0;
     engine->gcThreshold = 1024 * 64;
-    engine->objs = NULL;
+    engine->oldMemory = 0;
+    engine->youngMemory = 0;
+    engine->nurserySize = 1024 * 256;
+    engine->gcPending = false;
+    engine->budget = engine->budgetSlice = INT64_MAX;
+    engine->budgetSteps = -1;
+    engine->budgetDeadline = -1;
+    engine->budgetBase = -1;
+    engine->suspended = false;
+    engine->coroutine = NULL;
+    engine->yielding = false;
+    for(int i = 0; i < PICCOLO_SLAB_CLASSES; i++) {
+        engine->slabs[i].pages = engine->slabs[i].sweepPages = NULL;
+        engine->slabs[i].free = NULL;
+    }
+    piccolo_initObjRefArray(&engine->largeObjs);
+    piccolo_initObjRefArray(&engine->youngObjs);
+    piccolo_initObjRefArray(&engine->youngLarge);
+    piccolo_initObjRefArray(&engine->remembered);
+    piccolo_initObjRefArray(&engine->gray);
+    engine->gcState = PICCOLO_GC_IDLE;
+    engine->gcEpoch = 1;
+    engine->gcPauseUsecs = 0;
+    engine->gcThreads = 1;
+    engine->gcMarker = NULL;
+    piccolo_initObjRefArray(&engine->sweepLarge);
+    engine->sweepLargeIdx = 0;
+    engine->sweepClass = 0;
     engine->types = NULL;
     piccolo_initPackageArray(&engine->packages);
     piccolo_initCallFrameArray(&engine->callFrames);
     piccolo_initStringArray(&engine->searchPaths);
-    piccolo_initValueArray(&engine->locals);
     engine->findPackage = NULL;
+    engine->backend = PICCOLO_BACKEND_STACK;
 #ifdef PICCOLO_ENABLE_MEMORY_TRACKER
     engine->track = NULL;
 #endif
+    engine->stack = PICCOLO_REALLOCATE("stack", engine, NULL, 0, sizeof(piccolo_Value) * 256);
+    engine->stackTop = engine->stack;
+    engine->stackEnd = engine->stack + 256;
 }
 
 #define CURR_FRAME engine->callFrames.values[engine->callFrames.count - 1]
@@ -49,14 +81,9 @@ void piccolo_freeEngine(struct piccolo_Engine* engine) {
     for(int i = 0; i < engine->packages.count; i++)
         piccolo_freePackage(engine, engine->packages.values[i]);
     piccolo_freePackageArray(engine, &engine->packages);
-    struct piccolo_Obj* curr = engine->objs;
-    while(curr != NULL) {
-        struct piccolo_Obj* toFree = curr;
-        curr = curr->next;
-        piccolo_freeObj(engine, toFree);
-    }
+    piccolo_gcFreeHeap(engine);
 
-    piccolo_freeValueArray(engine, &engine->locals);
+    PICCOLO_REALLOCATE("stack", engine, engine->stack, sizeof(piccolo_Value) * (engine->stackEnd - engine->stack), 0);
     piccolo_freeCallFrameArray(engine, &engine->callFrames);
     piccolo_freeStringArray(engine, &engine->searchPaths);
 
@@ -71,6 +98,26 @@ void piccolo_freeEngine(struct piccolo_Engine* engine) {
 
 
 #include <stdio.h>
+static const struct piccolo_NativeMethod* findMethod(struct piccolo_ObjNativeStruct* nativeStruct, struct piccolo_ObjString* name) {
+    const struct piccolo_NativeMethod* method = nativeStruct->methods;
+    while(method != NULL && method->name != NULL) {
+        if(strcmp(method->name, name->string) == 0)
+            return method;
+        method++;
+    }
+    return NULL;
+}
+
+// Indices can be nums or ints. Nums are truncated, ones too large for an int come out as -1.
+static int64_t toIndex(piccolo_Value idx) {
+    if(PICCOLO_IS_INT(idx))
+        return PICCOLO_AS_INT(idx);
+    double num = PICCOLO_AS_NUM(idx);
+    if(!(num > -9223372036854775808.0 && num < 9223372036854775808.0))
+        return -1;
+    return (int64_t)num;
+}
+
 static piccolo_Value indexing(struct piccolo_Engine* engine, struct piccolo_Obj* container, piccolo_Value idx, bool set, piccolo_Value value) {
     switch(container->type) {
         case PICCOLO_OBJ_STRING: {
@@ -79,7 +126,7 @@ static piccolo_Value indexing(struct piccolo_Engine* engine, struct piccolo_Obj*
                 piccolo_runtimeError(engine, "Strings are immutable.");
                 return PICCOLO_NIL_VAL();
             }
-            if(!PICCOLO_IS_NUM(idx)) {
+            if(!PICCOLO_IS_NUMERIC(idx)) {
                 if(PICCOLO_IS_OBJ(idx) && PICCOLO_AS_OBJ(idx)->type == PICCOLO_OBJ_STRING) {
                     struct piccolo_ObjString* str = (struct piccolo_ObjString*)PICCOLO_AS_OBJ(idx);
                     if(str->len == 6 && strcmp(str->string, "length") == 0) {
@@ -98,9 +145,9 @@ static piccolo_Value indexing(struct piccolo_Engine* engine, struct piccolo_Obj*
                 }
                 return PICCOLO_NIL_VAL();
             }
-            int idxNum = PICCOLO_AS_NUM(idx);
+            int64_t idxNum = toIndex(idx);
             if(idxNum < 0 || idxNum >= string->len) {
-                piccolo_runtimeError(engine, "Index %d out of bounds.", idxNum);
+                piccolo_runtimeError(engine, "Index %" PRId64 " out of bounds.", idxNum);
                 return PICCOLO_NIL_VAL();
             }
 
@@ -119,7 +166,7 @@ static piccolo_Value indexing(struct piccolo_Engine* engine, struct piccolo_Obj*
         }
         case PICCOLO_OBJ_ARRAY: {
             struct piccolo_ObjArray* array = (struct piccolo_ObjArray*)container;
-            if(!PICCOLO_IS_NUM(idx)) {
+            if(!PICCOLO_IS_NUMERIC(idx)) {
                 if(PICCOLO_IS_OBJ(idx) && PICCOLO_AS_OBJ(idx)->type == PICCOLO_OBJ_STRING) {
                     struct piccolo_ObjString* str = (struct piccolo_ObjString*)PICCOLO_AS_OBJ(idx);
                     if(str->len == 6 && strcmp(str->string, "length") == 0) {
@@ -139,7 +186,7 @@ static piccolo_Value indexing(struct piccolo_Engine* engine, struct piccolo_Obj*
                 }
                 return PICCOLO_NIL_VAL();
             }
-            int idxNum = PICCOLO_AS_NUM(idx);
+            int64_t idxNum = toIndex(idx);
             if(idxNum < 0 || idxNum >= array->array.count) {
                 piccolo_runtimeError(engine, "Array index out of bounds.");
                 return PICCOLO_NIL_VAL();
@@ -147,12 +194,33 @@ static piccolo_Value indexing(struct piccolo_Engine* engine, struct piccolo_Obj*
 
             if(set) {
                 array->array.values[idxNum] = value;
+                piccolo_gcWriteBarrier(engine, container, value);
                 return value;
             } else {
                 return array->array.values[idxNum];
             }
             break;
         }
+        case PICCOLO_OBJ_RANGE: {
+            struct piccolo_ObjRange* range = (struct piccolo_ObjRange*)container;
+            if(set)
+                return indexing(engine, (struct piccolo_Obj*)piccolo_rangeToArray(engine, range), idx, set, value);
+            if(PICCOLO_IS_NUMERIC(idx)) {
+                int64_t idxNum = toIndex(idx);
+                if(idxNum < 0 || idxNum >= piccolo_rangeLength(range)) {
+                    piccolo_runtimeError(engine, "Array index out of bounds.");
+                    return PICCOLO_NIL_VAL();
+                }
+                return PICCOLO_NUM_VAL(range->start + idxNum);
+            }
+            if(PICCOLO_IS_STRING(idx)) {
+                struct piccolo_ObjString* str = (struct piccolo_ObjString*)PICCOLO_AS_OBJ(idx);
+                if(str->len == 6 && strcmp(str->string, "length") == 0)
+                    return PICCOLO_NUM_VAL(piccolo_rangeLength(range));
+            }
+            piccolo_runtimeError(engine, "Cannot index array with %s.", piccolo_getTypeName(idx));
+            return PICCOLO_NIL_VAL();
+        }
         case PICCOLO_OBJ_HASHMAP: {
             struct piccolo_ObjHashmap* hashmap = (struct piccolo_ObjHashmap*)container;
             if(set) {
@@ -160,6 +228,8 @@ static piccolo_Value indexing(struct piccolo_Engine* engine, struct piccolo_Obj*
                 val.exists = true;
                 val.value = value;
                 piccolo_setHashmap(engine, &hashmap->hashmap, idx, val);
+                piccolo_gcWriteBarrier(engine, container, idx);
+                piccolo_gcWriteBarrier(engine, container, value);
                 return value;
             } else {
                 struct piccolo_HashmapValue result = piccolo_getHashmap(engine, &hashmap->hashmap, idx);
@@ -200,6 +270,19 @@ static piccolo_Value indexing(struct piccolo_Engine* engine, struct piccolo_Obj*
         }
         case PICCOLO_OBJ_NATIVE_STRUCT: {
             struct piccolo_ObjNativeStruct* nativeStruct = (struct piccolo_ObjNativeStruct*)container;
+            if(PICCOLO_IS_STRING(idx)) {
+                // Only a method that is not called right away needs its own bound native
+                const struct piccolo_NativeMethod* method = findMethod(nativeStruct, (struct piccolo_ObjString*)PICCOLO_AS_OBJ(idx));
+                if(method != NULL) {
+                    if(set) {
+                        piccolo_runtimeError(engine, "Cannot set %s.", method->name);
+                        return PICCOLO_NIL_VAL();
+                    }
+                    struct piccolo_ObjNativeFn* bound = piccolo_makeBoundNative(engine, method->native, PICCOLO_OBJ_VAL(container));
+                    bound->arity = method->arity;
+                    return PICCOLO_OBJ_VAL(bound);
+                }
+            }
             if(nativeStruct->index != NULL) {
                 return nativeStruct->index(PICCOLO_GET_PAYLOAD(nativeStruct, void), engine, idx, set, value);
             } else {
@@ -218,8 +301,403 @@ static piccolo_Value indexing(struct piccolo_Engine* engine, struct piccolo_Obj*
     return PICCOLO_NIL_VAL();
 }
 
-static bool shouldCloseUpval(struct piccolo_Engine* engine, struct piccolo_ObjUpval* upval) {
-    return upval->val.idx >= engine->locals.count;
+/*
+    Ints wrap around on overflow like unsigned C arithmetic. Arithmetic mixing an int and a num is
+    done on nums.
+ */
+static inline int64_t wrapAdd(int64_t a, int64_t b) {
+    return (int64_t)((uint64_t)a + (uint64_t)b);
+}
+
+static inline int64_t wrapSub(int64_t a, int64_t b) {
+    return (int64_t)((uint64_t)a - (uint64_t)b);
+}
+
+static inline int64_t wrapMul(int64_t a, int64_t b) {
+    return (int64_t)((uint64_t)a * (uint64_t)b);
+}
+
+/*
+    Slow paths of the arithmetic instructions. a is the left operand and b the right one. On
+    failure these report a runtime error and return nil.
+ */
+static piccolo_Value addValues(struct piccolo_Engine* engine, piccolo_Value a, piccolo_Value b) {
+    if(PICCOLO_IS_NUM(a) && PICCOLO_IS_NUM(b))
+        return PICCOLO_NUM_VAL(PICCOLO_AS_NUM(a) + PICCOLO_AS_NUM(b));
+    if(PICCOLO_IS_INT(a) && PICCOLO_IS_INT(b))
+        return PICCOLO_INT_VAL(engine, wrapAdd(PICCOLO_AS_INT(a), PICCOLO_AS_INT(b)));
+    if(PICCOLO_IS_NUMERIC(a) && PICCOLO_IS_NUMERIC(b))
+        return PICCOLO_NUM_VAL(PICCOLO_TO_NUM(a) + PICCOLO_TO_NUM(b));
+    if(PICCOLO_IS_OBJ(a) && PICCOLO_IS_OBJ(b)) {
+        if(PICCOLO_AS_OBJ(a)->type == PICCOLO_OBJ_STRING && PICCOLO_AS_OBJ(b)->type == PICCOLO_OBJ_STRING) {
+            struct piccolo_ObjString* aStr = (struct piccolo_ObjString*) PICCOLO_AS_OBJ(a);
+            struct piccolo_ObjString* bStr = (struct piccolo_ObjString*) PICCOLO_AS_OBJ(b);
+            char *result = PICCOLO_REALLOCATE("string concat", engine, NULL, 0, aStr->len + bStr->len + 1);
+            memcpy(result, aStr->string, aStr->len);
+            memcpy(result + aStr->len, bStr->string, bStr->len);
+            result[aStr->len + bStr->len] = '\0';
+            return PICCOLO_OBJ_VAL(piccolo_takeString(engine, result));
+        }
+        if(PICCOLO_IS_RANGE(a) && (PICCOLO_IS_ARRAY(b) || PICCOLO_IS_RANGE(b)))
+            piccolo_rangeToArray(engine, (struct piccolo_ObjRange*)PICCOLO_AS_OBJ(a));
+        if(PICCOLO_IS_RANGE(b) && PICCOLO_IS_ARRAY(a))
+            piccolo_rangeToArray(engine, (struct piccolo_ObjRange*)PICCOLO_AS_OBJ(b));
+        if(PICCOLO_AS_OBJ(a)->type == PICCOLO_OBJ_ARRAY && PICCOLO_AS_OBJ(b)->type == PICCOLO_OBJ_ARRAY) {
+            struct piccolo_ObjArray* aArr = (struct piccolo_ObjArray*) PICCOLO_AS_OBJ(a);
+            struct piccolo_ObjArray* bArr = (struct piccolo_ObjArray*) PICCOLO_AS_OBJ(b);
+            struct piccolo_ObjArray* resultArr = piccolo_newArray(engine, aArr->array.count + bArr->array.count);
+            for(int i = 0; i < aArr->array.count; i++)
+                resultArr->array.values[i] = aArr->array.values[i];
+            for(int i = 0; i < bArr->array.count; i++)
+                resultArr->array.values[aArr->array.count + i] = bArr->array.values[i];
+            return PICCOLO_OBJ_VAL(resultArr);
+        }
+    }
+    piccolo_runtimeError(engine, "Cannot add %s and %s.", piccolo_getTypeName(a), piccolo_getTypeName(b));
+    return PICCOLO_NIL_VAL();
+}
+
+static piccolo_Value subValues(struct piccolo_Engine* engine, piccolo_Value a, piccolo_Value b) {
+    if(PICCOLO_IS_INT(a) && PICCOLO_IS_INT(b))
+        return PICCOLO_INT_VAL(engine, wrapSub(PICCOLO_AS_INT(a), PICCOLO_AS_INT(b)));
+    if(!PICCOLO_IS_NUMERIC(a) || !PICCOLO_IS_NUMERIC(b)) {
+        piccolo_runtimeError(engine, "Cannot subtract %s from %s.", piccolo_getTypeName(b), piccolo_getTypeName(a));
+        return PICCOLO_NIL_VAL();
+    }
+    return PICCOLO_NUM_VAL(PICCOLO_TO_NUM(a) - PICCOLO_TO_NUM(b));
+}
+
+static piccolo_Value mulValues(struct piccolo_Engine* engine, piccolo_Value a, piccolo_Value b) {
+    if(PICCOLO_IS_NUM(a) && PICCOLO_IS_NUM(b))
+        return PICCOLO_NUM_VAL(PICCOLO_AS_NUM(a) * PICCOLO_AS_NUM(b));
+    if(PICCOLO_IS_INT(a) && PICCOLO_IS_INT(b))
+        return PICCOLO_INT_VAL(engine, wrapMul(PICCOLO_AS_INT(a), PICCOLO_AS_INT(b)));
+    if(PICCOLO_IS_NUMERIC(a) && PICCOLO_IS_NUMERIC(b))
+        return PICCOLO_NUM_VAL(PICCOLO_TO_NUM(a) * PICCOLO_TO_NUM(b));
+    // Repetition counts can be ints too
+    if(PICCOLO_IS_INT(a))
+        a = PICCOLO_NUM_VAL((double)PICCOLO_AS_INT(a));
+    if(PICCOLO_IS_INT(b))
+        b = PICCOLO_NUM_VAL((double)PICCOLO_AS_INT(b));
+    if((PICCOLO_IS_NUM(b) && PICCOLO_IS_OBJ(a) && PICCOLO_AS_OBJ(a)->type == PICCOLO_OBJ_STRING) ||
+       (PICCOLO_IS_NUM(a) && PICCOLO_IS_OBJ(b) && PICCOLO_AS_OBJ(b)->type == PICCOLO_OBJ_STRING)) {
+        int repetitions;
+        struct piccolo_ObjString* string;
+        if(PICCOLO_IS_NUM(b)) {
+            repetitions = PICCOLO_AS_NUM(b);
+            string = (struct piccolo_ObjString*)PICCOLO_AS_OBJ(a);
+        } else {
+            if(PICCOLO_AS_NUM(a) == INFINITY) {
+                piccolo_runtimeError(engine, "Cannot multiply string by INFINITY.");
+                return PICCOLO_NIL_VAL();
+            }
+            repetitions = PICCOLO_AS_NUM(a);
+            string = (struct piccolo_ObjString*)PICCOLO_AS_OBJ(b);
+        }
+        if(repetitions < 0) {
+            piccolo_runtimeError(engine, "Can't multiply string by negative number.");
+            return PICCOLO_NIL_VAL();
+        }
+        char* result = PICCOLO_REALLOCATE("string multiplication", engine, NULL, 0, repetitions * string->len + 1);
+        for(int i = 0; i < repetitions; i++)
+            memcpy(result + i * string->len, string->string, string->len);
+        result[repetitions * string->len] = '\0';
+        return PICCOLO_OBJ_VAL(piccolo_takeString(engine, result));
+    }
+    if(PICCOLO_IS_RANGE(a) && PICCOLO_IS_NUM(b))
+        piccolo_rangeToArray(engine, (struct piccolo_ObjRange*)PICCOLO_AS_OBJ(a));
+    if(PICCOLO_IS_RANGE(b) && PICCOLO_IS_NUM(a))
+        piccolo_rangeToArray(engine, (struct piccolo_ObjRange*)PICCOLO_AS_OBJ(b));
+    if((PICCOLO_IS_NUM(b) && PICCOLO_IS_OBJ(a) && PICCOLO_AS_OBJ(a)->type == PICCOLO_OBJ_ARRAY) ||
+       (PICCOLO_IS_NUM(a) && PICCOLO_IS_OBJ(b) && PICCOLO_AS_OBJ(b)->type == PICCOLO_OBJ_ARRAY)) {
+        piccolo_Value count = PICCOLO_IS_NUM(b) ? b : a;
+        struct piccolo_ObjArray* array = (struct piccolo_ObjArray*)PICCOLO_AS_OBJ(PICCOLO_IS_NUM(b) ? a : b);
+        if(PICCOLO_AS_NUM(count) > INT_MAX || PICCOLO_AS_NUM(count) < INT_MIN) {
+            piccolo_runtimeError(engine, "Array repetition exceeded integer limits.");
+            return PICCOLO_NIL_VAL();
+        }
+        int repetitions = PICCOLO_AS_NUM(count);
+
+        double newCount = (double) array->array.count * (double) repetitions;
+        if(newCount > INT_MAX || newCount < INT_MIN) {
+            piccolo_runtimeError(engine, "Array repetition exceeded integer limits.");
+            return PICCOLO_NIL_VAL();
+        }
+
+        struct piccolo_ObjArray* result = piccolo_newArray(engine, (int) newCount);
+        if(!result->array.values && newCount > 0) {
+            piccolo_runtimeError(engine, "Failed to allocate for new array.");
+            return PICCOLO_NIL_VAL();
+        }
+        for(int i = 0; i < repetitions; i++) {
+            for(int j = 0; j < array->array.count; j++) {
+                result->array.values[i * array->array.count + j] = array->array.values[j];
+            }
+        }
+        return PICCOLO_OBJ_VAL(result);
+    }
+    piccolo_runtimeError(engine, "Cannot multiply %s by %s.", piccolo_getTypeName(a), piccolo_getTypeName(b));
+    return PICCOLO_NIL_VAL();
+}
+
+// Int division truncates towards zero, INT64_MIN / -1 wraps around to INT64_MIN
+static piccolo_Value divValues(struct piccolo_Engine* engine, piccolo_Value a, piccolo_Value b) {
+    if(PICCOLO_IS_INT(a) && PICCOLO_IS_INT(b)) {
+        int64_t aInt = PICCOLO_AS_INT(a);
+        int64_t bInt = PICCOLO_AS_INT(b);
+        if(bInt == 0) {
+            piccolo_runtimeError(engine, "Divide by zero.");
+            return PICCOLO_NIL_VAL();
+        }
+        return PICCOLO_INT_VAL(engine, bInt == -1 ? wrapSub(0, aInt) : aInt / bInt);
+    }
+    if(!PICCOLO_IS_NUMERIC(a) || !PICCOLO_IS_NUMERIC(b)) {
+        piccolo_runtimeError(engine, "Cannot divide %s by %s.", piccolo_getTypeName(a), piccolo_getTypeName(b));
+        return PICCOLO_NIL_VAL();
+    }
+    return PICCOLO_NUM_VAL(PICCOLO_TO_NUM(a) / PICCOLO_TO_NUM(b));
+}
+
+static piccolo_Value modValues(struct piccolo_Engine* engine, piccolo_Value a, piccolo_Value b) {
+    if(PICCOLO_IS_INT(a) && PICCOLO_IS_INT(b)) {
+        int64_t aInt = PICCOLO_AS_INT(a);
+        int64_t bInt = PICCOLO_AS_INT(b);
+        if(bInt == 0) {
+            piccolo_runtimeError(engine, "Divide by zero.");
+            return PICCOLO_NIL_VAL();
+        }
+        return PICCOLO_INT_VAL(engine, bInt == -1 ? 0 : aInt % bInt);
+    }
+    if(!PICCOLO_IS_NUMERIC(a) || !PICCOLO_IS_NUMERIC(b)) {
+        piccolo_runtimeError(engine, "Cannot get remainder of %s divided by %s.", piccolo_getTypeName(a), piccolo_getTypeName(b));
+        return PICCOLO_NIL_VAL();
+    }
+    double aNum = PICCOLO_TO_NUM(a);
+    double bNum = PICCOLO_TO_NUM(b);
+    // TODO: Very jank but will do for now
+    if(aNum < INT_MAX && aNum > INT_MIN && bNum < INT_MAX && bNum > INT_MIN && aNum == (int)aNum && bNum == (int)bNum) {
+        if(bNum == 0) {
+            piccolo_runtimeError(engine, "Divide by zero.");
+            return PICCOLO_NIL_VAL();
+        }
+        return PICCOLO_NUM_VAL((int)aNum % (int)bNum);
+    }
+    return PICCOLO_NUM_VAL(fmod(aNum, bNum));
+}
+
+/*
+    Slow path of the comparisons, for operands that are not both nums. Returns -1, 0 or 1 as a
+    compares to b, or NaN if they are unordered, so the result compares to 0 like a to b.
+ */
+static double compareValues(struct piccolo_Engine* engine, piccolo_Value a, piccolo_Value b) {
+    if(PICCOLO_IS_INT(a) && PICCOLO_IS_INT(b)) {
+        int64_t aInt = PICCOLO_AS_INT(a);
+        int64_t bInt = PICCOLO_AS_INT(b);
+        return aInt < bInt ? -1 : aInt > bInt;
+    }
+    if(!PICCOLO_IS_NUMERIC(a) || !PICCOLO_IS_NUMERIC(b)) {
+        piccolo_runtimeError(engine, "Cannot compare %s and %s.", piccolo_getTypeName(a), piccolo_getTypeName(b));
+        return NAN;
+    }
+    double aNum = PICCOLO_TO_NUM(a);
+    double bNum = PICCOLO_TO_NUM(b);
+    if(aNum < bNum)
+        return -1;
+    if(aNum > bNum)
+        return 1;
+    return aNum == bNum ? 0 : NAN;
+}
+
+// Bitwise operators take ints, and nums that hold a whole number in the range of an int
+static bool bitwiseOperand(piccolo_Value value, int64_t* result) {
+    if(PICCOLO_IS_INT(value)) {
+        *result = PICCOLO_AS_INT(value);
+        return true;
+    }
+    if(!PICCOLO_IS_NUM(value))
+        return false;
+    double num = PICCOLO_AS_NUM(value);
+    if(!(num >= -9223372036854775808.0 && num < 9223372036854775808.0) || num != (double)(int64_t)num)
+        return false;
+    *result = (int64_t)num;
+    return true;
+}
+
+/*
+    Shifting by 64 or more shifts out every bit, right shifts are arithmetic. op is a constant at
+    every call site, so the switch disappears once this is inlined.
+ */
+static inline piccolo_Value bitwiseValues(struct piccolo_Engine* engine, enum piccolo_OpCode op, piccolo_Value a, piccolo_Value b) {
+    int64_t aInt, bInt;
+    if(!bitwiseOperand(a, &aInt) || !bitwiseOperand(b, &bInt)) {
+        piccolo_runtimeError(engine, "Bitwise operands must be integers, got %s and %s.", piccolo_getTypeName(a), piccolo_getTypeName(b));
+        return PICCOLO_NIL_VAL();
+    }
+    switch(op) {
+        case PICCOLO_OP_BIT_AND:
+            return PICCOLO_INT_VAL(engine, aInt & bInt);
+        case PICCOLO_OP_BIT_OR:
+            return PICCOLO_INT_VAL(engine, aInt | bInt);
+        case PICCOLO_OP_BIT_XOR:
+            return PICCOLO_INT_VAL(engine, aInt ^ bInt);
+        case PICCOLO_OP_SHIFT_LEFT:
+        case PICCOLO_OP_SHIFT_RIGHT: {
+            if(bInt < 0) {
+                piccolo_runtimeError(engine, "Cannot shift by a negative amount.");
+                return PICCOLO_NIL_VAL();
+            }
+            if(op == PICCOLO_OP_SHIFT_LEFT)
+                return PICCOLO_INT_VAL(engine, bInt >= 64 ? 0 : (int64_t)((uint64_t)aInt << bInt));
+            if(bInt >= 64)
+                return PICCOLO_INT_VAL(engine, aInt < 0 ? -1 : 0);
+            return PICCOLO_INT_VAL(engine, aInt >> bInt);
+        }
+        default:
+            return PICCOLO_NIL_VAL();
+    }
+}
+
+// GET_MEMBER when its inline cache misses. Fills the cache if the receiver can be cached.
+static piccolo_Value getMember(struct piccolo_Engine* engine, piccolo_Value container, piccolo_Value name, struct piccolo_InlineCache* cache) {
+    if(!PICCOLO_IS_OBJ(container)) {
+        piccolo_runtimeError(engine, "Cannot index %s", piccolo_getTypeName(container));
+        return PICCOLO_NIL_VAL();
+    }
+    struct piccolo_Obj* containerObj = PICCOLO_AS_OBJ(container);
+    struct piccolo_ObjString* nameStr = (struct piccolo_ObjString*)PICCOLO_AS_OBJ(name);
+    if(containerObj->type == PICCOLO_OBJ_PACKAGE) {
+        struct piccolo_Package* package = (struct piccolo_Package*)containerObj;
+        int globalIdx = piccolo_getGlobalTable(engine, &package->globalIdxs, nameStr);
+        int slot = globalIdx & (~PICCOLO_GLOBAL_SLOT_MUTABLE_BIT);
+        if(globalIdx != -1 && slot < package->globals.count) {
+            cache->key = package;
+            cache->slot = slot;
+        }
+    }
+    if(containerObj->type == PICCOLO_OBJ_NATIVE_STRUCT) {
+        struct piccolo_ObjNativeStruct* nativeStruct = (struct piccolo_ObjNativeStruct*)containerObj;
+        const struct piccolo_NativeProperty* property = nativeStruct->properties;
+        while(property != NULL && property->name != NULL) {
+            if(strcmp(property->name, nameStr->string) == 0) {
+                cache->key = nativeStruct->properties;
+                cache->slot = property->offset;
+                return *(piccolo_Value*)(PICCOLO_GET_PAYLOAD(nativeStruct, uint8_t) + property->offset);
+            }
+            property++;
+        }
+    }
+    return indexing(engine, containerObj, name, false, PICCOLO_NIL_VAL());
+}
+
+static struct piccolo_ObjNativeStruct* iterableNativeStruct(piccolo_Value container) {
+    if(!PICCOLO_IS_NATIVE_STRUCT(container))
+        return NULL;
+    struct piccolo_ObjNativeStruct* nativeStruct = (struct piccolo_ObjNativeStruct*)PICCOLO_AS_OBJ(container);
+    return nativeStruct->iterFirst != NULL ? nativeStruct : NULL;
+}
+
+piccolo_Value piccolo_iterFirst(struct piccolo_Engine* engine, piccolo_Value container) {
+    if(PICCOLO_IS_ARRAY(container) || PICCOLO_IS_RANGE(container) || PICCOLO_IS_STRING(container))
+        return PICCOLO_NUM_VAL(0);
+    if(PICCOLO_IS_HASHMAP(container)) {
+        int idx = 0;
+        struct piccolo_ObjHashmap* hashmap = (struct piccolo_ObjHashmap*)PICCOLO_AS_OBJ(container);
+        while(idx < hashmap->hashmap.capacity && !hashmap->hashmap.entries[idx].val.exists)
+            idx++;
+        return PICCOLO_NUM_VAL(idx);
+    }
+    struct piccolo_ObjNativeStruct* nativeStruct = iterableNativeStruct(container);
+    if(nativeStruct != NULL)
+        return nativeStruct->iterFirst(PICCOLO_GET_PAYLOAD(nativeStruct, void), engine);
+    piccolo_runtimeError(engine, "Cannot iterate over %s.", piccolo_getTypeName(container));
+    return PICCOLO_NIL_VAL();
+}
+
+bool piccolo_iterCont(struct piccolo_Engine* engine, piccolo_Value container, piccolo_Value iterator) {
+    struct piccolo_Obj* containerObj = PICCOLO_AS_OBJ(container);
+    int idx = PICCOLO_IS_NUM(iterator) ? PICCOLO_AS_NUM(iterator) : 0;
+    switch(containerObj->type) {
+        case PICCOLO_OBJ_ARRAY:
+            return idx < ((struct piccolo_ObjArray*)containerObj)->array.count;
+        case PICCOLO_OBJ_RANGE:
+            return idx < piccolo_rangeLength((struct piccolo_ObjRange*)containerObj);
+        case PICCOLO_OBJ_STRING:
+            return idx < ((struct piccolo_ObjString*)containerObj)->len;
+        case PICCOLO_OBJ_HASHMAP:
+            return idx < ((struct piccolo_ObjHashmap*)containerObj)->hashmap.capacity;
+        case PICCOLO_OBJ_NATIVE_STRUCT:
+            return !PICCOLO_IS_NIL(iterator);
+        case PICCOLO_OBJ_FUNC:
+        case PICCOLO_OBJ_UPVAL:
+        case PICCOLO_OBJ_CLOSURE:
+        case PICCOLO_OBJ_COROUTINE:
+        case PICCOLO_OBJ_NATIVE_FN:
+        case PICCOLO_OBJ_PACKAGE:
+            break;
+    }
+    piccolo_runtimeError(engine, "Invalid operand to iterator.");
+    return false;
+}
+
+piccolo_Value piccolo_iterNext(struct piccolo_Engine* engine, piccolo_Value container, piccolo_Value iterator) {
+    struct piccolo_Obj* containerObj = PICCOLO_AS_OBJ(container);
+    if(containerObj->type == PICCOLO_OBJ_NATIVE_STRUCT) {
+        struct piccolo_ObjNativeStruct* nativeStruct = (struct piccolo_ObjNativeStruct*)containerObj;
+        return nativeStruct->iterNext(PICCOLO_GET_PAYLOAD(nativeStruct, void), engine, iterator);
+    }
+    int idx = PICCOLO_AS_NUM(iterator);
+    if(containerObj->type == PICCOLO_OBJ_ARRAY || containerObj->type == PICCOLO_OBJ_RANGE)
+        idx++;
+    if(containerObj->type == PICCOLO_OBJ_STRING) {
+        struct piccolo_ObjString* str = (struct piccolo_ObjString*)containerObj;
+        idx += piccolo_strutil_utf8Chars(str->string[idx]);
+    }
+    if(containerObj->type == PICCOLO_OBJ_HASHMAP) {
+        idx++;
+        while(idx < ((struct piccolo_ObjHashmap*)containerObj)->hashmap.capacity && !((struct piccolo_ObjHashmap*)containerObj)->hashmap.entries[idx].val.exists)
+            idx++;
+    }
+    return PICCOLO_NUM_VAL(idx);
+}
+
+piccolo_Value piccolo_iterGet(struct piccolo_Engine* engine, piccolo_Value container, piccolo_Value iterator) {
+    struct piccolo_Obj* containerObj = PICCOLO_AS_OBJ(container);
+    if(containerObj->type == PICCOLO_OBJ_NATIVE_STRUCT) {
+        struct piccolo_ObjNativeStruct* nativeStruct = (struct piccolo_ObjNativeStruct*)containerObj;
+        return nativeStruct->iterGet(PICCOLO_GET_PAYLOAD(nativeStruct, void), engine, iterator);
+    }
+    int idx = PICCOLO_AS_NUM(iterator);
+    if(containerObj->type == PICCOLO_OBJ_ARRAY || containerObj->type == PICCOLO_OBJ_RANGE)
+        return indexing(engine, containerObj, PICCOLO_NUM_VAL(idx), false, PICCOLO_NIL_VAL());
+    if(containerObj->type == PICCOLO_OBJ_STRING) {
+        struct piccolo_ObjString* string = (struct piccolo_ObjString*)containerObj;
+        int charCnt = piccolo_strutil_utf8Chars(string->string[idx]);
+        return PICCOLO_OBJ_VAL(piccolo_copyString(engine, &string->string[idx], charCnt));
+    }
+    if(containerObj->type == PICCOLO_OBJ_HASHMAP)
+        return ((struct piccolo_ObjHashmap*)containerObj)->hashmap.entries[idx].key;
+    return PICCOLO_NIL_VAL();
+}
+
+// Moves the values of all open upvalues at or above the given stack index to the heap
+static void closeUpvals(struct piccolo_Engine* engine, int firstIdx) {
+    struct piccolo_ObjUpval* newOpen = NULL;
+    struct piccolo_ObjUpval* curr = engine->openUpvals;
+    while(curr != NULL) {
+        struct piccolo_ObjUpval* next = curr->next;
+        if(curr->val.idx >= firstIdx) {
+            curr->open = false;
+            piccolo_Value* heapUpval = PICCOLO_REALLOCATE("heap upval", engine, NULL, 0, sizeof(piccolo_Value));
+            *heapUpval = engine->stack[curr->val.idx];
+            curr->val.ptr = heapUpval;
+            piccolo_gcWriteBarrier(engine, &curr->obj, *heapUpval);
+        } else {
+            curr->next = newOpen;
+            newOpen = curr;
+        }
+        curr = next;
+    }
+    engine->openUpvals = newOpen;
 }
 
 static void pushFrame(struct piccolo_Engine* engine) {
@@ -243,696 +721,1468 @@ static struct piccolo_ObjUpval* findUpval(struct piccolo_Engine* engine, int slo
     return piccolo_newUpval(engine, slot);
 }
 
-static bool run(struct piccolo_Engine* engine) {
-#define READ_BYTE() (CURR_FRAME.bytecode->code.values[CURR_FRAME.ip++])
-#define READ_PARAM() ((READ_BYTE() << 8) + READ_BYTE())
+// Open upvals of other coroutines point into stacks that aren't the engine's right now
+static piccolo_Value* openUpvalSlot(struct piccolo_Engine* engine, struct piccolo_ObjUpval* upval) {
+    if(upval->owner == engine->coroutine)
+        return &engine->stack[upval->val.idx];
+    struct piccolo_ExecState* state = upval->owner == NULL ? &engine->mainState : &upval->owner->saved;
+    return &state->stack[upval->val.idx];
+}
+
+/*
+    The interpreter loop keeps the hot parts of the current frame in locals: the instruction
+    pointer, the code and constant arrays, the frame's locals and the top of the value stack.
+    They are only written back to the engine (STORE_FRAME) when something outside of run() needs
+    to see them, which is when calling into natives or other frames, when returning, when
+    collecting garbage and when raising a runtime error. LOAD_FRAME does the opposite after the
+    frame or the stack may have changed.
+
+    When the compiler supports it, opcodes are dispatched with computed gotos, so every handler
+    ends with its own indirect jump instead of going back through a single switch.
+ */
+#if !defined(PICCOLO_DISABLE_COMPUTED_GOTO) && (defined(__GNUC__) || defined(__clang__))
+#define PICCOLO_COMPUTED_GOTO
+#endif
+
+// Safepoints between two looks at the clock when there is a time limit
+#define PICCOLO_BUDGET_CLOCK_INTERVAL 1024
+
+static void nextBudgetSlice(struct piccolo_Engine* engine) {
+    int64_t slice = INT64_MAX;
+    if(engine->budgetDeadline != -1)
+        slice = PICCOLO_BUDGET_CLOCK_INTERVAL;
+    if(engine->budgetSteps != -1 && engine->budgetSteps < slice)
+        slice = engine->budgetSteps;
+    engine->budget = engine->budgetSlice = slice;
+}
+
+static void setBudget(struct piccolo_Engine* engine, int64_t steps, int64_t usecs) {
+    engine->budgetSteps = steps > 0 ? steps : -1;
+    engine->budgetDeadline = -1;
+    if(usecs > 0)
+        engine->budgetDeadline = piccolo_monotonicUsecs() + usecs;
+    nextBudgetSlice(engine);
+}
+
+// Called once budget has run out, checks the actual limits and starts the next slice
+static bool budgetUsedUp(struct piccolo_Engine* engine) {
+    bool usedUp = false;
+    if(engine->budgetSteps != -1) {
+        engine->budgetSteps -= engine->budgetSlice - engine->budget;
+        usedUp = engine->budgetSteps <= 0;
+    }
+    if(engine->budgetDeadline != -1 && piccolo_monotonicUsecs() >= engine->budgetDeadline)
+        usedUp = true;
+    if(usedUp) {
+        // Check again at the next safepoint, in case this one can't suspend
+        engine->budget = engine->budgetSlice = 1;
+        return true;
+    }
+    nextBudgetSlice(engine);
+    return false;
+}
+
+static bool run(struct piccolo_Engine* engine, int baseFrameCount) {
+#define READ_BYTE() (*ip++)
+#define READ_PARAM() (ip += 2, (uint16_t)((ip[-2] << 8) | ip[-1]))
+#define PARAM_AT(offset) ((uint16_t)((opStart[offset] << 8) | opStart[(offset) + 1]))
+#define PUSH(value) (*stackTop++ = (value))
+#define POP() (*--stackTop)
+#define PEEK(dist) (stackTop[-(dist)])
+
+#define STORE_FRAME()                                  \
+    do {                                               \
+        frame->ip = (int)(ip - code);                  \
+        frame->prevIp = (int)(opStart - code);         \
+        engine->stackTop = stackTop;                   \
+    } while(false)
+
+#define LOAD_FRAME()                                   \
+    do {                                               \
+        frame = &CURR_FRAME;                           \
+        code = frame->bytecode->code.values;           \
+        constants = frame->bytecode->constants.values; \
+        ip = code + frame->ip;                         \
+        opStart = ip;                                  \
+        stackTop = engine->stackTop;                   \
+        locals = engine->stack + frame->localStart;    \
+    } while(false)
+
+/*
+    Errors leave run() right away. RUNTIME_ERROR is for errors raised by a handler itself, and
+    CHECK_ERROR follows calls into code that may have raised one, like natives and slow paths.
+ */
+#define RUNTIME_ERROR(...)                             \
+    do {                                               \
+        STORE_FRAME();                                 \
+        piccolo_runtimeError(engine, __VA_ARGS__);     \
+        return false;                                  \
+    } while(false)
+
+#define CHECK_ERROR()                                  \
+    do {                                               \
+        if(engine->hadError)                           \
+            return false;                              \
+    } while(false)
+
+// Replaces the called value and its arguments with the result of a native, the frame must have been stored before the call
+#define FINISH_NATIVE_CALL(result, argCount)                                                \
+    do {                                                                                    \
+        CHECK_ERROR();                                                                      \
+        LOAD_FRAME();                                                                       \
+        stackTop -= (argCount) + 1;                                                         \
+        PUSH(result);                                                                       \
+        if(engine->yielding) {                                                              \
+            /* The result is handed to piccolo_resumeCoroutine, which is below this run() */\
+            /* only if this run() is the coroutine's own */                                 \
+            if(baseFrameCount != 0) {                                                       \
+                engine->yielding = false;                                                   \
+                RUNTIME_ERROR("Cannot yield across a native call.");                        \
+            }                                                                               \
+            STORE_FRAME();                                                                  \
+            return true;                                                                    \
+        }                                                                                   \
+        SAFEPOINT();                                                                        \
+    } while(false)
+
+// The iteration hooks of native structs may call back into the engine, which can move the stack
+#define RELOAD_AFTER_ITER_HOOK(container)              \
+    do {                                               \
+        if(PICCOLO_IS_NATIVE_STRUCT(container))        \
+            LOAD_FRAME();                              \
+    } while(false)
+
+/*
+    Allocations only ask for a collection, it happens at the next safepoint: a backward jump or a
+    call. Every value that is in use is on the stack there, and every loop passes one. Safepoints
+    are also where a limited execution is suspended, it resumes right after the safepoint.
+ */
+#define SAFEPOINT()                                            \
+    do {                                                       \
+        if(engine->gcPending) {                                \
+            STORE_FRAME();                                     \
+            piccolo_collectGarbage(engine);                    \
+        }                                                      \
+        if(--engine->budget <= 0 && budgetUsedUp(engine) &&    \
+           baseFrameCount == engine->budgetBase &&             \
+           engine->coroutine == NULL) {                        \
+            STORE_FRAME();                                     \
+            engine->suspended = true;                          \
+            return true;                                       \
+        }                                                      \
+    } while(false)
+
+/*
+    Superinstructions cover several instructions but only replace the first one's opcode, see
+    piccolo_fuseInstructions. When its fast path doesn't apply, a superinstruction does what the
+    replaced instruction would have done and execution continues with the original bytes.
+ */
+#define COMPARE_JUMP_FALSE_OP(op, operator)                                        \
+    OPCODE(op): {                                                                  \
+        piccolo_Value a = POP();                                                   \
+        piccolo_Value b = POP();                                                   \
+        bool result;                                                               \
+        if(PICCOLO_IS_NUM(a) && PICCOLO_IS_NUM(b)) {                               \
+            result = PICCOLO_AS_NUM(b) operator PICCOLO_AS_NUM(a);                 \
+        } else {                                                                   \
+            STORE_FRAME();                                                         \
+            result = 0 operator compareValues(engine, a, b);                       \
+            CHECK_ERROR();                                                         \
+        }                                                                          \
+        if(result)                                                                 \
+            ip = opStart + 4;                                                      \
+        else                                                                       \
+            ip = opStart + 1 + PARAM_AT(2);                                        \
+        DISPATCH();                                                                \
+    }
+
+#define REG(operand) ((operand) & PICCOLO_REG_CONST_BIT ? constants[(operand) & ~PICCOLO_REG_CONST_BIT] : locals[operand])
+
+#define REG_ARITH_OP(op, operator, slowPath)                                       \
+    OPCODE(op): {                                                                  \
+        int dst = READ_PARAM();                                                    \
+        uint16_t aReg = READ_PARAM();                                              \
+        uint16_t bReg = READ_PARAM();                                              \
+        piccolo_Value a = REG(aReg);                                               \
+        piccolo_Value b = REG(bReg);                                               \
+        piccolo_Value result;                                                      \
+        if(PICCOLO_IS_NUM(a) && PICCOLO_IS_NUM(b)) {                               \
+            result = PICCOLO_NUM_VAL(PICCOLO_AS_NUM(a) operator PICCOLO_AS_NUM(b));\
+        } else {                                                                   \
+            STORE_FRAME();                                                         \
+            result = slowPath(engine, a, b);                                       \
+            CHECK_ERROR();                                                         \
+        }                                                                          \
+        locals[dst] = result;                                                      \
+        DISPATCH();                                                                \
+    }
+
+#define REG_COMPARE_JUMP_FALSE_OP(op, test)                                        \
+    OPCODE(op): {                                                                  \
+        uint16_t aReg = READ_PARAM();                                              \
+        uint16_t bReg = READ_PARAM();                                              \
+        piccolo_Value a = REG(aReg);                                               \
+        piccolo_Value b = REG(bReg);                                               \
+        int jumpDist = READ_PARAM();                                               \
+        double x, y;                                                               \
+        if(PICCOLO_IS_NUM(a) && PICCOLO_IS_NUM(b)) {                               \
+            x = PICCOLO_AS_NUM(a);                                                 \
+            y = PICCOLO_AS_NUM(b);                                                 \
+        } else {                                                                   \
+            STORE_FRAME();                                                         \
+            x = -compareValues(engine, b, a);                                      \
+            y = 0;                                                                 \
+            CHECK_ERROR();                                                         \
+        }                                                                          \
+        if(!(test))                                                                \
+            ip = opStart + jumpDist;                                               \
+        DISPATCH();                                                                \
+    }
+
+#define QUICKEN(op) (*opStart = PICCOLO_OP_ ## op)
+
+/*
+    A quickened instruction only handles two numbers. Any other operands turn it back into the
+    generic instruction, which is then executed from the start.
+ */
+#define NUM_NUM_OP(op, generic, valueType, operator)                               \
+    OPCODE(op): {                                                                  \
+        piccolo_Value a = PEEK(1);                                                 \
+        piccolo_Value b = PEEK(2);                                                 \
+        if(!PICCOLO_IS_NUM(a) || !PICCOLO_IS_NUM(b)) {                             \
+            QUICKEN(generic);                                                      \
+            ip = opStart;                                                          \
+            DISPATCH();                                                            \
+        }                                                                          \
+        stackTop--;                                                                \
+        PEEK(1) = PICCOLO_ ## valueType ## _VAL(PICCOLO_AS_NUM(b) operator PICCOLO_AS_NUM(a)); \
+        DISPATCH();                                                                \
+    }
+
+#define BITWISE_OP(op)                                                             \
+    OPCODE(op): {                                                                  \
+        piccolo_Value a = POP();                                                   \
+        piccolo_Value b = POP();                                                   \
+        STORE_FRAME();                                                             \
+        PUSH(bitwiseValues(engine, PICCOLO_OP_ ## op, b, a));                      \
+        CHECK_ERROR();                                                             \
+        DISPATCH();                                                                \
+    }
+
+#ifdef PICCOLO_JIT
+/*
+    Functions are compiled once they have been called or looped in often enough. Whenever the
+    interpreter enters a compiled function, returns to it or jumps backwards in it, the machine
+    code takes over until it hits an instruction it leaves to the interpreter.
+ */
+#define COUNT_HOTNESS(function)                                                    \
+    do {                                                                           \
+        if(++(function)->hotness == PICCOLO_JIT_THRESHOLD)                         \
+            piccolo_compileJit(engine, function);                                  \
+    } while(false)
+
+#define ENTER_JIT()                                                                \
+    do {                                                                           \
+        if(frame->closure != NULL && frame->closure->prototype->jit != NULL) {     \
+            engine->stackTop = stackTop;                                           \
+            ip = code + piccolo_runJit(frame->closure->prototype, (int)(ip - code), locals, &engine->stackTop, constants, frame->package); \
+            stackTop = engine->stackTop;                                           \
+        }                                                                          \
+    } while(false)
+#else
+#define COUNT_HOTNESS(function) do {} while(false)
+#define ENTER_JIT() do {} while(false)
+#endif
+
+#ifdef PICCOLO_ENABLE_ENGINE_DEBUG
+#define TRACE_INSTRUCTION() \
+    do {                                                                                   \
+        STORE_FRAME();                                                                     \
+        piccolo_disassembleInstruction(frame->bytecode, (int)(ip - code));                 \
+        printf("DATA STACK:\n");                                                           \
+        for(piccolo_Value* stackPtr = engine->stack; stackPtr != stackTop; stackPtr++) {   \
+            printf("[");                                                                   \
+            piccolo_printValue(*stackPtr);                                                 \
+            printf("] ");                                                                  \
+        }                                                                                  \
+        printf("\n");                                                                      \
+    } while(false)
+#else
+#define TRACE_INSTRUCTION() do {} while(false)
+#endif
+
+#ifdef PICCOLO_COMPUTED_GOTO
+    // The opcodes override the default entry on purpose
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Winitializer-overrides"
+#else
+#pragma GCC diagnostic ignored "-Woverride-init"
+#endif
+    static void* dispatchTable[256] = {
+        [0 ... 255] = &&op_UNKNOWN,
+        [PICCOLO_OP_RETURN] = &&op_RETURN,
+        [PICCOLO_OP_CONST] = &&op_CONST,
+        [PICCOLO_OP_ADD] = &&op_ADD,
+        [PICCOLO_OP_SUB] = &&op_SUB,
+        [PICCOLO_OP_MUL] = &&op_MUL,
+        [PICCOLO_OP_DIV] = &&op_DIV,
+        [PICCOLO_OP_MOD] = &&op_MOD,
+        [PICCOLO_OP_EQUAL] = &&op_EQUAL,
+        [PICCOLO_OP_GREATER] = &&op_GREATER,
+        [PICCOLO_OP_LESS] = &&op_LESS,
+        [PICCOLO_OP_NEGATE] = &&op_NEGATE,
+        [PICCOLO_OP_NOT] = &&op_NOT,
+        [PICCOLO_OP_BIT_AND] = &&op_BIT_AND,
+        [PICCOLO_OP_BIT_OR] = &&op_BIT_OR,
+        [PICCOLO_OP_BIT_XOR] = &&op_BIT_XOR,
+        [PICCOLO_OP_SHIFT_LEFT] = &&op_SHIFT_LEFT,
+        [PICCOLO_OP_SHIFT_RIGHT] = &&op_SHIFT_RIGHT,
+        [PICCOLO_OP_BIT_NOT] = &&op_BIT_NOT,
+        [PICCOLO_OP_POP_STACK] = &&op_POP_STACK,
+        [PICCOLO_OP_PEEK_STACK] = &&op_PEEK_STACK,
+        [PICCOLO_OP_SWAP_STACK] = &&op_SWAP_STACK,
+        [PICCOLO_OP_CREATE_ARRAY] = &&op_CREATE_ARRAY,
+        [PICCOLO_OP_UNPACK] = &&op_UNPACK,
+        [PICCOLO_OP_CREATE_RANGE] = &&op_CREATE_RANGE,
+        [PICCOLO_OP_RANGE_FIRST] = &&op_RANGE_FIRST,
+        [PICCOLO_OP_GET_IDX] = &&op_GET_IDX,
+        [PICCOLO_OP_SET_IDX] = &&op_SET_IDX,
+        [PICCOLO_OP_GET_MEMBER] = &&op_GET_MEMBER,
+        [PICCOLO_OP_HASHMAP] = &&op_HASHMAP,
+        [PICCOLO_OP_GET_GLOBAL] = &&op_GET_GLOBAL,
+        [PICCOLO_OP_SET_GLOBAL] = &&op_SET_GLOBAL,
+        [PICCOLO_OP_GET_LOCAL] = &&op_GET_LOCAL,
+        [PICCOLO_OP_SET_LOCAL] = &&op_SET_LOCAL,
+        [PICCOLO_OP_POP_LOCALS] = &&op_POP_LOCALS,
+        [PICCOLO_OP_JUMP] = &&op_JUMP,
+        [PICCOLO_OP_JUMP_FALSE] = &&op_JUMP_FALSE,
+        [PICCOLO_OP_REV_JUMP] = &&op_REV_JUMP,
+        [PICCOLO_OP_REV_JUMP_FALSE] = &&op_REV_JUMP_FALSE,
+        [PICCOLO_OP_CALL] = &&op_CALL,
+        [PICCOLO_OP_INVOKE] = &&op_INVOKE,
+        [PICCOLO_OP_RETURN_VALUES] = &&op_RETURN_VALUES,
+        [PICCOLO_OP_TAIL_CALL] = &&op_TAIL_CALL,
+        [PICCOLO_OP_CLOSURE] = &&op_CLOSURE,
+        [PICCOLO_OP_GET_UPVAL] = &&op_GET_UPVAL,
+        [PICCOLO_OP_SET_UPVAL] = &&op_SET_UPVAL,
+        [PICCOLO_OP_CLOSE_UPVALS] = &&op_CLOSE_UPVALS,
+        [PICCOLO_OP_GET_LEN] = &&op_GET_LEN,
+        [PICCOLO_OP_APPEND] = &&op_APPEND,
+        [PICCOLO_OP_ACC_CREATE] = &&op_ACC_CREATE,
+        [PICCOLO_OP_ACC_APPEND] = &&op_ACC_APPEND,
+        [PICCOLO_OP_IN] = &&op_IN,
+        [PICCOLO_OP_ITER_FIRST] = &&op_ITER_FIRST,
+        [PICCOLO_OP_ITER_CONT] = &&op_ITER_CONT,
+        [PICCOLO_OP_ITER_NEXT] = &&op_ITER_NEXT,
+        [PICCOLO_OP_ITER_GET] = &&op_ITER_GET,
+        [PICCOLO_OP_EXECUTE_PACKAGE] = &&op_EXECUTE_PACKAGE,
+        [PICCOLO_OP_ADD_NUM_NUM] = &&op_ADD_NUM_NUM,
+        [PICCOLO_OP_SUB_NUM_NUM] = &&op_SUB_NUM_NUM,
+        [PICCOLO_OP_MUL_NUM_NUM] = &&op_MUL_NUM_NUM,
+        [PICCOLO_OP_DIV_NUM_NUM] = &&op_DIV_NUM_NUM,
+        [PICCOLO_OP_GREATER_NUM_NUM] = &&op_GREATER_NUM_NUM,
+        [PICCOLO_OP_LESS_NUM_NUM] = &&op_LESS_NUM_NUM,
+        [PICCOLO_OP_ADD_CONST_LOCAL] = &&op_ADD_CONST_LOCAL,
+        [PICCOLO_OP_ADD_CONST_GLOBAL] = &&op_ADD_CONST_GLOBAL,
+        [PICCOLO_OP_LESS_JUMP_FALSE] = &&op_LESS_JUMP_FALSE,
+        [PICCOLO_OP_GREATER_JUMP_FALSE] = &&op_GREATER_JUMP_FALSE,
+        [PICCOLO_OP_NOT_EQUAL] = &&op_NOT_EQUAL,
+        [PICCOLO_OP_ITER_LOOP] = &&op_ITER_LOOP,
+        [PICCOLO_OP_REG_MOVE] = &&op_REG_MOVE,
+        [PICCOLO_OP_REG_ADD] = &&op_REG_ADD,
+        [PICCOLO_OP_REG_SUB] = &&op_REG_SUB,
+        [PICCOLO_OP_REG_MUL] = &&op_REG_MUL,
+        [PICCOLO_OP_REG_DIV] = &&op_REG_DIV,
+        [PICCOLO_OP_REG_MOD] = &&op_REG_MOD,
+        [PICCOLO_OP_REG_LESS_JUMP_FALSE] = &&op_REG_LESS_JUMP_FALSE,
+        [PICCOLO_OP_REG_LESS_EQ_JUMP_FALSE] = &&op_REG_LESS_EQ_JUMP_FALSE,
+        [PICCOLO_OP_REG_GREATER_JUMP_FALSE] = &&op_REG_GREATER_JUMP_FALSE,
+        [PICCOLO_OP_REG_GREATER_EQ_JUMP_FALSE] = &&op_REG_GREATER_EQ_JUMP_FALSE,
+        [PICCOLO_OP_REG_EQUAL_JUMP_FALSE] = &&op_REG_EQUAL_JUMP_FALSE,
+        [PICCOLO_OP_REG_NOT_EQUAL_JUMP_FALSE] = &&op_REG_NOT_EQUAL_JUMP_FALSE,
+    };
+#pragma GCC diagnostic pop
+
+#define INTERPRET_LOOP DISPATCH();
+#define OPCODE(name) op_ ## name
+#define DISPATCH()                              \
+    do {                                        \
+        TRACE_INSTRUCTION();                    \
+        opStart = ip;                           \
+        goto *dispatchTable[READ_BYTE()];       \
+    } while(false)
+#else
+#define INTERPRET_LOOP      \
+    loop:                   \
+        TRACE_INSTRUCTION();\
+        opStart = ip;       \
+        switch(READ_BYTE())
+#define OPCODE(name) case PICCOLO_OP_ ## name
+#define DISPATCH() goto loop
+#endif
+
+    if(engine->callFrames.count == 0 || !engine->callFrames.values) {
+        // TODO: Nir output when encountering invalid call frame state
+        piccolo_enginePrintError(engine, "Invalid callframe state encountered.\n");
+        return false;
+    }
+
     engine->hadError = false;
-    while(true) {
-        if(engine->callFrames.capacity >= PICCOLO_MAX_FRAMES) {
-            // TODO: Nir output when encountering invalid call frame state
-            piccolo_enginePrintError(engine, "Call frame depth exceeded limit (%i).\n", PICCOLO_MAX_FRAMES);
-            break;
-        }
-        if(!engine->callFrames.values) {
-            piccolo_enginePrintError(engine, "Invalid callframe state encountered.\n");
-            break;
-        }
-        CURR_FRAME.prevIp = CURR_FRAME.ip;
-        enum piccolo_OpCode opcode = READ_BYTE();
-        switch(opcode) {
-            case PICCOLO_OP_RETURN:
-                popFrame(engine);
-                if(engine->callFrames.count == 0)
-                    return true;
-                CURR_FRAME.prevIp = CURR_FRAME.ip;
-                break;
-            case PICCOLO_OP_CONST: {
-                piccolo_enginePushStack(engine, CURR_FRAME.bytecode->constants.values[READ_PARAM()]);
-                break;
-            }
-            case PICCOLO_OP_ADD: {
-                piccolo_Value a = piccolo_enginePopStack(engine);
-                piccolo_Value b = piccolo_enginePopStack(engine);
-                if(PICCOLO_IS_NUM(a) && PICCOLO_IS_NUM(b)) {
-                    piccolo_enginePushStack(engine, PICCOLO_NUM_VAL(PICCOLO_AS_NUM(b) + PICCOLO_AS_NUM(a)));
-                    break;
-                }
-                if(PICCOLO_IS_OBJ(a) && PICCOLO_IS_OBJ(b)) {
-                    if(PICCOLO_AS_OBJ(a)->type == PICCOLO_OBJ_STRING && PICCOLO_AS_OBJ(b)->type == PICCOLO_OBJ_STRING) {
-                        struct piccolo_ObjString* bStr = (struct piccolo_ObjString*) PICCOLO_AS_OBJ(a);
-                        struct piccolo_ObjString* aStr = (struct piccolo_ObjString*) PICCOLO_AS_OBJ(b);
-                        char *result = PICCOLO_REALLOCATE("string concat", engine, NULL, 0, aStr->len + bStr->len + 1);
-                        memcpy(result, aStr->string, aStr->len);
-                        memcpy(result + aStr->len, bStr->string, bStr->len);
-                        result[aStr->len + bStr->len] = '\0';
-                        struct piccolo_ObjString* resultStr = piccolo_takeString(engine, result);
-                        piccolo_enginePushStack(engine, PICCOLO_OBJ_VAL(resultStr));
-                        break;
-                    }
-                    if(PICCOLO_AS_OBJ(a)->type == PICCOLO_OBJ_ARRAY && PICCOLO_AS_OBJ(b)->type == PICCOLO_OBJ_ARRAY) {
-                        struct piccolo_ObjArray* bArr = (struct piccolo_ObjArray*) PICCOLO_AS_OBJ(a);
-                        struct piccolo_ObjArray* aArr = (struct piccolo_ObjArray*) PICCOLO_AS_OBJ(b);
-                        struct piccolo_ObjArray* resultArr = piccolo_newArray(engine, aArr->array.count + bArr->array.count);
-                        for(int i = 0; i < aArr->array.count; i++)
-                            resultArr->array.values[i] = aArr->array.values[i];
-                        for(int i = 0; i < bArr->array.count; i++)
-                            resultArr->array.values[aArr->array.count + i] = bArr->array.values[i];
-                        piccolo_enginePushStack(engine, PICCOLO_OBJ_VAL(resultArr));
-                        break;
-                    }
-                }
-                piccolo_runtimeError(engine, "Cannot add %s and %s.", piccolo_getTypeName(b), piccolo_getTypeName(a));
-                break;
-            }
-            case PICCOLO_OP_SUB: {
-                piccolo_Value a = piccolo_enginePopStack(engine);
-                piccolo_Value b = piccolo_enginePopStack(engine);
-                if(!PICCOLO_IS_NUM(a) || !PICCOLO_IS_NUM(b)) {
-                    piccolo_runtimeError(engine, "Cannot subtract %s from %s.", piccolo_getTypeName(a), piccolo_getTypeName(b));
-                    break;
-                }
-                piccolo_enginePushStack(engine, PICCOLO_NUM_VAL(PICCOLO_AS_NUM(b) - PICCOLO_AS_NUM(a)));
-                break;
-            }
-            case PICCOLO_OP_MUL: {
-                piccolo_Value a = piccolo_enginePopStack(engine);
-                piccolo_Value b = piccolo_enginePopStack(engine);
-                if(PICCOLO_IS_NUM(a) && PICCOLO_IS_NUM(b)) {
-                    piccolo_enginePushStack(engine, PICCOLO_NUM_VAL(PICCOLO_AS_NUM(b) * PICCOLO_AS_NUM(a)));
-                    break;
-                }
-                if((PICCOLO_IS_NUM(a) && PICCOLO_IS_OBJ(b) && PICCOLO_AS_OBJ(b)->type == PICCOLO_OBJ_STRING) ||
-                   (PICCOLO_IS_NUM(b) && PICCOLO_IS_OBJ(a) && PICCOLO_AS_OBJ(a)->type == PICCOLO_OBJ_STRING)) {
-                    int repetitions;
-                    struct piccolo_ObjString* string;
-                    if(PICCOLO_IS_NUM(a)) {
-                        repetitions = PICCOLO_AS_NUM(a);
-                        string = (struct piccolo_ObjString*)PICCOLO_AS_OBJ(b);
-                    } else {
-                        if(PICCOLO_AS_NUM(b) == INFINITY) {
-                            piccolo_runtimeError(engine, "Cannot multiply string by INFINITY.");
-                            break;
-                        }
-                        repetitions = PICCOLO_AS_NUM(b);
-                        string = (struct piccolo_ObjString*)PICCOLO_AS_OBJ(a);
-                    }
-                    if(repetitions < 0) {
-                        piccolo_runtimeError(engine, "Can't multiply string by negative number.");
-                        break;
-                    }
-                    char* result = PICCOLO_REALLOCATE("string multiplication", engine, NULL, 0, repetitions * string->len + 1);
-                    for(int i = 0; i < repetitions; i++)
-                        memcpy(result + i * string->len, string->string, string->len);
-                    result[repetitions * string->len] = '\0';
-                    struct piccolo_ObjString* resultStr = piccolo_takeString(engine, result);
-                    piccolo_enginePushStack(engine, PICCOLO_OBJ_VAL(resultStr));
-                    break;
-                    
-                }
-                if((PICCOLO_IS_NUM(a) && PICCOLO_IS_OBJ(b) && PICCOLO_AS_OBJ(b)->type == PICCOLO_OBJ_ARRAY) ||
-                   (PICCOLO_IS_NUM(b) && PICCOLO_IS_OBJ(a) && PICCOLO_AS_OBJ(a)->type == PICCOLO_OBJ_ARRAY)) {
-                    int repetitions;
-                    struct piccolo_ObjArray* array;
-                    if(PICCOLO_IS_NUM(a)) {
-                        if(PICCOLO_AS_NUM(a) > INT_MAX || PICCOLO_AS_NUM(a) < INT_MIN) {
-                            piccolo_runtimeError(engine, "Array repetition exceeded integer limits.");
-                            break;
-                        }
-                        repetitions = PICCOLO_AS_NUM(a);
-                        array = (struct piccolo_ObjArray*)PICCOLO_AS_OBJ(b);
-                    } else {
-                        if(PICCOLO_AS_NUM(b) > INT_MAX || PICCOLO_AS_NUM(b) < INT_MIN) {
-                            piccolo_runtimeError(engine, "Array repetition exceeded integer limits.");
-                            break;
-                        }
-                        repetitions = PICCOLO_AS_NUM(b);
-                        array = (struct piccolo_ObjArray*)PICCOLO_AS_OBJ(a);
-                    }
 
-                    double newCount = (double) array->array.count * (double) repetitions;
-                    if(newCount > INT_MAX || newCount < INT_MIN) {
-                        piccolo_runtimeError(engine, "Array repetition exceeded integer limits.");
-                        break;
-                    }
+    struct piccolo_CallFrame* frame;
+    uint8_t* code;
+    uint8_t* ip;
+    uint8_t* opStart;
+    piccolo_Value* constants;
+    piccolo_Value* locals;
+    piccolo_Value* stackTop;
+    LOAD_FRAME();
 
-                    struct piccolo_ObjArray* result = piccolo_newArray(engine, (int) newCount);
-                    if(!result->array.values && newCount > 0) {
-                        piccolo_runtimeError(engine, "Failed to allocate for new array.");
-                        break;
-                    }
-                    for(int i = 0; i < repetitions; i++) {
-                        for(int j = 0; j < array->array.count; j++) {
-                            result->array.values[i * array->array.count + j] = array->array.values[j];
-                        }
-                    }
-                    piccolo_enginePushStack(engine, PICCOLO_OBJ_VAL(result));
-                    break;
-                }
-                piccolo_runtimeError(engine, "Cannot multiply %s by %s.", piccolo_getTypeName(b), piccolo_getTypeName(a));
-                break;
+    INTERPRET_LOOP
+    {
+        OPCODE(RETURN): {
+            if(frame->closure != NULL) {
+                // The result replaces the called closure below the arguments
+                piccolo_Value result = PEEK(1);
+                if(engine->openUpvals != NULL)
+                    closeUpvals(engine, frame->localStart);
+                stackTop = locals - 1;
+                PUSH(result);
             }
-            case PICCOLO_OP_DIV: {
-                piccolo_Value a = piccolo_enginePopStack(engine);
-                piccolo_Value b = piccolo_enginePopStack(engine);
-                if(!PICCOLO_IS_NUM(a) || !PICCOLO_IS_NUM(b)) {
-                    piccolo_runtimeError(engine, "Cannot divide %s by %s.", piccolo_getTypeName(b), piccolo_getTypeName(a));
-                    break;
+            engine->stackTop = stackTop;
+            popFrame(engine);
+            if(engine->callFrames.count == baseFrameCount)
+                return true;
+            LOAD_FRAME();
+            ENTER_JIT();
+            DISPATCH();
+        }
+        OPCODE(RETURN_VALUES): {
+            /*
+                Always followed by RETURN. When the caller destructures the result right away with
+                the same number of variables, the values are moved to where the called closure was
+                and its UNPACK is skipped. Otherwise they are returned as an array.
+             */
+            int count = READ_PARAM();
+            if(frame->closure != NULL && engine->callFrames.count - 1 > baseFrameCount) {
+                struct piccolo_CallFrame* caller = &engine->callFrames.values[engine->callFrames.count - 2];
+                uint8_t* callerIp = caller->bytecode->code.values + caller->ip;
+                if(callerIp[0] == PICCOLO_OP_UNPACK && ((callerIp[1] << 8) | callerIp[2]) == count) {
+                    if(engine->openUpvals != NULL)
+                        closeUpvals(engine, frame->localStart);
+                    memmove(locals - 1, stackTop - count, count * sizeof(piccolo_Value));
+                    engine->stackTop = locals - 1 + count;
+                    caller->ip += 3;
+                    popFrame(engine);
+                    LOAD_FRAME();
+                    ENTER_JIT();
+                    DISPATCH();
                 }
-                piccolo_enginePushStack(engine, PICCOLO_NUM_VAL(PICCOLO_AS_NUM(b) / PICCOLO_AS_NUM(a)));
-                break;
             }
-            case PICCOLO_OP_MOD: {
-                piccolo_Value a = piccolo_enginePopStack(engine);
-                piccolo_Value b = piccolo_enginePopStack(engine);
-                if(!PICCOLO_IS_NUM(a) || !PICCOLO_IS_NUM(b)) {
-                    piccolo_runtimeError(engine, "Cannot get remainder of %s divided by %s.", piccolo_getTypeName(b), piccolo_getTypeName(a));
-                    break;
-                }
-                double aNum = PICCOLO_AS_NUM(a);
-                double bNum = PICCOLO_AS_NUM(b);
-                // TODO: Very jank but will do for now
-                if(aNum < INT_MAX && aNum > INT_MIN && bNum < INT_MAX && bNum > INT_MIN && aNum == (int)aNum && bNum == (int)bNum) {
-                    if(aNum == 0) {
-                        piccolo_runtimeError(engine, "Divide by zero.");
-                        break;
-                    }
-                    piccolo_enginePushStack(engine, PICCOLO_NUM_VAL((int)bNum % (int)aNum));
-                    break;
-                }
-                piccolo_enginePushStack(engine, PICCOLO_NUM_VAL(fmod(bNum, aNum)));
-                break;
+            STORE_FRAME();
+            struct piccolo_ObjArray* array = piccolo_newArray(engine, count);
+            for(int i = count - 1; i >= 0; i--)
+                array->array.values[i] = POP();
+            PUSH(PICCOLO_OBJ_VAL(array));
+            DISPATCH();
+        }
+        OPCODE(CONST): {
+            PUSH(constants[READ_PARAM()]);
+            DISPATCH();
+        }
+        OPCODE(ADD): {
+            piccolo_Value a = POP();
+            piccolo_Value b = POP();
+            if(PICCOLO_IS_NUM(a) && PICCOLO_IS_NUM(b)) {
+                QUICKEN(ADD_NUM_NUM);
+                PUSH(PICCOLO_NUM_VAL(PICCOLO_AS_NUM(b) + PICCOLO_AS_NUM(a)));
+                DISPATCH();
             }
-            case PICCOLO_OP_EQUAL: {
-                piccolo_Value a = piccolo_enginePopStack(engine);
-                piccolo_Value b = piccolo_enginePopStack(engine);
-                piccolo_enginePushStack(engine, PICCOLO_BOOL_VAL(piccolo_valuesEqual(a, b)));
-                break;
+            if(PICCOLO_IS_INT(a) && PICCOLO_IS_INT(b)) {
+                PUSH(PICCOLO_INT_VAL(engine, wrapAdd(PICCOLO_AS_INT(b), PICCOLO_AS_INT(a))));
+                DISPATCH();
             }
-            case PICCOLO_OP_GREATER: {
-                piccolo_Value a = piccolo_enginePopStack(engine);
-                piccolo_Value b = piccolo_enginePopStack(engine);
-                if(!PICCOLO_IS_NUM(a) || !PICCOLO_IS_NUM(b)) {
-                    piccolo_runtimeError(engine, "Cannot compare %s and %s.", piccolo_getTypeName(a), piccolo_getTypeName(b));
-                    break;
-                }
-                piccolo_enginePushStack(engine, PICCOLO_BOOL_VAL(PICCOLO_AS_NUM(a) < PICCOLO_AS_NUM(b)));
-                break;
+            STORE_FRAME();
+            PUSH(addValues(engine, b, a));
+            CHECK_ERROR();
+            DISPATCH();
+        }
+        OPCODE(SUB): {
+            piccolo_Value a = POP();
+            piccolo_Value b = POP();
+            if(PICCOLO_IS_NUM(a) && PICCOLO_IS_NUM(b)) {
+                QUICKEN(SUB_NUM_NUM);
+                PUSH(PICCOLO_NUM_VAL(PICCOLO_AS_NUM(b) - PICCOLO_AS_NUM(a)));
+                DISPATCH();
             }
-            case PICCOLO_OP_NEGATE: {
-                piccolo_Value val = piccolo_enginePopStack(engine);
-                if(!PICCOLO_IS_NUM(val)) {
-                    piccolo_runtimeError(engine, "Cannot negate %s.", piccolo_getTypeName(val));
-                    break;
-                }
-                if(!PICCOLO_AS_NUM(val)) {
-                    piccolo_runtimeError(engine, "Cannot negate nil.");
-                    break;
-                }
-                piccolo_enginePushStack(engine, PICCOLO_NUM_VAL(-PICCOLO_AS_NUM(val)));
-                break;
+            if(PICCOLO_IS_INT(a) && PICCOLO_IS_INT(b)) {
+                PUSH(PICCOLO_INT_VAL(engine, wrapSub(PICCOLO_AS_INT(b), PICCOLO_AS_INT(a))));
+                DISPATCH();
             }
-            case PICCOLO_OP_NOT: {
-                piccolo_Value val = piccolo_enginePopStack(engine);
-                if(!PICCOLO_IS_BOOL(val)) {
-                    piccolo_runtimeError(engine, "Cannot negate %s.", piccolo_getTypeName(val));
-                    break;
-                }
-                piccolo_enginePushStack(engine, PICCOLO_BOOL_VAL(!PICCOLO_AS_BOOL(val)));
-                break;
+            STORE_FRAME();
+            PUSH(subValues(engine, b, a));
+            CHECK_ERROR();
+            DISPATCH();
+        }
+        OPCODE(MUL): {
+            piccolo_Value a = POP();
+            piccolo_Value b = POP();
+            if(PICCOLO_IS_NUM(a) && PICCOLO_IS_NUM(b)) {
+                QUICKEN(MUL_NUM_NUM);
+                PUSH(PICCOLO_NUM_VAL(PICCOLO_AS_NUM(b) * PICCOLO_AS_NUM(a)));
+                DISPATCH();
             }
-            case PICCOLO_OP_LESS: {
-                piccolo_Value a = piccolo_enginePopStack(engine);
-                piccolo_Value b = piccolo_enginePopStack(engine);
-                if(!PICCOLO_IS_NUM(a) || !PICCOLO_IS_NUM(b)) {
-                    piccolo_runtimeError(engine, "Cannot compare %s and %s.", piccolo_getTypeName(a), piccolo_getTypeName(b));
-                }
-                piccolo_enginePushStack(engine, PICCOLO_BOOL_VAL(PICCOLO_AS_NUM(a) > PICCOLO_AS_NUM(b)));
-                break;
+            if(PICCOLO_IS_INT(a) && PICCOLO_IS_INT(b)) {
+                PUSH(PICCOLO_INT_VAL(engine, wrapMul(PICCOLO_AS_INT(b), PICCOLO_AS_INT(a))));
+                DISPATCH();
             }
-            case PICCOLO_OP_CREATE_ARRAY: {
-                int len = READ_PARAM();
-                struct piccolo_ObjArray* array = piccolo_newArray(engine, len);
-                for(int i = len - 1; i >= 0; i--) {
-                    array->array.values[i] = piccolo_enginePopStack(engine);
-                }
-                piccolo_enginePushStack(engine, PICCOLO_OBJ_VAL(array));
-                break;
+            STORE_FRAME();
+            PUSH(mulValues(engine, b, a));
+            CHECK_ERROR();
+            DISPATCH();
+        }
+        OPCODE(DIV): {
+            piccolo_Value a = POP();
+            piccolo_Value b = POP();
+            if(PICCOLO_IS_NUM(a) && PICCOLO_IS_NUM(b)) {
+                QUICKEN(DIV_NUM_NUM);
+                PUSH(PICCOLO_NUM_VAL(PICCOLO_AS_NUM(b) / PICCOLO_AS_NUM(a)));
+                DISPATCH();
             }
-            case PICCOLO_OP_CREATE_RANGE: {
-                piccolo_Value b = piccolo_enginePopStack(engine);
-                piccolo_Value a = piccolo_enginePopStack(engine);
-                if(!PICCOLO_IS_NUM(a) || !PICCOLO_IS_NUM(b)) {
-                    piccolo_runtimeError(engine, "Cannot create range between %s and %s.", piccolo_getTypeName(a), piccolo_getTypeName(b));
-                    break;
-                }
-                double aDouble = PICCOLO_AS_NUM(a);
-                double bDouble = PICCOLO_AS_NUM(b);
-                if(aDouble > INT_MAX || aDouble < INT_MIN ||
-                   bDouble > INT_MAX || bDouble < INT_MIN) {
-                    piccolo_runtimeError(engine, "Range limits too large");
-                    break;
-                }
-                int aNum = (int)aDouble;
-                int bNum = (int)bDouble;
-                struct piccolo_ObjArray* range = piccolo_newArray(engine, bNum - aNum);
-                for(int i = 0; i < bNum - aNum; i++)
-                    range->array.values[i] = PICCOLO_NUM_VAL(aNum + i);
-                piccolo_enginePushStack(engine, PICCOLO_OBJ_VAL(range));
-                break;
+            STORE_FRAME();
+            PUSH(divValues(engine, b, a));
+            CHECK_ERROR();
+            DISPATCH();
+        }
+        OPCODE(MOD): {
+            piccolo_Value a = POP();
+            piccolo_Value b = POP();
+            STORE_FRAME();
+            PUSH(modValues(engine, b, a));
+            CHECK_ERROR();
+            DISPATCH();
+        }
+        OPCODE(EQUAL): {
+            piccolo_Value a = POP();
+            piccolo_Value b = POP();
+            PUSH(PICCOLO_BOOL_VAL(piccolo_valuesEqual(a, b)));
+            DISPATCH();
+        }
+        OPCODE(GREATER): {
+            piccolo_Value a = POP();
+            piccolo_Value b = POP();
+            if(!PICCOLO_IS_NUM(a) || !PICCOLO_IS_NUM(b)) {
+                STORE_FRAME();
+                double order = compareValues(engine, a, b);
+                CHECK_ERROR();
+                PUSH(PICCOLO_BOOL_VAL(order < 0));
+                DISPATCH();
             }
-            case PICCOLO_OP_GET_IDX: {
-                piccolo_Value idx = piccolo_enginePopStack(engine);
-                piccolo_Value container = piccolo_enginePopStack(engine);
-                if(!PICCOLO_IS_OBJ(container)) {
-                    piccolo_runtimeError(engine, "Cannot index %s", piccolo_getTypeName(container));
-                    break;
-                } else {
-                    struct piccolo_Obj* containerObj = PICCOLO_AS_OBJ(container);
-                    piccolo_Value value = indexing(engine, containerObj, idx, false, PICCOLO_NIL_VAL());
-                    piccolo_enginePushStack(engine, value);
-                }
-                break;
+            QUICKEN(GREATER_NUM_NUM);
+            PUSH(PICCOLO_BOOL_VAL(PICCOLO_AS_NUM(a) < PICCOLO_AS_NUM(b)));
+            DISPATCH();
+        }
+        OPCODE(NEGATE): {
+            piccolo_Value val = POP();
+            if(PICCOLO_IS_INT(val)) {
+                PUSH(PICCOLO_INT_VAL(engine, wrapSub(0, PICCOLO_AS_INT(val))));
+                DISPATCH();
             }
-            case PICCOLO_OP_SET_IDX: {
-                piccolo_Value val = piccolo_enginePopStack(engine);
-                piccolo_Value idx = piccolo_enginePopStack(engine);
-                piccolo_Value container = piccolo_enginePopStack(engine);
-                if(!PICCOLO_IS_OBJ(container)) {
-                    piccolo_runtimeError(engine, "Cannot index %s", piccolo_getTypeName(container));
-                    break;
-                } else {
-                    struct piccolo_Obj* containerObj = PICCOLO_AS_OBJ(container);
-                    indexing(engine, containerObj, idx, true, val);
-                }
-                piccolo_enginePushStack(engine, val);
-                break;
+            if(!PICCOLO_IS_NUM(val)) {
+                RUNTIME_ERROR("Cannot negate %s.", piccolo_getTypeName(val));
             }
-            case PICCOLO_OP_POP_STACK: {
-                piccolo_enginePopStack(engine);
-                break;
+            if(!PICCOLO_AS_NUM(val)) {
+                RUNTIME_ERROR("Cannot negate nil.");
             }
-            case PICCOLO_OP_PEEK_STACK: {
-                int dist = READ_PARAM();
-                piccolo_Value val = piccolo_enginePeekStack(engine, dist);
-                piccolo_enginePushStack(engine, val);
-                break;
+            PUSH(PICCOLO_NUM_VAL(-PICCOLO_AS_NUM(val)));
+            DISPATCH();
+        }
+        OPCODE(NOT): {
+            piccolo_Value val = POP();
+            if(!PICCOLO_IS_BOOL(val)) {
+                RUNTIME_ERROR("Cannot negate %s.", piccolo_getTypeName(val));
             }
-            case PICCOLO_OP_SWAP_STACK: {
-                piccolo_Value a = piccolo_enginePopStack(engine);
-                piccolo_Value b = piccolo_enginePopStack(engine);
-                piccolo_enginePushStack(engine, a);
-                piccolo_enginePushStack(engine, b);
-                break;
+            PUSH(PICCOLO_BOOL_VAL(!PICCOLO_AS_BOOL(val)));
+            DISPATCH();
+        }
+        BITWISE_OP(BIT_AND)
+        BITWISE_OP(BIT_OR)
+        BITWISE_OP(BIT_XOR)
+        BITWISE_OP(SHIFT_LEFT)
+        BITWISE_OP(SHIFT_RIGHT)
+        OPCODE(BIT_NOT): {
+            piccolo_Value val = POP();
+            int64_t valInt;
+            if(!bitwiseOperand(val, &valInt)) {
+                RUNTIME_ERROR("Cannot complement %s.", piccolo_getTypeName(val));
             }
-            case PICCOLO_OP_HASHMAP: {
-                struct piccolo_ObjHashmap* hashmap = piccolo_newHashmap(engine);
-                struct piccolo_HashmapValue val;
-                piccolo_enginePushStack(engine, PICCOLO_OBJ_VAL(hashmap));
-                break;
+            PUSH(PICCOLO_INT_VAL(engine, ~valInt));
+            DISPATCH();
+        }
+        OPCODE(LESS): {
+            piccolo_Value a = POP();
+            piccolo_Value b = POP();
+            if(!PICCOLO_IS_NUM(a) || !PICCOLO_IS_NUM(b)) {
+                STORE_FRAME();
+                double order = compareValues(engine, a, b);
+                CHECK_ERROR();
+                PUSH(PICCOLO_BOOL_VAL(order > 0));
+                DISPATCH();
             }
-            case PICCOLO_OP_GET_LOCAL: {
-                int slot = READ_PARAM();
-                int realSlot = slot + CURR_FRAME.localStart;
-                piccolo_enginePushStack(engine, engine->locals.values[realSlot]);
-                break;
+            QUICKEN(LESS_NUM_NUM);
+            PUSH(PICCOLO_BOOL_VAL(PICCOLO_AS_NUM(a) > PICCOLO_AS_NUM(b)));
+            DISPATCH();
+        }
+        OPCODE(CREATE_ARRAY): {
+            int len = READ_PARAM();
+            STORE_FRAME();
+            struct piccolo_ObjArray* array = piccolo_newArray(engine, len);
+            for(int i = len - 1; i >= 0; i--) {
+                array->array.values[i] = POP();
             }
-            case PICCOLO_OP_SET_LOCAL: {
-                int slot = READ_PARAM();
-                int realSlot = slot + CURR_FRAME.localStart;
-                engine->locals.values[realSlot] = piccolo_enginePeekStack(engine, 1);
-                break;
+            PUSH(PICCOLO_OBJ_VAL(array));
+            DISPATCH();
+        }
+        OPCODE(UNPACK): {
+            int count = READ_PARAM();
+            piccolo_Value value = PEEK(1);
+            if(!PICCOLO_IS_ARRAY(value)) {
+                RUNTIME_ERROR("Cannot destructure %s.", piccolo_getTypeName(value));
             }
-            case PICCOLO_OP_PUSH_LOCAL: {
-                piccolo_writeValueArray(engine, &engine->locals, piccolo_enginePeekStack(engine, 1));
-                break;
+            struct piccolo_ObjArray* array = (struct piccolo_ObjArray*)PICCOLO_AS_OBJ(value);
+            if(array->array.count != count) {
+                RUNTIME_ERROR("Cannot destructure %d values into %d variables.", array->array.count, count);
             }
-            case PICCOLO_OP_POP_LOCALS: {
-                engine->locals.count -= READ_PARAM();
-                break;
+            stackTop--;
+            for(int i = 0; i < count; i++)
+                PUSH(array->array.values[i]);
+            DISPATCH();
+        }
+        OPCODE(CREATE_RANGE): {
+            piccolo_Value b = POP();
+            piccolo_Value a = POP();
+            if(!PICCOLO_IS_NUMERIC(a) || !PICCOLO_IS_NUMERIC(b)) {
+                RUNTIME_ERROR("Cannot create range between %s and %s.", piccolo_getTypeName(a), piccolo_getTypeName(b));
             }
-            case PICCOLO_OP_GET_GLOBAL: {
-                int slot = READ_PARAM();
-                while(CURR_FRAME.package->globals.count <= slot)
-                    piccolo_writeValueArray(engine, &CURR_FRAME.package->globals, PICCOLO_NIL_VAL());
-                piccolo_enginePushStack(engine, CURR_FRAME.package->globals.values[slot]);
-                break;
+            double aDouble = PICCOLO_TO_NUM(a);
+            double bDouble = PICCOLO_TO_NUM(b);
+            if(aDouble > INT_MAX || aDouble < INT_MIN ||
+               bDouble > INT_MAX || bDouble < INT_MIN) {
+                RUNTIME_ERROR("Range limits too large");
             }
-            case PICCOLO_OP_SET_GLOBAL: {
-                int slot = READ_PARAM();
-                while(CURR_FRAME.package->globals.count <= slot)
-                    piccolo_writeValueArray(engine, &CURR_FRAME.package->globals, PICCOLO_NIL_VAL());
-                CURR_FRAME.package->globals.values[slot] = piccolo_enginePeekStack(engine, 1);
-                break;
+            STORE_FRAME();
+            struct piccolo_ObjRange* range = piccolo_newRange(engine, (int)aDouble, (int)bDouble);
+            PUSH(PICCOLO_OBJ_VAL(range));
+            DISPATCH();
+        }
+        OPCODE(RANGE_FIRST): {
+            // Checks the limits of a range like CREATE_RANGE, and leaves the end below the counter
+            piccolo_Value b = POP();
+            piccolo_Value a = POP();
+            if(!PICCOLO_IS_NUMERIC(a) || !PICCOLO_IS_NUMERIC(b)) {
+                RUNTIME_ERROR("Cannot create range between %s and %s.", piccolo_getTypeName(a), piccolo_getTypeName(b));
             }
-            case PICCOLO_OP_JUMP: {
-                int jumpDist = READ_PARAM();
-                CURR_FRAME.ip += jumpDist - 3;
-                break;
+            double aDouble = PICCOLO_TO_NUM(a);
+            double bDouble = PICCOLO_TO_NUM(b);
+            if(aDouble > INT_MAX || aDouble < INT_MIN ||
+               bDouble > INT_MAX || bDouble < INT_MIN) {
+                RUNTIME_ERROR("Range limits too large");
             }
-            case PICCOLO_OP_JUMP_FALSE: {
-                int jumpDist = READ_PARAM();
-                piccolo_Value condition = piccolo_enginePopStack(engine);
-                if(!PICCOLO_IS_BOOL(condition)) {
-                    piccolo_runtimeError(engine, "Condition must be a boolean.");
-                    break;
+            PUSH(PICCOLO_NUM_VAL((int)bDouble));
+            PUSH(PICCOLO_NUM_VAL((int)aDouble));
+            DISPATCH();
+        }
+        OPCODE(GET_IDX): {
+            piccolo_Value idx = POP();
+            piccolo_Value container = POP();
+            if(!PICCOLO_IS_OBJ(container)) {
+                RUNTIME_ERROR("Cannot index %s", piccolo_getTypeName(container));
+            }
+            STORE_FRAME();
+            piccolo_Value value = indexing(engine, PICCOLO_AS_OBJ(container), idx, false, PICCOLO_NIL_VAL());
+            CHECK_ERROR();
+            PUSH(value);
+            DISPATCH();
+        }
+        OPCODE(SET_IDX): {
+            piccolo_Value val = POP();
+            piccolo_Value idx = POP();
+            piccolo_Value container = POP();
+            if(!PICCOLO_IS_OBJ(container)) {
+                RUNTIME_ERROR("Cannot index %s", piccolo_getTypeName(container));
+            }
+            STORE_FRAME();
+            indexing(engine, PICCOLO_AS_OBJ(container), idx, true, val);
+            CHECK_ERROR();
+            PUSH(val);
+            DISPATCH();
+        }
+        OPCODE(GET_MEMBER): {
+            piccolo_Value name = constants[READ_PARAM()];
+            struct piccolo_InlineCache* cache = &frame->bytecode->caches.values[READ_PARAM()];
+            piccolo_Value container = PEEK(1);
+            if(PICCOLO_IS_OBJ(container)) {
+                struct piccolo_Obj* containerObj = PICCOLO_AS_OBJ(container);
+                if(containerObj->type == PICCOLO_OBJ_PACKAGE && cache->key == containerObj) {
+                    PEEK(1) = ((struct piccolo_Package*)containerObj)->globals.values[cache->slot];
+                    DISPATCH();
                 }
-                if(!PICCOLO_AS_BOOL(condition)) {
-                    CURR_FRAME.ip += jumpDist - 3;
+                if(containerObj->type == PICCOLO_OBJ_NATIVE_STRUCT && cache->key != NULL && cache->key == ((struct piccolo_ObjNativeStruct*)containerObj)->properties) {
+                    PEEK(1) = *(piccolo_Value*)(PICCOLO_GET_PAYLOAD(containerObj, uint8_t) + cache->slot);
+                    DISPATCH();
                 }
-                break;
             }
-            case PICCOLO_OP_REV_JUMP: {
-                int jumpDist = READ_PARAM();
-                CURR_FRAME.ip -= jumpDist + 3;
-                break;
+            STORE_FRAME();
+            piccolo_Value value = getMember(engine, container, name, cache);
+            CHECK_ERROR();
+            PEEK(1) = value;
+            DISPATCH();
+        }
+        OPCODE(POP_STACK): {
+            stackTop--;
+            DISPATCH();
+        }
+        OPCODE(PEEK_STACK): {
+            int dist = READ_PARAM();
+            piccolo_Value val = PEEK(dist);
+            PUSH(val);
+            DISPATCH();
+        }
+        OPCODE(SWAP_STACK): {
+            piccolo_Value a = PEEK(1);
+            PEEK(1) = PEEK(2);
+            PEEK(2) = a;
+            DISPATCH();
+        }
+        OPCODE(HASHMAP): {
+            struct piccolo_ObjHashmap* hashmap = piccolo_newHashmap(engine);
+            PUSH(PICCOLO_OBJ_VAL(hashmap));
+            DISPATCH();
+        }
+        OPCODE(GET_LOCAL): {
+            int slot = READ_PARAM();
+            PUSH(locals[slot]);
+            DISPATCH();
+        }
+        OPCODE(SET_LOCAL): {
+            int slot = READ_PARAM();
+            locals[slot] = PEEK(1);
+            DISPATCH();
+        }
+        OPCODE(POP_LOCALS): {
+            stackTop -= READ_PARAM();
+            DISPATCH();
+        }
+        OPCODE(GET_GLOBAL): {
+            int slot = READ_PARAM();
+            while(frame->package->globals.count <= slot)
+                piccolo_writeValueArray(engine, &frame->package->globals, PICCOLO_NIL_VAL());
+            PUSH(frame->package->globals.values[slot]);
+            DISPATCH();
+        }
+        OPCODE(SET_GLOBAL): {
+            int slot = READ_PARAM();
+            while(frame->package->globals.count <= slot)
+                piccolo_writeValueArray(engine, &frame->package->globals, PICCOLO_NIL_VAL());
+            frame->package->globals.values[slot] = PEEK(1);
+            DISPATCH();
+        }
+        OPCODE(JUMP): {
+            int jumpDist = READ_PARAM();
+            ip += jumpDist - 3;
+            DISPATCH();
+        }
+        OPCODE(JUMP_FALSE): {
+            int jumpDist = READ_PARAM();
+            piccolo_Value condition = POP();
+            if(!PICCOLO_IS_BOOL(condition)) {
+                RUNTIME_ERROR("Condition must be a boolean.");
             }
-            case PICCOLO_OP_REV_JUMP_FALSE: {
-                int jumpDist = READ_PARAM();
-                piccolo_Value condition = piccolo_enginePopStack(engine);
-                if(!PICCOLO_IS_BOOL(condition)) {
-                    piccolo_runtimeError(engine, "Condition must be a boolean.");
-                    break;
-                }
-                if(!PICCOLO_AS_BOOL(condition)) {
-                    CURR_FRAME.ip -= jumpDist + 3;
+            if(!PICCOLO_AS_BOOL(condition)) {
+                ip += jumpDist - 3;
+            }
+            DISPATCH();
+        }
+        OPCODE(REV_JUMP): {
+            int jumpDist = READ_PARAM();
+            ip -= jumpDist + 3;
+            SAFEPOINT();
+            if(frame->closure != NULL) {
+                COUNT_HOTNESS(frame->closure->prototype);
+                ENTER_JIT();
+            }
+            DISPATCH();
+        }
+        OPCODE(REV_JUMP_FALSE): {
+            int jumpDist = READ_PARAM();
+            piccolo_Value condition = POP();
+            if(!PICCOLO_IS_BOOL(condition)) {
+                RUNTIME_ERROR("Condition must be a boolean.");
+            }
+            if(!PICCOLO_AS_BOOL(condition)) {
+                ip -= jumpDist + 3;
+                SAFEPOINT();
+                if(frame->closure != NULL) {
+                    COUNT_HOTNESS(frame->closure->prototype);
+                    ENTER_JIT();
                 }
-                break;
             }
-            case PICCOLO_OP_CALL: {
-                int argCount = READ_PARAM();
-                pushFrame(engine);
-                CURR_FRAME.localStart = engine->locals.count;
-                for(int i = 0; i < argCount; i++)
-                    piccolo_writeValueArray(engine, &engine->locals, PICCOLO_NIL_VAL());
-                for(int i = argCount; i > 0; i--) {
-                    piccolo_Value arg = piccolo_enginePopStack(engine);
-                    engine->locals.values[CURR_FRAME.localStart + (i - 1)] = arg;
+            DISPATCH();
+        }
+        OPCODE(TAIL_CALL): {
+            /*
+                A closure called in tail position takes over the current frame: the called closure
+                and its arguments move down to where the current one and its arguments are.
+                Anything else is called like a regular CALL.
+             */
+            int argCount = PARAM_AT(1);
+            piccolo_Value func = PEEK(argCount + 1);
+            if(frame->closure != NULL && PICCOLO_IS_CLOSURE(func)) {
+                struct piccolo_ObjClosure* closureObj = (struct piccolo_ObjClosure*)PICCOLO_AS_OBJ(func);
+                struct piccolo_ObjFunction* funcObj = closureObj->prototype;
+                if(funcObj->arity != argCount) {
+                    RUNTIME_ERROR("Wrong argument count.");
                 }
-                piccolo_Value func = piccolo_enginePopStack(engine);
-
-                if(engine->callFrames.count == PICCOLO_MAX_FRAMES) {
-                    popFrame(engine);
-                    piccolo_runtimeError(engine, "Recursion stack overflow.");
-                    break;
+                if(engine->openUpvals != NULL)
+                    closeUpvals(engine, frame->localStart);
+                memmove(locals - 1, stackTop - argCount - 1, sizeof(piccolo_Value) * (argCount + 1));
+                engine->stackTop = locals + argCount;
+                if(!piccolo_ensureStack(engine, funcObj->bytecode.maxStack - argCount)) {
+                    stackTop = engine->stackTop;
+                    RUNTIME_ERROR("Stack overflow.");
                 }
+                frame->ip = frame->prevIp = 0;
+                frame->bytecode = &funcObj->bytecode;
+                frame->closure = closureObj;
+                frame->package = closureObj->package;
+                LOAD_FRAME();
+                SAFEPOINT();
+                COUNT_HOTNESS(funcObj);
+                ENTER_JIT();
+                DISPATCH();
+            }
+        }
+        // fallthrough
+        OPCODE(CALL): {
+            /*
+                The arguments stay where the caller pushed them and become the first locals of the
+                new frame, with the called function right below them. Natives get no frame, they
+                are handed the arguments where they are.
+             */
+            int argCount = READ_PARAM();
+            piccolo_Value func = PEEK(argCount + 1);
 
-                if(!PICCOLO_IS_CLOSURE(func) && !PICCOLO_IS_NATIVE_FN(func)) {
-                    popFrame(engine);
-                    piccolo_runtimeError(engine, "Cannot call %s.", piccolo_getTypeName(func));
-                    break;
+            if(!PICCOLO_IS_CLOSURE(func) && !PICCOLO_IS_NATIVE_FN(func)) {
+                RUNTIME_ERROR("Cannot call %s.", piccolo_getTypeName(func));
+            }
+            enum piccolo_ObjType type = PICCOLO_AS_OBJ(func)->type;
+
+            STORE_FRAME();
+            if(type == PICCOLO_OBJ_CLOSURE) {
+                struct piccolo_ObjClosure* closureObj = (struct piccolo_ObjClosure*)PICCOLO_AS_OBJ(func);
+                struct piccolo_ObjFunction* funcObj = closureObj->prototype;
+                if(engine->callFrames.count + 1 == PICCOLO_MAX_FRAMES) {
+                    RUNTIME_ERROR("Recursion stack overflow.");
                 }
-                enum piccolo_ObjType type = PICCOLO_AS_OBJ(func)->type;
-
-                if(type == PICCOLO_OBJ_CLOSURE) {
-                    struct piccolo_ObjClosure* closureObj = (struct piccolo_ObjClosure*)PICCOLO_AS_OBJ(func);
-                    struct piccolo_ObjFunction* funcObj = closureObj->prototype;
-                    CURR_FRAME.ip = CURR_FRAME.prevIp = 0;
-                    CURR_FRAME.bytecode = &funcObj->bytecode;
-                    CURR_FRAME.closure = closureObj;
-                    CURR_FRAME.package = closureObj->package;
-                    if (funcObj->arity != argCount) {
-                        popFrame(engine);
-                        piccolo_runtimeError(engine, "Wrong argument count.");
-                        break;
-                    }
+                if(funcObj->arity != argCount) {
+                    RUNTIME_ERROR("Wrong argument count.");
                 }
-                if(type == PICCOLO_OBJ_NATIVE_FN) {
-                    struct piccolo_ObjNativeFn* native = (struct piccolo_ObjNativeFn*)PICCOLO_AS_OBJ(func);
-                    popFrame(engine);
-                    if(argCount == 0) {
-                        piccolo_enginePushStack(engine, native->native(engine, 0, NULL, native->self));
-                        break;
-                    }
-                    piccolo_enginePushStack(engine, native->native(engine, argCount, &engine->locals.values[engine->callFrames.values[engine->callFrames.count].localStart], native->self));
-                    engine->locals.count -= argCount;
-                    break;
+                if(!piccolo_ensureStack(engine, funcObj->bytecode.maxStack - argCount)) {
+                    RUNTIME_ERROR("Stack overflow.");
                 }
-                break;
+                int localStart = (int)(engine->stackTop - engine->stack) - argCount;
+                pushFrame(engine);
+                CURR_FRAME.localStart = localStart;
+                CURR_FRAME.ip = CURR_FRAME.prevIp = 0;
+                CURR_FRAME.bytecode = &funcObj->bytecode;
+                CURR_FRAME.closure = closureObj;
+                CURR_FRAME.package = closureObj->package;
+                LOAD_FRAME();
+                SAFEPOINT();
+                COUNT_HOTNESS(funcObj);
+                ENTER_JIT();
+                DISPATCH();
             }
-            case PICCOLO_OP_CLOSURE: {
-                piccolo_Value val = piccolo_enginePopStack(engine);
-                struct piccolo_ObjFunction* func = (struct piccolo_ObjFunction*)PICCOLO_AS_OBJ(val);
-                int upvals = READ_PARAM();
-                struct piccolo_ObjClosure* closure = piccolo_newClosure(engine, func, upvals);
-                for(int i = 0; i < upvals; i++) {
-                    int slot = READ_PARAM();
-                    if(READ_BYTE())
-                        closure->upvals[i] = findUpval(engine, slot + CURR_FRAME.localStart);
-                    else
-                        closure->upvals[i] = CURR_FRAME.closure->upvals[slot];
-                }
-                closure->package = CURR_FRAME.package;
-                piccolo_enginePushStack(engine, PICCOLO_OBJ_VAL(closure));
-                break;
+            struct piccolo_ObjNativeFn* native = (struct piccolo_ObjNativeFn*)PICCOLO_AS_OBJ(func);
+            if(native->arity != -1 && native->arity != argCount) {
+                RUNTIME_ERROR("Wrong argument count.");
             }
-            case PICCOLO_OP_GET_UPVAL: {
-                int slot = READ_PARAM();
-                struct piccolo_ObjUpval* upval = CURR_FRAME.closure->upvals[slot];
-                if(upval->open) {
-                    int idx = CURR_FRAME.closure->upvals[slot]->val.idx;
-                    piccolo_enginePushStack(engine, engine->locals.values[idx]);
-                } else {
-                    piccolo_enginePushStack(engine, *CURR_FRAME.closure->upvals[slot]->val.ptr);
+            piccolo_Value result = native->native(engine, argCount, stackTop - argCount, native->self);
+            FINISH_NATIVE_CALL(result, argCount);
+            DISPATCH();
+        }
+        OPCODE(INVOKE): {
+            /*
+                obj.method(args), always followed by its CALL or TAIL_CALL, with the receiver where
+                the called value would be. Methods of native structs are called right here with the
+                receiver as self and the CALL is skipped. Anything else is looked up like GET_MEMBER
+                and takes the receiver's place for the CALL.
+             */
+            piccolo_Value name = constants[READ_PARAM()];
+            struct piccolo_InlineCache* cache = &frame->bytecode->caches.values[READ_PARAM()];
+            int argCount = PARAM_AT(6);
+            piccolo_Value receiver = PEEK(argCount + 1);
+            if(PICCOLO_IS_OBJ(receiver)) {
+                struct piccolo_Obj* receiverObj = PICCOLO_AS_OBJ(receiver);
+                if(receiverObj->type == PICCOLO_OBJ_PACKAGE && cache->key == receiverObj) {
+                    PEEK(argCount + 1) = ((struct piccolo_Package*)receiverObj)->globals.values[cache->slot];
+                    DISPATCH();
+                }
+                if(receiverObj->type == PICCOLO_OBJ_NATIVE_STRUCT) {
+                    struct piccolo_ObjNativeStruct* nativeStruct = (struct piccolo_ObjNativeStruct*)receiverObj;
+                    const struct piccolo_NativeMethod* method = NULL;
+                    if(cache->key != NULL && cache->key == nativeStruct->methods) {
+                        method = &nativeStruct->methods[cache->slot];
+                    } else if(cache->key != NULL && cache->key == nativeStruct->properties) {
+                        PEEK(argCount + 1) = *(piccolo_Value*)(PICCOLO_GET_PAYLOAD(nativeStruct, uint8_t) + cache->slot);
+                        DISPATCH();
+                    } else {
+                        method = findMethod(nativeStruct, (struct piccolo_ObjString*)PICCOLO_AS_OBJ(name));
+                        if(method != NULL) {
+                            cache->key = nativeStruct->methods;
+                            cache->slot = (int)(method - nativeStruct->methods);
+                        }
+                    }
+                    if(method != NULL) {
+                        if(method->arity != -1 && method->arity != argCount) {
+                            RUNTIME_ERROR("Wrong argument count.");
+                        }
+                        ip += 3;
+                        STORE_FRAME();
+                        piccolo_Value result = method->native(engine, argCount, stackTop - argCount, receiver);
+                        FINISH_NATIVE_CALL(result, argCount);
+                        DISPATCH();
+                    }
                 }
-                break;
             }
-            case PICCOLO_OP_SET_UPVAL: {
+            STORE_FRAME();
+            piccolo_Value value = getMember(engine, receiver, name, cache);
+            CHECK_ERROR();
+            PEEK(argCount + 1) = value;
+            DISPATCH();
+        }
+        OPCODE(CLOSURE): {
+            piccolo_Value val = POP();
+            struct piccolo_ObjFunction* func = (struct piccolo_ObjFunction*)PICCOLO_AS_OBJ(val);
+            int upvals = READ_PARAM();
+            struct piccolo_ObjClosure* closure = piccolo_newClosure(engine, func, upvals);
+            for(int i = 0; i < upvals; i++) {
                 int slot = READ_PARAM();
-                struct piccolo_ObjUpval* upval = CURR_FRAME.closure->upvals[slot];
-                piccolo_Value val = piccolo_enginePeekStack(engine, 1);
-                if(upval->open) {
-                    engine->locals.values[upval->val.idx] = val;
-                } else {
-                    *upval->val.ptr = val;
-                }
-                break;
+                if(READ_BYTE())
+                    closure->upvals[i] = findUpval(engine, frame->localStart + slot);
+                else
+                    closure->upvals[i] = frame->closure->upvals[slot];
             }
-            case PICCOLO_OP_APPEND: {
-                piccolo_Value val = piccolo_enginePopStack(engine);
-                struct piccolo_ObjArray* arr = (struct piccolo_ObjArray*) PICCOLO_AS_OBJ(piccolo_enginePeekStack(engine, 1));
-                piccolo_writeValueArray(engine, &arr->array, val);
-                break;
+            closure->package = frame->package;
+            PUSH(PICCOLO_OBJ_VAL(closure));
+            DISPATCH();
+        }
+        OPCODE(GET_UPVAL): {
+            int slot = READ_PARAM();
+            struct piccolo_ObjUpval* upval = frame->closure->upvals[slot];
+            if(upval->open) {
+                PUSH(*openUpvalSlot(engine, upval));
+            } else {
+                PUSH(*upval->val.ptr);
             }
-            case PICCOLO_OP_CLOSE_UPVALS: {
-                struct piccolo_ObjUpval* newOpen = NULL;
-                struct piccolo_ObjUpval* curr = engine->openUpvals;
-                while(curr != NULL) {
-                    struct piccolo_ObjUpval* next = curr->next;
-                    if(shouldCloseUpval(engine, curr)) {
-                        curr->open = false;
-                        piccolo_Value* heapUpval = PICCOLO_REALLOCATE("heap upval", engine, NULL, 0, sizeof(piccolo_Value));
-                        *heapUpval = engine->locals.values[curr->val.idx];
-                        curr->val.ptr = heapUpval;
-                    } else {
-                        curr->next = newOpen;
-                        newOpen = curr;
-                    }
-                    curr = next;
-                }
-                engine->openUpvals = newOpen;
-                break;
+            DISPATCH();
+        }
+        OPCODE(SET_UPVAL): {
+            int slot = READ_PARAM();
+            struct piccolo_ObjUpval* upval = frame->closure->upvals[slot];
+            piccolo_Value val = PEEK(1);
+            if(upval->open) {
+                *openUpvalSlot(engine, upval) = val;
+            } else {
+                *upval->val.ptr = val;
+                piccolo_gcWriteBarrier(engine, &upval->obj, val);
             }
-            case PICCOLO_OP_GET_LEN: {
-                piccolo_Value val = piccolo_enginePopStack(engine);
-                if(PICCOLO_IS_STRING(val)) {
-                    struct piccolo_ObjString* str = (struct piccolo_ObjString*)PICCOLO_AS_OBJ(val);
-                    piccolo_enginePushStack(engine, PICCOLO_NUM_VAL(str->utf8Len));
-                    break;
-                }
-                if(PICCOLO_IS_ARRAY(val)) {
-                    struct piccolo_ObjArray* arr = (struct piccolo_ObjArray*) PICCOLO_AS_OBJ(val);
-                    piccolo_enginePushStack(engine, PICCOLO_NUM_VAL(arr->array.count));
-                    break;
-                }
-                
-                piccolo_runtimeError(engine, "Cannot get length of %s.", piccolo_getTypeName(val));
-                break;
+            DISPATCH();
+        }
+        OPCODE(APPEND): {
+            piccolo_Value val = POP();
+            struct piccolo_ObjArray* arr = (struct piccolo_ObjArray*) PICCOLO_AS_OBJ(PEEK(1));
+            piccolo_writeValueArray(engine, &arr->array, val);
+            piccolo_gcWriteBarrier(engine, &arr->obj, val);
+            DISPATCH();
+        }
+        OPCODE(ACC_CREATE): {
+            // The slots above the result hold the container of a for loop, or the end and counter of a counted loop
+            int slot = READ_PARAM();
+            piccolo_Value container = locals[slot + 1];
+            int len = 0;
+            if(PICCOLO_IS_NUM(container)) {
+                double count = PICCOLO_AS_NUM(container) - PICCOLO_AS_NUM(locals[slot + 2]);
+                len = count > 0 ? (int)count : 0;
+            } else if(PICCOLO_IS_ARRAY(container)) {
+                len = ((struct piccolo_ObjArray*)PICCOLO_AS_OBJ(container))->array.count;
+            } else if(PICCOLO_IS_RANGE(container)) {
+                len = piccolo_rangeLength((struct piccolo_ObjRange*)PICCOLO_AS_OBJ(container));
+            } else if(PICCOLO_IS_STRING(container)) {
+                len = ((struct piccolo_ObjString*)PICCOLO_AS_OBJ(container))->utf8Len;
+            } else if(PICCOLO_IS_HASHMAP(container)) {
+                len = ((struct piccolo_ObjHashmap*)PICCOLO_AS_OBJ(container))->hashmap.count;
             }
-            case PICCOLO_OP_IN: {
-                piccolo_Value container = piccolo_enginePopStack(engine);
-                piccolo_Value key = piccolo_enginePopStack(engine);
-                if(!PICCOLO_IS_HASHMAP(container)) {
-                    piccolo_runtimeError(engine, "Container must be a hashmap.");
-                    break;
-                }
-                struct piccolo_ObjHashmap* hashmap = (struct piccolo_ObjHashmap*)PICCOLO_AS_OBJ(container);
-                struct piccolo_HashmapValue entry = piccolo_getHashmap(engine, &hashmap->hashmap, key);
-                piccolo_enginePushStack(engine, PICCOLO_BOOL_VAL(entry.exists));
-                break;
+            STORE_FRAME();
+            struct piccolo_ObjArray* result = piccolo_newArray(engine, 0);
+            if(len > 0) {
+                result->array.values = PICCOLO_GROW_ARRAY(engine, piccolo_Value, NULL, 0, len);
+                result->array.capacity = len;
             }
-            case PICCOLO_OP_ITER_FIRST: {
-                piccolo_Value container = piccolo_enginePeekStack(engine, 1);
-                if(!PICCOLO_IS_OBJ(container)) {
-                    piccolo_runtimeError(engine, "Cannot iterate over %s.", piccolo_getTypeName(container));
-                    break;
-                }
-                if(!PICCOLO_IS_ARRAY(container) &&
-                   !PICCOLO_IS_STRING(container) &&
-                   !PICCOLO_IS_HASHMAP(container)) {
-                    piccolo_runtimeError(engine, "Cannot iterate over %s.", piccolo_getTypeName(container));
-                    break;
-                }
-                struct piccolo_Obj* containerObj = PICCOLO_AS_OBJ(container);
-                if(containerObj->type == PICCOLO_OBJ_ARRAY || containerObj->type == PICCOLO_OBJ_STRING)
-                    piccolo_enginePushStack(engine, PICCOLO_NUM_VAL(0));
-                if(containerObj->type == PICCOLO_OBJ_HASHMAP) {
-                    int idx = 0;
-                    struct piccolo_ObjHashmap* hashmap = (struct piccolo_ObjHashmap*)containerObj;
-                    while(idx < hashmap->hashmap.capacity && !hashmap->hashmap.entries[idx].val.exists)
-                        idx++;
-                    piccolo_enginePushStack(engine, PICCOLO_NUM_VAL(idx));
-                }
-                break;
+            locals[slot] = PICCOLO_OBJ_VAL(result);
+            DISPATCH();
+        }
+        OPCODE(ACC_APPEND): {
+            piccolo_Value val = POP();
+            struct piccolo_ObjArray* arr = (struct piccolo_ObjArray*)PICCOLO_AS_OBJ(locals[READ_PARAM()]);
+            piccolo_writeValueArray(engine, &arr->array, val);
+            piccolo_gcWriteBarrier(engine, &arr->obj, val);
+            DISPATCH();
+        }
+        OPCODE(CLOSE_UPVALS): {
+            int slot = READ_PARAM();
+            if(engine->openUpvals != NULL)
+                closeUpvals(engine, frame->localStart + slot);
+            DISPATCH();
+        }
+        OPCODE(GET_LEN): {
+            piccolo_Value val = POP();
+            if(PICCOLO_IS_STRING(val)) {
+                struct piccolo_ObjString* str = (struct piccolo_ObjString*)PICCOLO_AS_OBJ(val);
+                PUSH(PICCOLO_NUM_VAL(str->utf8Len));
+                DISPATCH();
             }
-            case PICCOLO_OP_ITER_CONT: {
-                piccolo_Value iterator = piccolo_enginePopStack(engine);
-                piccolo_Value container = piccolo_enginePopStack(engine);
-                struct piccolo_Obj* containerObj = PICCOLO_AS_OBJ(container);
-                int idx = PICCOLO_AS_NUM(iterator);
-                bool last = false;
-                switch(containerObj->type) {
-                    case PICCOLO_OBJ_ARRAY: {
-                        last = idx >= ((struct piccolo_ObjArray*)containerObj)->array.count;
-                        break;
-                    }
-                    case PICCOLO_OBJ_STRING: {
-                        last = idx >= ((struct piccolo_ObjString*)containerObj)->len;
-                        break;
-                    }
-                    case PICCOLO_OBJ_HASHMAP: {
-                        last = idx >= ((struct piccolo_ObjHashmap*)containerObj)->hashmap.capacity;
-                        break;
-                    }
-                    case PICCOLO_OBJ_FUNC:
-                    case PICCOLO_OBJ_UPVAL:
-                    case PICCOLO_OBJ_CLOSURE:
-                    case PICCOLO_OBJ_NATIVE_FN:
-                    case PICCOLO_OBJ_PACKAGE:
-                    case PICCOLO_OBJ_NATIVE_STRUCT: {
-                        piccolo_runtimeError(engine, "Invalid operand to iterator.");
-                        break;
-                    }
-                }
-                piccolo_enginePushStack(engine, PICCOLO_BOOL_VAL(!last));
-                break;
+            if(PICCOLO_IS_ARRAY(val)) {
+                struct piccolo_ObjArray* arr = (struct piccolo_ObjArray*) PICCOLO_AS_OBJ(val);
+                PUSH(PICCOLO_NUM_VAL(arr->array.count));
+                DISPATCH();
             }
-            case PICCOLO_OP_ITER_NEXT: {
-                piccolo_Value container = piccolo_enginePeekStack(engine, READ_PARAM());
-                piccolo_Value iterator = piccolo_enginePopStack(engine);
-                struct piccolo_Obj* containerObj = PICCOLO_AS_OBJ(container);
-                int idx = PICCOLO_AS_NUM(iterator);
-                if(containerObj->type == PICCOLO_OBJ_ARRAY)
-                    idx++;
-                if(containerObj->type == PICCOLO_OBJ_STRING) {
-                    struct piccolo_ObjString* str = (struct piccolo_ObjString*)containerObj;
-                    idx += piccolo_strutil_utf8Chars(str->string[idx]);
-                }
-                if(containerObj->type == PICCOLO_OBJ_HASHMAP) {
-                    idx++;
-                    while(idx < ((struct piccolo_ObjHashmap*)containerObj)->hashmap.capacity && !((struct piccolo_ObjHashmap*)containerObj)->hashmap.entries[idx].val.exists)
-                        idx++;
-                }
-                piccolo_enginePushStack(engine, PICCOLO_NUM_VAL(idx));
-                break;
+            if(PICCOLO_IS_RANGE(val)) {
+                PUSH(PICCOLO_NUM_VAL(piccolo_rangeLength((struct piccolo_ObjRange*)PICCOLO_AS_OBJ(val))));
+                DISPATCH();
             }
-            case PICCOLO_OP_ITER_GET: {
-                int idx = PICCOLO_AS_NUM(piccolo_enginePopStack(engine));
-                struct piccolo_Obj* container = PICCOLO_AS_OBJ(piccolo_enginePopStack(engine));
-                piccolo_Value val;
-                if(container->type == PICCOLO_OBJ_ARRAY)
-                    val = indexing(engine, container, PICCOLO_NUM_VAL(idx), false, PICCOLO_NIL_VAL());
-                if(container->type == PICCOLO_OBJ_STRING) {
-                    struct piccolo_ObjString* string = (struct piccolo_ObjString*)container;
-                    char str[5];
-                    int charCnt = piccolo_strutil_utf8Chars(string->string[idx]);
-                    memcpy(str, &string->string[idx], charCnt);
-                    str[charCnt] = '\0';
-                    struct piccolo_ObjString* result = piccolo_copyString(engine, str, charCnt);
-                    val = PICCOLO_OBJ_VAL(result);
-                }
-                if(container->type == PICCOLO_OBJ_HASHMAP)
-                    val = ((struct piccolo_ObjHashmap*)container)->hashmap.entries[idx].key;
-                piccolo_enginePushStack(engine, val);
-                break;
+
+            RUNTIME_ERROR("Cannot get length of %s.", piccolo_getTypeName(val));
+        }
+        OPCODE(IN): {
+            piccolo_Value container = POP();
+            piccolo_Value key = POP();
+            if(!PICCOLO_IS_HASHMAP(container)) {
+                RUNTIME_ERROR("Container must be a hashmap.");
             }
-            case PICCOLO_OP_EXECUTE_PACKAGE: {
-                piccolo_Value val = piccolo_enginePeekStack(engine, 1);
-                struct piccolo_Package* package = (struct piccolo_Package*)PICCOLO_AS_OBJ(val);
-                if(!package->executed && package->compiled) {
-                    pushFrame(engine);
-                    CURR_FRAME.package = package;
-                    CURR_FRAME.closure = NULL;
-                    CURR_FRAME.ip = 0;
-                    CURR_FRAME.bytecode = &package->bytecode;
-                    CURR_FRAME.localStart = engine->locals.count;
-                    package->executed = true;
+            struct piccolo_ObjHashmap* hashmap = (struct piccolo_ObjHashmap*)PICCOLO_AS_OBJ(container);
+            struct piccolo_HashmapValue entry = piccolo_getHashmap(engine, &hashmap->hashmap, key);
+            PUSH(PICCOLO_BOOL_VAL(entry.exists));
+            DISPATCH();
+        }
+        OPCODE(ITER_FIRST): {
+            piccolo_Value container = PEEK(1);
+            STORE_FRAME();
+            piccolo_Value iterator = piccolo_iterFirst(engine, container);
+            CHECK_ERROR();
+            RELOAD_AFTER_ITER_HOOK(container);
+            PUSH(iterator);
+            DISPATCH();
+        }
+        OPCODE(ITER_CONT): {
+            piccolo_Value iterator = POP();
+            piccolo_Value container = POP();
+            STORE_FRAME();
+            bool cont = piccolo_iterCont(engine, container, iterator);
+            CHECK_ERROR();
+            PUSH(PICCOLO_BOOL_VAL(cont));
+            DISPATCH();
+        }
+        OPCODE(ITER_NEXT): {
+            piccolo_Value container = PEEK(READ_PARAM());
+            piccolo_Value iterator = POP();
+            STORE_FRAME();
+            iterator = piccolo_iterNext(engine, container, iterator);
+            CHECK_ERROR();
+            RELOAD_AFTER_ITER_HOOK(container);
+            PUSH(iterator);
+            DISPATCH();
+        }
+        OPCODE(ITER_GET): {
+            piccolo_Value iterator = POP();
+            piccolo_Value container = POP();
+            STORE_FRAME();
+            piccolo_Value val = piccolo_iterGet(engine, container, iterator);
+            CHECK_ERROR();
+            RELOAD_AFTER_ITER_HOOK(container);
+            PUSH(val);
+            DISPATCH();
+        }
+        OPCODE(EXECUTE_PACKAGE): {
+            piccolo_Value val = PEEK(1);
+            struct piccolo_Package* package = (struct piccolo_Package*)PICCOLO_AS_OBJ(val);
+            if(!package->executed && package->compiled) {
+                STORE_FRAME();
+                if(!piccolo_ensureStack(engine, package->bytecode.maxStack)) {
+                    RUNTIME_ERROR("Stack overflow.");
                 }
-                break;
+                pushFrame(engine);
+                CURR_FRAME.package = package;
+                CURR_FRAME.closure = NULL;
+                CURR_FRAME.ip = 0;
+                CURR_FRAME.bytecode = &package->bytecode;
+                CURR_FRAME.localStart = (int)(engine->stackTop - engine->stack);
+                package->executed = true;
+                LOAD_FRAME();
             }
-            default: {
-                piccolo_runtimeError(engine, "Unknown opcode.");
-                break;
+            DISPATCH();
+        }
+        NUM_NUM_OP(ADD_NUM_NUM, ADD, NUM, +)
+        NUM_NUM_OP(SUB_NUM_NUM, SUB, NUM, -)
+        NUM_NUM_OP(MUL_NUM_NUM, MUL, NUM, *)
+        NUM_NUM_OP(DIV_NUM_NUM, DIV, NUM, /)
+        NUM_NUM_OP(GREATER_NUM_NUM, GREATER, BOOL, >)
+        NUM_NUM_OP(LESS_NUM_NUM, LESS, BOOL, <)
+        OPCODE(ADD_CONST_LOCAL): {
+            // GET_LOCAL a, CONST c, ADD, SET_LOCAL b
+            piccolo_Value a = locals[PARAM_AT(1)];
+            piccolo_Value c = constants[PARAM_AT(4)];
+            if(!PICCOLO_IS_NUM(a) || !PICCOLO_IS_NUM(c)) {
+                ip = opStart + 3;
+                PUSH(a);
+                DISPATCH();
             }
+            piccolo_Value result = PICCOLO_NUM_VAL(PICCOLO_AS_NUM(a) + PICCOLO_AS_NUM(c));
+            locals[PARAM_AT(8)] = result;
+            PUSH(result);
+            ip = opStart + 10;
+            DISPATCH();
         }
-#ifdef PICCOLO_ENABLE_ENGINE_DEBUG
-        piccolo_disassembleInstruction(CURR_FRAME.bytecode, CURR_FRAME.prevIp);
-        printf("DATA STACK:\n");
-        for(piccolo_Value* stackPtr = engine->stack; stackPtr != engine->stackTop; stackPtr++) {
-            printf("[");
-            piccolo_printValue(*stackPtr);
-            printf("] ");
-        }
-        printf("\n");
-        printf("LOCAL STACK:\n");
-        for(int i = 0; i < engine->locals.count; i++) {
-            printf("[");
-            piccolo_printValue(engine->locals.values[i]);
-            printf("] ");
-        }
-        printf("\n");
-#endif
-        if(engine->liveMemory > engine->gcThreshold) {
-            piccolo_collectGarbage(engine);
-            engine->gcThreshold = engine->liveMemory * 2;
+        OPCODE(ADD_CONST_GLOBAL): {
+            // GET_GLOBAL a, CONST c, ADD, SET_GLOBAL b
+            struct piccolo_ValueArray* globals = &frame->package->globals;
+            int src = PARAM_AT(1);
+            int dst = PARAM_AT(8);
+            while(globals->count <= src || globals->count <= dst)
+                piccolo_writeValueArray(engine, globals, PICCOLO_NIL_VAL());
+            piccolo_Value a = globals->values[src];
+            piccolo_Value c = constants[PARAM_AT(4)];
+            if(!PICCOLO_IS_NUM(a) || !PICCOLO_IS_NUM(c)) {
+                ip = opStart + 3;
+                PUSH(a);
+                DISPATCH();
+            }
+            piccolo_Value result = PICCOLO_NUM_VAL(PICCOLO_AS_NUM(a) + PICCOLO_AS_NUM(c));
+            globals->values[dst] = result;
+            PUSH(result);
+            ip = opStart + 10;
+            DISPATCH();
+        }
+        COMPARE_JUMP_FALSE_OP(LESS_JUMP_FALSE, <)
+        COMPARE_JUMP_FALSE_OP(GREATER_JUMP_FALSE, >)
+        OPCODE(NOT_EQUAL): {
+            piccolo_Value a = POP();
+            piccolo_Value b = POP();
+            PUSH(PICCOLO_BOOL_VAL(!piccolo_valuesEqual(a, b)));
+            ip = opStart + 2;
+            DISPATCH();
+        }
+        OPCODE(ITER_LOOP): {
+            // PEEK_STACK d, PEEK_STACK d, ITER_CONT, JUMP_FALSE
+            int dist = PARAM_AT(1);
+            piccolo_Value container = PEEK(dist);
+            int idx = PICCOLO_AS_NUM(PEEK(dist - 1));
+            struct piccolo_Obj* containerObj = PICCOLO_IS_OBJ(container) ? PICCOLO_AS_OBJ(container) : NULL;
+            int end;
+            if(containerObj && containerObj->type == PICCOLO_OBJ_ARRAY) {
+                end = ((struct piccolo_ObjArray*)containerObj)->array.count;
+            } else if(containerObj && containerObj->type == PICCOLO_OBJ_RANGE) {
+                end = piccolo_rangeLength((struct piccolo_ObjRange*)containerObj);
+            } else if(containerObj && containerObj->type == PICCOLO_OBJ_STRING) {
+                end = ((struct piccolo_ObjString*)containerObj)->len;
+            } else if(containerObj && containerObj->type == PICCOLO_OBJ_HASHMAP) {
+                end = ((struct piccolo_ObjHashmap*)containerObj)->hashmap.capacity;
+            } else {
+                ip = opStart + 3;
+                PUSH(container);
+                DISPATCH();
+            }
+            if(idx < end)
+                ip = opStart + 10;
+            else
+                ip = opStart + 7 + PARAM_AT(8);
+            DISPATCH();
+        }
+        OPCODE(REG_MOVE): {
+            int dst = READ_PARAM();
+            uint16_t srcReg = READ_PARAM();
+            piccolo_Value val = REG(srcReg);
+            locals[dst] = val;
+            DISPATCH();
+        }
+        REG_ARITH_OP(REG_ADD, +, addValues)
+        REG_ARITH_OP(REG_SUB, -, subValues)
+        REG_ARITH_OP(REG_MUL, *, mulValues)
+        REG_ARITH_OP(REG_DIV, /, divValues)
+        OPCODE(REG_MOD): {
+            int dst = READ_PARAM();
+            uint16_t aReg = READ_PARAM();
+            uint16_t bReg = READ_PARAM();
+            piccolo_Value a = REG(aReg);
+            piccolo_Value b = REG(bReg);
+            STORE_FRAME();
+            piccolo_Value result = modValues(engine, a, b);
+            CHECK_ERROR();
+            locals[dst] = result;
+            DISPATCH();
         }
-        if(engine->hadError) {
-            return false;
+        REG_COMPARE_JUMP_FALSE_OP(REG_LESS_JUMP_FALSE, x < y)
+        REG_COMPARE_JUMP_FALSE_OP(REG_LESS_EQ_JUMP_FALSE, !(x > y))
+        REG_COMPARE_JUMP_FALSE_OP(REG_GREATER_JUMP_FALSE, x > y)
+        REG_COMPARE_JUMP_FALSE_OP(REG_GREATER_EQ_JUMP_FALSE, !(x < y))
+        OPCODE(REG_EQUAL_JUMP_FALSE): {
+            uint16_t aReg = READ_PARAM();
+            uint16_t bReg = READ_PARAM();
+            piccolo_Value a = REG(aReg);
+            piccolo_Value b = REG(bReg);
+            int jumpDist = READ_PARAM();
+            if(!piccolo_valuesEqual(a, b))
+                ip = opStart + jumpDist;
+            DISPATCH();
+        }
+        OPCODE(REG_NOT_EQUAL_JUMP_FALSE): {
+            uint16_t aReg = READ_PARAM();
+            uint16_t bReg = READ_PARAM();
+            piccolo_Value a = REG(aReg);
+            piccolo_Value b = REG(bReg);
+            int jumpDist = READ_PARAM();
+            if(piccolo_valuesEqual(a, b))
+                ip = opStart + jumpDist;
+            DISPATCH();
+        }
+#ifdef PICCOLO_COMPUTED_GOTO
+        op_UNKNOWN:
+#else
+        default:
+#endif
+        {
+            RUNTIME_ERROR("Unknown opcode.");
         }
     }
-#undef READ_BYTE
 
     return false;
+
+#undef READ_BYTE
+#undef READ_PARAM
+#undef PARAM_AT
+#undef PUSH
+#undef POP
+#undef PEEK
+#undef STORE_FRAME
+#undef LOAD_FRAME
+#undef RUNTIME_ERROR
+#undef CHECK_ERROR
+#undef FINISH_NATIVE_CALL
+#undef RELOAD_AFTER_ITER_HOOK
+#undef SAFEPOINT
+#undef TRACE_INSTRUCTION
+#undef QUICKEN
+#undef NUM_NUM_OP
+#undef BITWISE_OP
+#undef COUNT_HOTNESS
+#undef ENTER_JIT
+#undef COMPARE_JUMP_FALSE_OP
+#undef REG
+#undef REG_ARITH_OP
+#undef REG_COMPARE_JUMP_FALSE_OP
+#undef INTERPRET_LOOP
+#undef OPCODE
+#undef DISPATCH
+}
+
+static enum piccolo_RunStatus runFor(struct piccolo_Engine* engine, int64_t steps, int64_t usecs) {
+    setBudget(engine, steps, usecs);
+    engine->suspended = false;
+    if(!run(engine, engine->budgetBase))
+        return PICCOLO_RUN_ERROR;
+    return engine->suspended ? PICCOLO_RUN_SUSPENDED : PICCOLO_RUN_FINISHED;
+}
+
+static enum piccolo_RunStatus executeBytecodeFor(struct piccolo_Engine* engine, struct piccolo_Bytecode* bytecode, int64_t steps, int64_t usecs) {
+    CURR_FRAME.ip = 0;
+    CURR_FRAME.bytecode = bytecode;
+    engine->stackTop = engine->stack;
+    if(!piccolo_ensureStack(engine, bytecode->maxStack)) {
+        piccolo_enginePrintError(engine, "Stack overflow.\n");
+        return PICCOLO_RUN_ERROR;
+    }
+    engine->budgetBase = engine->callFrames.count - 1;
+    return runFor(engine, steps, usecs);
+}
+
+bool piccolo_executeBytecode(struct piccolo_Engine* engine, struct piccolo_Bytecode* bytecode) {
+    return executeBytecodeFor(engine, bytecode, 0, 0) == PICCOLO_RUN_FINISHED;
 }
 
 bool piccolo_executePackage(struct piccolo_Engine* engine, struct piccolo_Package* package) {
+    return piccolo_executePackageFor(engine, package, 0, 0) == PICCOLO_RUN_FINISHED;
+}
+
+enum piccolo_RunStatus piccolo_executePackageFor(struct piccolo_Engine* engine, struct piccolo_Package* package, int64_t steps, int64_t usecs) {
     pushFrame(engine);
     CURR_FRAME.closure = NULL;
     CURR_FRAME.package = package;
     CURR_FRAME.localStart = 0;
     package->executed = true;
-    bool result = piccolo_executeBytecode(engine, &package->bytecode);
-    return result;
+    return executeBytecodeFor(engine, &package->bytecode, steps, usecs);
 }
 
-bool piccolo_executeBytecode(struct piccolo_Engine* engine, struct piccolo_Bytecode* bytecode) {
-    CURR_FRAME.ip = 0;
-    CURR_FRAME.bytecode = bytecode;
-    engine->stackTop = engine->stack;
-    return run(engine);
+enum piccolo_RunStatus piccolo_resume(struct piccolo_Engine* engine, int64_t steps, int64_t usecs) {
+    if(!engine->suspended) {
+        piccolo_enginePrintError(engine, "Nothing to resume.\n");
+        return PICCOLO_RUN_ERROR;
+    }
+    return runFor(engine, steps, usecs);
 }
 
 piccolo_Value piccolo_callFunction(struct piccolo_Engine* engine, struct piccolo_ObjClosure* closure, int argc, piccolo_Value* argv) {
-    pushFrame(engine);
-    CURR_FRAME.localStart = 0;
-    for(int i = 0; i < argc; i++) {
-        piccolo_writeValueArray(engine, &engine->locals, argv[i]);
+    int frameCount = engine->callFrames.count;
+    int stackBase = (int)(engine->stackTop - engine->stack);
+    // argv may point into the stack itself, for example when a native passes on its own arguments
+    bool argvOnStack = argv >= engine->stack && argv < engine->stackEnd;
+    int argvIdx = (int)(argv - engine->stack);
+    if(!piccolo_ensureStack(engine, 1 + argc + closure->prototype->bytecode.maxStack)) {
+        piccolo_runtimeError(engine, "Stack overflow.");
+        return PICCOLO_NIL_VAL();
     }
+    if(argvOnStack)
+        argv = engine->stack + argvIdx;
+    piccolo_enginePushStack(engine, PICCOLO_OBJ_VAL(closure));
+    for(int i = 0; i < argc; i++)
+        piccolo_enginePushStack(engine, argv[i]);
+    pushFrame(engine);
+    CURR_FRAME.localStart = stackBase + 1;
     CURR_FRAME.closure = closure;
     CURR_FRAME.package = closure->package;
-    piccolo_executeBytecode(engine, &closure->prototype->bytecode);
+    CURR_FRAME.ip = 0;
+    CURR_FRAME.bytecode = &closure->prototype->bytecode;
+    if(!run(engine, frameCount)) {
+        engine->callFrames.count = frameCount;
+        closeUpvals(engine, stackBase);
+        engine->stackTop = engine->stack + stackBase;
+        return PICCOLO_NIL_VAL();
+    }
     return piccolo_enginePopStack(engine);
 }
 
+static void saveState(struct piccolo_Engine* engine, struct piccolo_ExecState* state) {
+    state->stack = engine->stack;
+    state->stackTop = engine->stackTop;
+    state->stackEnd = engine->stackEnd;
+    state->callFrames = engine->callFrames;
+    state->openUpvals = engine->openUpvals;
+}
+
+static void loadState(struct piccolo_Engine* engine, struct piccolo_ExecState* state) {
+    engine->stack = state->stack;
+    engine->stackTop = state->stackTop;
+    engine->stackEnd = state->stackEnd;
+    engine->callFrames = state->callFrames;
+    engine->openUpvals = state->openUpvals;
+}
+
+/*
+    The coroutine's stack and frames replace the engine's while it runs, so it can yield from any
+    depth of calls by returning from run(). Its frames stay where they are for the next resume.
+ */
+piccolo_Value piccolo_resumeCoroutine(struct piccolo_Engine* engine, struct piccolo_ObjCoroutine* coroutine, piccolo_Value value) {
+    if(coroutine->state == PICCOLO_COROUTINE_DONE) {
+        piccolo_runtimeError(engine, "Cannot resume a finished coroutine.");
+        return PICCOLO_NIL_VAL();
+    }
+    if(coroutine->state != PICCOLO_COROUTINE_SUSPENDED) {
+        piccolo_runtimeError(engine, "Cannot resume a running coroutine.");
+        return PICCOLO_NIL_VAL();
+    }
+
+    struct piccolo_ObjCoroutine* resumer = engine->coroutine;
+    if(resumer == NULL) {
+        saveState(engine, &engine->mainState);
+    } else {
+        saveState(engine, &resumer->saved);
+        resumer->state = PICCOLO_COROUTINE_WAITING;
+    }
+    loadState(engine, &coroutine->saved);
+    engine->coroutine = coroutine;
+    coroutine->state = PICCOLO_COROUTINE_RUNNING;
+
+    bool ok = true;
+    if(engine->callFrames.count == 0) {
+        // A new coroutine's stack has room for the closure and its parameter
+        struct piccolo_ObjClosure* closure = coroutine->closure;
+        int argc = closure->prototype->arity;
+        piccolo_enginePushStack(engine, PICCOLO_OBJ_VAL(closure));
+        if(argc == 1)
+            piccolo_enginePushStack(engine, value);
+        pushFrame(engine);
+        CURR_FRAME.localStart = 1;
+        CURR_FRAME.closure = closure;
+        CURR_FRAME.package = closure->package;
+        CURR_FRAME.ip = CURR_FRAME.prevIp = 0;
+        CURR_FRAME.bytecode = &closure->prototype->bytecode;
+        if(!piccolo_ensureStack(engine, closure->prototype->bytecode.maxStack - argc)) {
+            piccolo_runtimeError(engine, "Stack overflow.");
+            ok = false;
+        }
+    } else {
+        // Replaces the result of the call that yielded
+        piccolo_enginePushStack(engine, value);
+    }
+
+    piccolo_Value result = PICCOLO_NIL_VAL();
+    engine->yielding = false;
+    if(ok && run(engine, 0)) {
+        result = piccolo_enginePopStack(engine);
+        coroutine->state = engine->yielding ? PICCOLO_COROUTINE_SUSPENDED : PICCOLO_COROUTINE_DONE;
+        engine->yielding = false;
+    } else {
+        coroutine->state = PICCOLO_COROUTINE_DONE;
+        closeUpvals(engine, 0);
+        engine->callFrames.count = 0;
+        engine->stackTop = engine->stack;
+    }
+
+    saveState(engine, &coroutine->saved);
+    if(resumer == NULL) {
+        loadState(engine, &engine->mainState);
+    } else {
+        loadState(engine, &resumer->saved);
+        resumer->state = PICCOLO_COROUTINE_RUNNING;
+    }
+    engine->coroutine = resumer;
+    return result;
+}
+
+void piccolo_yieldCoroutine(struct piccolo_Engine* engine) {
+    if(engine->coroutine == NULL) {
+        piccolo_runtimeError(engine, "Cannot yield outside of a coroutine.");
+        return;
+    }
+    engine->yielding = true;
+}
+
+bool piccolo_ensureStack(struct piccolo_Engine* engine, int count) {
+    int used = (int)(engine->stackTop - engine->stack);
+    int capacity = (int)(engine->stackEnd - engine->stack);
+    if(used + count <= capacity)
+        return true;
+    int newCapacity = capacity;
+    while(newCapacity < used + count)
+        newCapacity *= 2;
+    if(newCapacity > PICCOLO_MAX_STACK)
+        return false;
+    engine->stack = PICCOLO_REALLOCATE("stack", engine, engine->stack, sizeof(piccolo_Value) * capacity, sizeof(piccolo_Value) * newCapacity);
+    engine->stackTop = engine->stack + used;
+    engine->stackEnd = engine->stack + newCapacity;
+    return true;
+}
+
 void piccolo_enginePrintError(struct piccolo_Engine* engine, const char* format, ...) {
     va_list args;
     va_start(args, format);
@@ -941,6 +2191,10 @@ void piccolo_enginePrintError(struct piccolo_Engine* engine, const char* format,
 }
 
 void piccolo_enginePushStack(struct piccolo_Engine* engine, piccolo_Value value) {
+    if(!piccolo_ensureStack(engine, 1)) {
+        piccolo_runtimeError(engine, "Stack overflow.");
+        return;
+    }
     *engine->stackTop = value;
     engine->stackTop++;
 }
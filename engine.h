@@ -7,32 +7,120 @@
 #include "typecheck.h"
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 
-struct piccolo_CallFrame {
-    int localStart;
-    int prevIp;
-    int ip;
-    struct piccolo_Bytecode* bytecode;
-    struct piccolo_ObjClosure* closure;
-    struct piccolo_Package* package;
+enum piccolo_RunStatus {
+    PICCOLO_RUN_FINISHED,
+    PICCOLO_RUN_SUSPENDED,
+    PICCOLO_RUN_ERROR,
+};
+
+/*
+    Phases of a major collection, which may be spread over several calls of piccolo_collectGarbage.
+    Minor collections only run while it is IDLE.
+ */
+enum piccolo_GcState {
+    PICCOLO_GC_IDLE,
+    PICCOLO_GC_MARKING,
+    PICCOLO_GC_SWEEPING,
+};
+
+/*
+    Major collections that run at once can mark with several threads, see gcThreads. That needs
+    POSIX threads and GCC atomics, and can be turned off with PICCOLO_DISABLE_PARALLEL_GC.
+ */
+#if !defined(PICCOLO_DISABLE_PARALLEL_GC) && (defined(__GNUC__) || defined(__clang__)) && !defined(_WIN32)
+#define PICCOLO_PARALLEL_GC
+#endif
+
+struct piccolo_GcMarker;
+
+// Objects of up to PICCOLO_SLAB_MAX_SIZE bytes are allocated from pages of same sized slots, see gc.c
+#define PICCOLO_SLAB_CLASSES 4
+#define PICCOLO_SLAB_MAX_SIZE (PICCOLO_SLAB_CLASSES * 16)
+
+struct piccolo_SlabPage;
+struct piccolo_SlabSlot;
+
+struct piccolo_SlabClass {
+    struct piccolo_SlabPage* pages;
+    // Free slots of the pages in pages
+    struct piccolo_SlabSlot* free;
+    // Pages a major collection still has to sweep
+    struct piccolo_SlabPage* sweepPages;
+};
+
+enum piccolo_Backend {
+    PICCOLO_BACKEND_STACK,
+    PICCOLO_BACKEND_REGISTER,
 };
 
 PICCOLO_DYNARRAY_HEADER(struct piccolo_Package*, Package)
 PICCOLO_DYNARRAY_HEADER(const char*, String)
-PICCOLO_DYNARRAY_HEADER(struct piccolo_CallFrame, CallFrame)
+PICCOLO_DYNARRAY_HEADER(struct piccolo_Obj*, ObjRef)
 
 struct piccolo_Engine {
     struct piccolo_PackageArray packages;
 
-    struct piccolo_ValueArray locals;
-    piccolo_Value stack[256];
+    /*
+        One value stack shared by all frames. A frame's locals start with the arguments its
+        caller pushed and are followed by its temporaries.
+     */
+    piccolo_Value* stack;
     piccolo_Value* stackTop;
+    piccolo_Value* stackEnd;
     struct piccolo_CallFrameArray callFrames;
     bool hadError;
 
     size_t liveMemory;
+    // A collection is a major one once oldMemory, liveMemory after the last collection, passes gcThreshold
     size_t gcThreshold;
-    struct piccolo_Obj* objs;
+    size_t oldMemory;
+    // Bytes allocated since the last collection, a collection is due once they pass nurserySize
+    size_t youngMemory;
+    size_t nurserySize;
+    // Set once a collection is due, the interpreter collects at its next safepoint
+    bool gcPending;
+    struct piccolo_SlabClass slabs[PICCOLO_SLAB_CLASSES];
+    // Objects too large for a slab that survived a collection
+    struct piccolo_ObjRefArray largeObjs;
+    // Slab objects allocated since the last collection
+    struct piccolo_ObjRefArray youngObjs;
+    // Objects too large for a slab allocated since the last collection, they move to largeObjs once they survive one
+    struct piccolo_ObjRefArray youngLarge;
+    // Old objects that may point to young ones, see gc.c
+    struct piccolo_ObjRefArray remembered;
+    // Marked objects whose references haven't been marked yet
+    struct piccolo_ObjRefArray gray;
+    enum piccolo_GcState gcState;
+    // Mark of the objects marked by the last or running collection, 1 or 2
+    uint8_t gcEpoch;
+    // Longest a step of a major collection may take, 0 runs the whole collection at once
+    int64_t gcPauseUsecs;
+    /*
+        Threads that mark when a major collection marks all at once, including the one that
+        collects. The other threads are started by the first such collection. Native struct
+        gcMark hooks may run on any of them.
+     */
+    int gcThreads;
+    struct piccolo_GcMarker* gcMarker;
+    // Large objects a major collection sweeps, from sweepLargeIdx on, after the slabs from sweepClass on
+    struct piccolo_ObjRefArray sweepLarge;
+    int sweepLargeIdx;
+    int sweepClass;
+
+    /*
+        Limits of piccolo_executePackageFor and piccolo_resume. budget counts down at every
+        safepoint, only when it runs out are the step and time limits checked.
+     */
+    int64_t budget;
+    int64_t budgetSlice;
+    int64_t budgetSteps;
+    // piccolo_monotonicUsecs reading the time limit ends at, -1 without one
+    int64_t budgetDeadline;
+    // Frame count the limited execution returns to, it can only be suspended in that run
+    int budgetBase;
+    bool suspended;
 
     void (*printError)(const char* format, va_list);
 
@@ -40,8 +128,17 @@ struct piccolo_Engine {
 
     struct piccolo_ObjUpval* openUpvals;
 
+    // The running coroutine, or NULL while the main stack is in use
+    struct piccolo_ObjCoroutine* coroutine;
+    struct piccolo_ExecState mainState;
+    // Set by piccolo_yieldCoroutine, the native that calls it yields its result
+    bool yielding;
+
     struct piccolo_StringArray searchPaths;
     struct piccolo_Type* types;
+
+    // Instruction set used when compiling packages, embedders may switch to PICCOLO_BACKEND_REGISTER before loading them
+    enum piccolo_Backend backend;
 #ifdef PICCOLO_ENABLE_MEMORY_TRACKER
     struct piccolo_MemoryTrack* track;
 #endif
@@ -52,10 +149,39 @@ void piccolo_freeEngine(struct piccolo_Engine* engine);
 
 bool piccolo_executePackage(struct piccolo_Engine* engine, struct piccolo_Package* package);
 bool piccolo_executeBytecode(struct piccolo_Engine* engine, struct piccolo_Bytecode* bytecode);
+
+/*
+    Executes a package for at most steps steps or usecs microseconds of processor time, 0 means no
+    limit. Steps are calls and backward jumps, which are also the only points where execution is
+    suspended, so the code between two of them always finishes. A suspended package keeps its
+    frames and stack and continues with piccolo_resume, which takes a new set of limits. Until it
+    has finished, piccolo_callFunction is the only other way to run code on the engine.
+ */
+enum piccolo_RunStatus piccolo_executePackageFor(struct piccolo_Engine* engine, struct piccolo_Package* package, int64_t steps, int64_t usecs);
+enum piccolo_RunStatus piccolo_resume(struct piccolo_Engine* engine, int64_t steps, int64_t usecs);
 piccolo_Value piccolo_callFunction(struct piccolo_Engine* engine, struct piccolo_ObjClosure* closure, int argc, piccolo_Value* argv);
 
+/*
+    Runs a coroutine until it yields or returns, and returns the value it yielded or returned. On
+    the first resume the value is passed to the coroutine's function if it takes a parameter,
+    afterwards it becomes the result of the call that yielded.
+ */
+piccolo_Value piccolo_resumeCoroutine(struct piccolo_Engine* engine, struct piccolo_ObjCoroutine* coroutine, piccolo_Value value);
+// Called by a native, makes the running coroutine yield the native's result once it returns
+void piccolo_yieldCoroutine(struct piccolo_Engine* engine);
+
+/*
+    Iteration over anything a for loop accepts, for natives that consume other values lazily. The
+    iterator from piccolo_iterFirst or piccolo_iterNext is only valid while piccolo_iterCont is true.
+ */
+piccolo_Value piccolo_iterFirst(struct piccolo_Engine* engine, piccolo_Value container);
+bool piccolo_iterCont(struct piccolo_Engine* engine, piccolo_Value container, piccolo_Value iterator);
+piccolo_Value piccolo_iterNext(struct piccolo_Engine* engine, piccolo_Value container, piccolo_Value iterator);
+piccolo_Value piccolo_iterGet(struct piccolo_Engine* engine, piccolo_Value container, piccolo_Value iterator);
+
 void piccolo_enginePrintError(struct piccolo_Engine* engine, const char* format, ...);
 
+bool piccolo_ensureStack(struct piccolo_Engine* engine, int count);
 void piccolo_enginePushStack(struct piccolo_Engine* engine, piccolo_Value value);
 piccolo_Value piccolo_enginePopStack(struct piccolo_Engine* engine);
 piccolo_Value piccolo_enginePeekStack(struct piccolo_Engine* engine, int dist);
@@ -1,26 +1,170 @@
 
 #include "gc.h"
+#include "util/clock.h"
 #include <stdio.h>
+#include <string.h>
 
-static void markObj(struct piccolo_Obj* obj) {
+#ifdef PICCOLO_PARALLEL_GC
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#endif
+
+/*
+    The collector is generational without moving objects. Every object starts out young, in
+    engine->youngObjs or engine->youngLarge, and is old once it survives a collection. Survivors
+    keep their mark until the next major collection, so a minor collection stops at them and only
+    has to sweep the young objects, which it frees one at a time from those arrays rather than by
+    page. A marked object a young one was stored in since is kept in the remembered set by
+    piccolo_gcWriteBarrier, and the minor collection scans it like a root.
+
+    An object is marked when its mark is the engine's gcEpoch. New objects get mark 0, which is
+    never an epoch. Once the memory surviving collections passes gcThreshold the next collection
+    is a major one. It moves to the other epoch, which unmarks every object without touching it,
+    marks everything reachable and sweeps both generations, walking the slab pages in order,
+    which only major collections do. With a pause budget it is split into steps that each take
+    at most gcPauseUsecs and run whenever a collection is due, see piccolo_GcState. While it
+    marks, the write barrier keeps marked objects from pointing to unmarked ones by marking the
+    stored value instead.
+ */
+
+// Objects between checks of the pause budget's deadline
+#define GC_BATCH 256
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH(ptr) __builtin_prefetch(ptr)
+#else
+#define PREFETCH(ptr)
+#endif
+
+// How many elements ahead tracing an array prefetches the objects it will mark
+#define PREFETCH_DISTANCE 8
+
+/*
+    Objects of up to PICCOLO_SLAB_MAX_SIZE bytes live in pages of slots of one of the 16 byte
+    size classes. A free slot has the mark PICCOLO_MARK_FREE and is linked into the free list of
+    its class. A major collection takes the pages of a class away while it sweeps them, and
+    gives each page back with its free slots unless all of them are free. A minor collection
+    pushes the slots of the young objects it frees back one by one, and piccolo_gcAllocSlab
+    clears every slot it hands out.
+ */
+#define PICCOLO_SLAB_PAGE_SIZE (16 * 1024)
+#define PICCOLO_MARK_FREE 0xFF
+
+struct piccolo_SlabPage {
+    struct piccolo_SlabPage* next;
+    int slotSize;
+    int slotCount;
+};
+
+struct piccolo_SlabSlot {
+    struct piccolo_Obj obj;
+    struct piccolo_SlabSlot* nextFree;
+};
+
+// Slots start at the first multiple of 16 after the page header
+#define SLOTS_OFFSET ((sizeof(struct piccolo_SlabPage) + 15) & ~(size_t)15)
+#define PAGE_SLOT(page, idx) ((struct piccolo_SlabSlot*)((uint8_t*)(page) + SLOTS_OFFSET + (size_t)(idx) * (page)->slotSize))
+
+static int slabClass(size_t size) {
+    return size == 0 ? 0 : (int)((size - 1) / 16);
+}
+
+static void newSlabPage(struct piccolo_Engine* engine, struct piccolo_SlabClass* slab, int slotSize) {
+    struct piccolo_SlabPage* page = PICCOLO_REALLOCATE("slab page", engine, NULL, 0, PICCOLO_SLAB_PAGE_SIZE);
+    page->slotSize = slotSize;
+    page->slotCount = (int)((PICCOLO_SLAB_PAGE_SIZE - SLOTS_OFFSET) / slotSize);
+    page->next = slab->pages;
+    slab->pages = page;
+    // Linked backwards so slots are handed out in address order
+    for(int i = page->slotCount - 1; i >= 0; i--) {
+        struct piccolo_SlabSlot* slot = PAGE_SLOT(page, i);
+        slot->obj.mark = PICCOLO_MARK_FREE;
+        slot->nextFree = slab->free;
+        slab->free = slot;
+    }
+}
+
+struct piccolo_Obj* piccolo_gcAllocSlab(struct piccolo_Engine* engine, size_t size) {
+    int class = slabClass(size);
+    struct piccolo_SlabClass* slab = &engine->slabs[class];
+    if(slab->free == NULL)
+        newSlabPage(engine, slab, (class + 1) * 16);
+    struct piccolo_SlabSlot* slot = slab->free;
+    slab->free = slot->nextFree;
+    memset(slot, 0, size);
+    engine->youngMemory += size;
+    if(engine->youngMemory > engine->nurserySize)
+        engine->gcPending = true;
+    return &slot->obj;
+}
+
+void piccolo_gcFreeSlab(struct piccolo_Engine* engine, struct piccolo_Obj* obj, size_t size) {
+    struct piccolo_SlabClass* slab = &engine->slabs[slabClass(size)];
+    struct piccolo_SlabSlot* slot = (struct piccolo_SlabSlot*)obj;
+    slot->obj.mark = PICCOLO_MARK_FREE;
+    slot->nextFree = slab->free;
+    slab->free = slot;
+}
+
+// The engine collecting on this thread, for the gcMark functions of native structs
+static _Thread_local struct piccolo_Engine* gcEngine;
+
+#ifdef PICCOLO_PARALLEL_GC
+struct piccolo_GcWorker;
+// Set while the thread takes part in a parallel mark, its gray objects go to the worker's queue
+static _Thread_local struct piccolo_GcWorker* gcWorker;
+static void pushWork(struct piccolo_GcWorker* worker, struct piccolo_Obj* obj);
+#endif
+
+static void markObj(struct piccolo_Engine* engine, struct piccolo_Obj* obj) {
     if(obj == NULL)
         return;
-    if(obj->marked)
+#ifdef PICCOLO_PARALLEL_GC
+    if(gcWorker != NULL) {
+        // Other threads may mark the same object, only the one that changes the mark traces it
+        uint8_t epoch = engine->gcEpoch;
+        if(__atomic_load_n(&obj->mark, __ATOMIC_RELAXED) != epoch && __atomic_exchange_n(&obj->mark, epoch, __ATOMIC_RELAXED) != epoch)
+            pushWork(gcWorker, obj);
         return;
-    obj->marked = true;
+    }
+#endif
+    if(obj->mark == engine->gcEpoch)
+        return;
+    obj->mark = engine->gcEpoch;
+    piccolo_writeObjRefArray(engine, &engine->gray, obj);
+}
+
+static void markValue(struct piccolo_Engine* engine, piccolo_Value value) {
+    if(PICCOLO_IS_OBJ(value))
+        markObj(engine, PICCOLO_AS_OBJ(value));
+}
+
+static void markStack(struct piccolo_Engine* engine, piccolo_Value* stack, piccolo_Value* stackTop, struct piccolo_CallFrameArray* callFrames) {
+    for(piccolo_Value* iter = stack; iter != stackTop; iter++)
+        markValue(engine, *iter);
+    for(int i = 0; i < callFrames->count; i++)
+        markObj(engine, (struct piccolo_Obj*)callFrames->values[i].closure);
+}
+
+// Marks the objects obj points to
+static void traceObj(struct piccolo_Engine* engine, struct piccolo_Obj* obj) {
     switch(obj->type) {
         case PICCOLO_OBJ_ARRAY: {
             struct piccolo_ObjArray* array = (struct piccolo_ObjArray*)obj;
-            for(int i = 0; i < array->array.count; i++)
-                piccolo_gcMarkValue(array->array.values[i]);
+            for(int i = 0; i < array->array.count; i++) {
+                if(i + PREFETCH_DISTANCE < array->array.count && PICCOLO_IS_OBJ(array->array.values[i + PREFETCH_DISTANCE]))
+                    PREFETCH(PICCOLO_AS_OBJ(array->array.values[i + PREFETCH_DISTANCE]));
+                markValue(engine, array->array.values[i]);
+            }
             break;
         }
         case PICCOLO_OBJ_HASHMAP: {
             struct piccolo_ObjHashmap* hashmap = (struct piccolo_ObjHashmap*)obj;
             for(int i = 0; i < hashmap->hashmap.capacity; i++) {
                 if(!piccolo_HashmapIsBaseKey(hashmap->hashmap.entries[i].key)) {
-                    piccolo_gcMarkValue(hashmap->hashmap.entries[i].key);
-                    piccolo_gcMarkValue(hashmap->hashmap.entries[i].val.value);
+                    markValue(engine, hashmap->hashmap.entries[i].key);
+                    markValue(engine, hashmap->hashmap.entries[i].val.value);
                 }
             }
             break;
@@ -28,23 +172,33 @@ static void markObj(struct piccolo_Obj* obj) {
         case PICCOLO_OBJ_FUNC: {
             struct piccolo_ObjFunction* func = (struct piccolo_ObjFunction*)obj;
             for(int i = 0; i < func->bytecode.constants.count; i++)
-                piccolo_gcMarkValue(func->bytecode.constants.values[i]);
+                markValue(engine, func->bytecode.constants.values[i]);
             break;
         }
         case PICCOLO_OBJ_UPVAL: {
             struct piccolo_ObjUpval* upval = (struct piccolo_ObjUpval*)obj;
             if(!upval->open)
-                piccolo_gcMarkValue(*upval->val.ptr);
+                markValue(engine, *upval->val.ptr);
+            else
+                markObj(engine, (struct piccolo_Obj*) upval->owner);
             break;
         }
         case PICCOLO_OBJ_CLOSURE: {
             struct piccolo_ObjClosure* closure = (struct piccolo_ObjClosure*)obj;
-            markObj((struct piccolo_Obj*) closure->prototype);
+            markObj(engine, (struct piccolo_Obj*) closure->prototype);
             for(int i = 0; i < closure->upvalCnt; i++) {
-                markObj((struct piccolo_Obj*) closure->upvals[i]);
+                markObj(engine, (struct piccolo_Obj*) closure->upvals[i]);
             }
             break;
         }
+        case PICCOLO_OBJ_COROUTINE: {
+            struct piccolo_ObjCoroutine* coroutine = (struct piccolo_ObjCoroutine*)obj;
+            markObj(engine, (struct piccolo_Obj*) coroutine->closure);
+            // The stack of the running coroutine is the engine's
+            if(coroutine->state != PICCOLO_COROUTINE_RUNNING)
+                markStack(engine, coroutine->saved.stack, coroutine->saved.stackTop, &coroutine->saved.callFrames);
+            break;
+        }
         case PICCOLO_OBJ_NATIVE_STRUCT: {
             struct piccolo_ObjNativeStruct* nativeStruct = (struct piccolo_ObjNativeStruct*)obj;
             if(nativeStruct->gcMark != NULL)
@@ -52,64 +206,618 @@ static void markObj(struct piccolo_Obj* obj) {
             break;
         }
         case PICCOLO_OBJ_STRING: break;
+        case PICCOLO_OBJ_RANGE: break;
         case PICCOLO_OBJ_NATIVE_FN: break;
         case PICCOLO_OBJ_PACKAGE: break;
+#ifdef PICCOLO_ENABLE_NAN_BOXING
+        case PICCOLO_OBJ_INT: break;
+#endif
     }
 }
 
 void piccolo_gcMarkValue(piccolo_Value value) {
-    if(PICCOLO_IS_OBJ(value)) {
-        markObj(PICCOLO_AS_OBJ(value));
-    }
+    markValue(gcEngine, value);
 }
 
-static void markPackage(struct piccolo_Package* package) {
-    package->obj.marked = true;
+static void markPackage(struct piccolo_Engine* engine, struct piccolo_Package* package) {
+    package->obj.mark = engine->gcEpoch;
     for(int i = 0; i < package->bytecode.constants.count; i++)
-        piccolo_gcMarkValue(package->bytecode.constants.values[i]);
+        markValue(engine, package->bytecode.constants.values[i]);
     for(int i = 0; i < package->globals.count; i++)
-        piccolo_gcMarkValue(package->globals.values[i]);
+        markValue(engine, package->globals.values[i]);
     for(int i = 0; i < package->globalIdxs.capacity; i++)
         if(package->globalIdxs.entries[i].key != NULL)
-            package->globalIdxs.entries[i].key->obj.marked = true;
+            package->globalIdxs.entries[i].key->obj.mark = engine->gcEpoch;
 }
 
 static void markRoots(struct piccolo_Engine* engine) {
-    for(piccolo_Value* iter = engine->stack; iter != engine->stackTop; iter++)
-        piccolo_gcMarkValue(*iter);
-    for(int i = 0; i < engine->callFrames.count; i++) {
-        if(engine->callFrames.values[i].closure != NULL)
-            markObj((struct piccolo_Obj*)engine->callFrames.values[i].closure);
-    }
-    for(int i = 0; i < engine->locals.count; i++)
-        piccolo_gcMarkValue(engine->locals.values[i]);
+    markStack(engine, engine->stack, engine->stackTop, &engine->callFrames);
+    if(engine->coroutine != NULL) {
+        markObj(engine, (struct piccolo_Obj*)engine->coroutine);
+        markStack(engine, engine->mainState.stack, engine->mainState.stackTop, &engine->mainState.callFrames);
+    }
     for(int i = 0; i < engine->packages.count; i++)
-        markPackage(engine->packages.values[i]);
+        markPackage(engine, engine->packages.values[i]);
 }
 
-void piccolo_collectGarbage(struct piccolo_Engine* engine) {
+// Objects whose contents change without a write barrier, they stay in the remembered set while alive
+static bool alwaysRemembered(struct piccolo_Obj* obj) {
+    return obj->type == PICCOLO_OBJ_COROUTINE || obj->type == PICCOLO_OBJ_NATIVE_STRUCT;
+}
+
+void piccolo_gcRemember(struct piccolo_Engine* engine, struct piccolo_Obj* obj) {
+    obj->remembered = true;
+    piccolo_writeObjRefArray(engine, &engine->remembered, obj);
+}
+
+void piccolo_gcBarrierSlow(struct piccolo_Engine* engine, struct piccolo_Obj* obj, struct piccolo_Obj* value) {
+    if(engine->gcState == PICCOLO_GC_MARKING) {
+        markObj(engine, value);
+    } else if(!obj->remembered) {
+        piccolo_gcRemember(engine, obj);
+    }
+}
+
+// Traces the remembered objects that are marked, the others are young and may be dead
+static void traceRemembered(struct piccolo_Engine* engine) {
+    for(int i = 0; i < engine->remembered.count; i++)
+        if(engine->remembered.values[i]->mark == engine->gcEpoch)
+            traceObj(engine, engine->remembered.values[i]);
+}
+
+// Drops the remembered objects that don't stay remembered, and the ones that are dead
+static void filterRemembered(struct piccolo_Engine* engine) {
+    int count = 0;
+    for(int i = 0; i < engine->remembered.count; i++) {
+        struct piccolo_Obj* obj = engine->remembered.values[i];
+        if(alwaysRemembered(obj) && obj->mark == engine->gcEpoch)
+            engine->remembered.values[count++] = obj;
+        else
+            obj->remembered = false;
+    }
+    engine->remembered.count = count;
+}
+
+// Traces gray objects until there are none left, or the deadline passes
+static bool drainGray(struct piccolo_Engine* engine, int64_t deadline) {
+    while(engine->gray.count > 0) {
+        for(int i = 0; i < GC_BATCH && engine->gray.count > 0; i++) {
+            struct piccolo_Obj* obj = piccolo_popObjRefArray(&engine->gray);
+            // The next object is traced right after this one
+            if(engine->gray.count > 0)
+                PREFETCH(engine->gray.values[engine->gray.count - 1]);
+            traceObj(engine, obj);
+        }
+        if(deadline != -1 && piccolo_monotonicUsecs() >= deadline)
+            return engine->gray.count == 0;
+    }
+    return true;
+}
+
+#ifdef PICCOLO_PARALLEL_GC
+/*
+    Parallel marking gives every thread a queue of gray objects. A thread traces the objects at
+    the top of its own queue and, once that is empty, steals half of the bottom of another one.
+    It counts as active while it has work, and everyone is done when no thread is active, since
+    only active threads add to the queues. The queues are allocated outside the engine's memory
+    accounting, which isn't safe to update from several threads, and added to it once marking is
+    done. A queue that can't grow drops the object, the collecting thread then traces every marked
+    object again on its own to find what was missed.
+ */
+struct piccolo_GcWorker {
+    int lock;
+    // Objects from head up to tail are gray
+    struct piccolo_Obj** values;
+    int head;
+    int tail;
+    int capacity;
+    // Set when an object was marked but couldn't be queued
+    bool overflow;
+};
+
+struct piccolo_GcMarker {
+    struct piccolo_Engine* engine;
+    // The engine's gcThreads when the threads were started, threadCount is less if some failed to start
+    int requested;
+    int threadCount;
+    // threadCount - 1 threads, the collecting thread is the first worker
+    pthread_t* threads;
+    struct piccolo_GcWorker* workers;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    // Counts parallel marks, a new one starts the threads
+    uint64_t generation;
+    int finished;
+    bool quit;
+    int active;
+    // Bytes of the marker added to the engine's liveMemory
+    size_t accounted;
+};
+
+static void lockWorker(struct piccolo_GcWorker* worker) {
+    while(__atomic_exchange_n(&worker->lock, 1, __ATOMIC_ACQUIRE))
+        while(__atomic_load_n(&worker->lock, __ATOMIC_RELAXED))
+            ;
+}
+
+static void unlockWorker(struct piccolo_GcWorker* worker) {
+    __atomic_store_n(&worker->lock, 0, __ATOMIC_RELEASE);
+}
 
-    struct piccolo_Obj* currObj = engine->objs;
-    while(currObj != NULL) {
-        currObj->marked = false;
-        currObj = currObj->next;
+// head and tail are read without the lock by hasWork, so they are only written atomically
+static void setBounds(struct piccolo_GcWorker* worker, int head, int tail) {
+    __atomic_store_n(&worker->head, head, __ATOMIC_RELAXED);
+    __atomic_store_n(&worker->tail, tail, __ATOMIC_RELAXED);
+}
+
+// Makes room for count more objects at the tail, the caller holds the lock. False if it is out of memory
+static bool reserveWork(struct piccolo_GcWorker* worker, int count) {
+    if(worker->tail + count <= worker->capacity)
+        return true;
+    int live = worker->tail - worker->head;
+    if(live > 0)
+        memmove(worker->values, worker->values + worker->head, sizeof(struct piccolo_Obj*) * live);
+    setBounds(worker, 0, live);
+    if(live + count > worker->capacity) {
+        int capacity = worker->capacity;
+        while(live + count > capacity)
+            capacity = PICCOLO_GROW_CAPACITY(capacity);
+        struct piccolo_Obj** values = realloc(worker->values, sizeof(struct piccolo_Obj*) * capacity);
+        if(values == NULL)
+            return false;
+        worker->values = values;
+        worker->capacity = capacity;
+    }
+    return true;
+}
+
+static void pushWork(struct piccolo_GcWorker* worker, struct piccolo_Obj* obj) {
+    lockWorker(worker);
+    if(reserveWork(worker, 1)) {
+        worker->values[worker->tail] = obj;
+        setBounds(worker, worker->head, worker->tail + 1);
+    } else {
+        worker->overflow = true;
+    }
+    unlockWorker(worker);
+}
+
+static struct piccolo_Obj* popWork(struct piccolo_GcWorker* worker) {
+    struct piccolo_Obj* obj = NULL;
+    lockWorker(worker);
+    if(worker->tail > worker->head) {
+        obj = worker->values[worker->tail - 1];
+        setBounds(worker, worker->head, worker->tail - 1);
+    }
+    if(worker->tail == worker->head)
+        setBounds(worker, 0, 0);
+    unlockWorker(worker);
+    return obj;
+}
+
+static bool hasWork(struct piccolo_GcWorker* worker) {
+    return __atomic_load_n(&worker->tail, __ATOMIC_RELAXED) != __atomic_load_n(&worker->head, __ATOMIC_RELAXED);
+}
+
+// Takes the locks of two queues, always the one earlier in marker->workers first so two thieves can't wait on each other
+static void lockPair(struct piccolo_GcWorker* a, struct piccolo_GcWorker* b) {
+    if(a > b) {
+        struct piccolo_GcWorker* tmp = a;
+        a = b;
+        b = tmp;
+    }
+    lockWorker(a);
+    lockWorker(b);
+}
+
+// Moves half of the oldest objects of another worker's queue to the thief's
+static bool steal(struct piccolo_GcMarker* marker, struct piccolo_GcWorker* thief) {
+    for(int i = 0; i < marker->threadCount; i++) {
+        struct piccolo_GcWorker* victim = &marker->workers[i];
+        if(victim == thief || !hasWork(victim))
+            continue;
+        lockPair(victim, thief);
+        int count = (victim->tail - victim->head + 1) / 2;
+        if(count > 0 && reserveWork(thief, count)) {
+            memcpy(thief->values + thief->tail, victim->values + victim->head, sizeof(struct piccolo_Obj*) * count);
+            setBounds(thief, thief->head, thief->tail + count);
+            setBounds(victim, victim->head + count, victim->tail);
+        } else {
+            count = 0;
+        }
+        unlockWorker(thief);
+        unlockWorker(victim);
+        if(count > 0)
+            return true;
     }
+    return false;
+}
+
+static bool anyWork(struct piccolo_GcMarker* marker) {
+    for(int i = 0; i < marker->threadCount; i++)
+        if(hasWork(&marker->workers[i]))
+            return true;
+    return false;
+}
+
+static void markWorker(struct piccolo_GcMarker* marker, struct piccolo_GcWorker* worker) {
+    struct piccolo_Engine* engine = marker->engine;
+    gcEngine = engine;
+    gcWorker = worker;
+    for(;;) {
+        struct piccolo_Obj* obj;
+        while((obj = popWork(worker)) != NULL)
+            traceObj(engine, obj);
+        if(steal(marker, worker))
+            continue;
+        __atomic_sub_fetch(&marker->active, 1, __ATOMIC_ACQ_REL);
+        bool found = false;
+        while(!found) {
+            if(__atomic_load_n(&marker->active, __ATOMIC_ACQUIRE) == 0)
+                break;
+            if(anyWork(marker)) {
+                __atomic_add_fetch(&marker->active, 1, __ATOMIC_ACQ_REL);
+                found = steal(marker, worker);
+                if(!found)
+                    __atomic_sub_fetch(&marker->active, 1, __ATOMIC_ACQ_REL);
+            } else {
+                sched_yield();
+            }
+        }
+        if(!found)
+            break;
+    }
+    gcWorker = NULL;
+}
+
+struct markThreadArgs {
+    struct piccolo_GcMarker* marker;
+    int idx;
+};
+
+static void* markThread(void* payload) {
+    struct piccolo_GcMarker* marker = ((struct markThreadArgs*)payload)->marker;
+    struct piccolo_GcWorker* worker = &marker->workers[((struct markThreadArgs*)payload)->idx];
+    free(payload);
+    uint64_t generation = 0;
+    pthread_mutex_lock(&marker->lock);
+    for(;;) {
+        while(marker->generation == generation && !marker->quit)
+            pthread_cond_wait(&marker->start, &marker->lock);
+        if(marker->quit)
+            break;
+        generation = marker->generation;
+        pthread_mutex_unlock(&marker->lock);
+        markWorker(marker, worker);
+        pthread_mutex_lock(&marker->lock);
+        marker->finished++;
+        pthread_cond_signal(&marker->done);
+    }
+    pthread_mutex_unlock(&marker->lock);
+    return NULL;
+}
+
+static void stopMarker(struct piccolo_Engine* engine) {
+    struct piccolo_GcMarker* marker = engine->gcMarker;
+    if(marker == NULL)
+        return;
+    pthread_mutex_lock(&marker->lock);
+    marker->quit = true;
+    pthread_cond_broadcast(&marker->start);
+    pthread_mutex_unlock(&marker->lock);
+    for(int i = 0; i < marker->threadCount - 1; i++)
+        pthread_join(marker->threads[i], NULL);
+    for(int i = 0; i < marker->threadCount; i++)
+        free(marker->workers[i].values);
+    pthread_mutex_destroy(&marker->lock);
+    pthread_cond_destroy(&marker->start);
+    pthread_cond_destroy(&marker->done);
+    engine->liveMemory -= marker->accounted;
+    free(marker->threads);
+    free(marker->workers);
+    free(marker);
+    engine->gcMarker = NULL;
+}
+
+// NULL if it is out of memory
+static struct piccolo_GcMarker* startMarker(struct piccolo_Engine* engine) {
+    struct piccolo_GcMarker* marker = calloc(1, sizeof(struct piccolo_GcMarker));
+    if(marker == NULL)
+        return NULL;
+    marker->engine = engine;
+    marker->requested = marker->threadCount = engine->gcThreads;
+    marker->workers = calloc(marker->threadCount, sizeof(struct piccolo_GcWorker));
+    marker->threads = calloc(marker->threadCount - 1, sizeof(pthread_t));
+    if(marker->workers == NULL || marker->threads == NULL) {
+        free(marker->workers);
+        free(marker->threads);
+        free(marker);
+        return NULL;
+    }
+    pthread_mutex_init(&marker->lock, NULL);
+    pthread_cond_init(&marker->start, NULL);
+    pthread_cond_init(&marker->done, NULL);
+    engine->gcMarker = marker;
+    for(int i = 1; i < marker->threadCount; i++) {
+        struct markThreadArgs* args = malloc(sizeof(struct markThreadArgs));
+        if(args == NULL) {
+            marker->threadCount = i;
+            break;
+        }
+        args->marker = marker;
+        args->idx = i;
+        if(pthread_create(&marker->threads[i - 1], NULL, markThread, args) != 0) {
+            free(args);
+            // Runs with the threads it got
+            marker->threadCount = i;
+            break;
+        }
+    }
+    return marker;
+}
+
+// Puts the marked objects of the pages back on the gray stack
+static void regrayPages(struct piccolo_Engine* engine, struct piccolo_SlabPage* page) {
+    for(; page != NULL; page = page->next)
+        for(int i = 0; i < page->slotCount; i++)
+            if(PAGE_SLOT(page, i)->obj.mark == engine->gcEpoch)
+                piccolo_writeObjRefArray(engine, &engine->gray, &PAGE_SLOT(page, i)->obj);
+}
+
+// Puts the marked objects of the array back on the gray stack
+static void regrayObjs(struct piccolo_Engine* engine, struct piccolo_ObjRefArray* objs) {
+    for(int i = 0; i < objs->count; i++)
+        if(objs->values[i]->mark == engine->gcEpoch)
+            piccolo_writeObjRefArray(engine, &engine->gray, objs->values[i]);
+}
+
+/*
+    Traces everything reachable from the gray objects with engine->gcThreads threads. False if
+    there is no memory for the queues, the gray objects are left for the caller to trace then.
+ */
+static bool markParallel(struct piccolo_Engine* engine) {
+    if(engine->gcMarker != NULL && engine->gcMarker->requested != engine->gcThreads)
+        stopMarker(engine);
+    struct piccolo_GcMarker* marker = engine->gcMarker != NULL ? engine->gcMarker : startMarker(engine);
+    if(marker == NULL)
+        return false;
+    for(int i = 0; i < engine->gray.count; i++) {
+        struct piccolo_GcWorker* worker = &marker->workers[i % marker->threadCount];
+        if(!reserveWork(worker, 1)) {
+            for(int j = 0; j < marker->threadCount; j++)
+                setBounds(&marker->workers[j], 0, 0);
+            return false;
+        }
+        worker->values[worker->tail] = engine->gray.values[i];
+        setBounds(worker, worker->head, worker->tail + 1);
+    }
+    engine->gray.count = 0;
+    marker->active = marker->threadCount;
+    pthread_mutex_lock(&marker->lock);
+    marker->finished = 0;
+    marker->generation++;
+    pthread_cond_broadcast(&marker->start);
+    pthread_mutex_unlock(&marker->lock);
+    markWorker(marker, &marker->workers[0]);
+    pthread_mutex_lock(&marker->lock);
+    while(marker->finished < marker->threadCount - 1)
+        pthread_cond_wait(&marker->done, &marker->lock);
+    pthread_mutex_unlock(&marker->lock);
+
+    size_t size = sizeof(struct piccolo_GcMarker) + sizeof(pthread_t) * (marker->requested - 1);
+    bool overflow = false;
+    for(int i = 0; i < marker->requested; i++) {
+        size += sizeof(struct piccolo_GcWorker) + sizeof(struct piccolo_Obj*) * marker->workers[i].capacity;
+        overflow |= marker->workers[i].overflow;
+        marker->workers[i].overflow = false;
+    }
+    engine->liveMemory += size - marker->accounted;
+    marker->accounted = size;
+    if(overflow) {
+        // Some marked objects were never traced, tracing all of them again finds what they point to
+        for(int i = 0; i < PICCOLO_SLAB_CLASSES; i++)
+            regrayPages(engine, engine->slabs[i].pages);
+        regrayObjs(engine, &engine->largeObjs);
+        regrayObjs(engine, &engine->youngLarge);
+        drainGray(engine, -1);
+    }
+    return true;
+}
+#endif
+
+// Traces everything reachable from the gray objects, in parallel if the engine asks for it
+static void markAll(struct piccolo_Engine* engine) {
+#ifdef PICCOLO_PARALLEL_GC
+    if(engine->gcThreads > 1 && markParallel(engine))
+        return;
+#endif
+    drainGray(engine, -1);
+}
+
+// Frees the unmarked objects of a page, and gives the page back to its class unless it ends up empty
+static void sweepPage(struct piccolo_Engine* engine, struct piccolo_SlabClass* slab, struct piccolo_SlabPage* page) {
+    struct piccolo_SlabSlot* free = NULL;
+    struct piccolo_SlabSlot* lastFree = NULL;
+    bool empty = true;
+    for(int i = 0; i < page->slotCount; i++) {
+        struct piccolo_SlabSlot* slot = PAGE_SLOT(page, i);
+        if(slot->obj.mark == engine->gcEpoch) {
+            empty = false;
+            continue;
+        }
+        if(slot->obj.mark != PICCOLO_MARK_FREE) {
+            piccolo_freeObjContents(engine, &slot->obj);
+            slot->obj.mark = PICCOLO_MARK_FREE;
+        }
+        slot->nextFree = free;
+        free = slot;
+        if(lastFree == NULL)
+            lastFree = slot;
+    }
+    if(empty) {
+        PICCOLO_REALLOCATE("free slab page", engine, page, PICCOLO_SLAB_PAGE_SIZE, 0);
+        return;
+    }
+    page->next = slab->pages;
+    slab->pages = page;
+    if(free != NULL) {
+        lastFree->nextFree = slab->free;
+        slab->free = free;
+    }
+}
+
+static void collectMinor(struct piccolo_Engine* engine) {
     markRoots(engine);
+    traceRemembered(engine);
+    drainGray(engine, -1);
+    filterRemembered(engine);
+    for(int i = 0; i < engine->youngObjs.count; i++)
+        if(engine->youngObjs.values[i]->mark != engine->gcEpoch)
+            piccolo_freeObj(engine, engine->youngObjs.values[i]);
+    engine->youngObjs.count = 0;
+    for(int i = 0; i < engine->youngLarge.count; i++) {
+        struct piccolo_Obj* obj = engine->youngLarge.values[i];
+        if(obj->mark == engine->gcEpoch)
+            piccolo_writeObjRefArray(engine, &engine->largeObjs, obj);
+        else
+            piccolo_freeObj(engine, obj);
+    }
+    engine->youngLarge.count = 0;
+}
+
+/*
+    Marks what the mutator may have changed without a barrier since marking started, and takes
+    away everything allocated until now for sweeping. Objects allocated while it sweeps don't
+    end up in what it sweeps.
+ */
+static void finishMarking(struct piccolo_Engine* engine) {
+    markRoots(engine);
+    traceRemembered(engine);
+    markAll(engine);
+    filterRemembered(engine);
+    for(int i = 0; i < PICCOLO_SLAB_CLASSES; i++) {
+        engine->slabs[i].sweepPages = engine->slabs[i].pages;
+        engine->slabs[i].pages = NULL;
+        engine->slabs[i].free = NULL;
+    }
+    for(int i = 0; i < engine->youngLarge.count; i++)
+        piccolo_writeObjRefArray(engine, &engine->largeObjs, engine->youngLarge.values[i]);
+    engine->youngLarge.count = 0;
+    struct piccolo_ObjRefArray large = engine->largeObjs;
+    engine->largeObjs = engine->sweepLarge;
+    engine->sweepLarge = large;
+    engine->sweepLargeIdx = 0;
+    engine->sweepClass = 0;
+    engine->youngObjs.count = 0;
+    engine->gcState = PICCOLO_GC_SWEEPING;
+}
+
+// Sweeps a page or a batch of large objects, false once there is nothing left to sweep
+static bool sweepStep(struct piccolo_Engine* engine) {
+    while(engine->sweepClass < PICCOLO_SLAB_CLASSES) {
+        struct piccolo_SlabClass* slab = &engine->slabs[engine->sweepClass];
+        struct piccolo_SlabPage* page = slab->sweepPages;
+        if(page != NULL) {
+            slab->sweepPages = page->next;
+            sweepPage(engine, slab, page);
+            return true;
+        }
+        engine->sweepClass++;
+    }
+    struct piccolo_ObjRefArray* large = &engine->sweepLarge;
+    for(int i = 0; i < GC_BATCH && engine->sweepLargeIdx < large->count; i++) {
+        struct piccolo_Obj* obj = large->values[engine->sweepLargeIdx++];
+        if(obj->mark == engine->gcEpoch)
+            piccolo_writeObjRefArray(engine, &engine->largeObjs, obj);
+        else
+            piccolo_freeObj(engine, obj);
+    }
+    if(engine->sweepLargeIdx < large->count)
+        return true;
+    large->count = 0;
+    return false;
+}
+
+// Does the work of a major collection until it is done or the deadline passes
+static void stepMajor(struct piccolo_Engine* engine, int64_t deadline) {
+    while(engine->gcState != PICCOLO_GC_IDLE) {
+        switch(engine->gcState) {
+            case PICCOLO_GC_MARKING: {
+                if(deadline == -1)
+                    markAll(engine);
+                if(drainGray(engine, deadline))
+                    finishMarking(engine);
+                break;
+            }
+            case PICCOLO_GC_SWEEPING: {
+                if(!sweepStep(engine)) {
+                    engine->gcState = PICCOLO_GC_IDLE;
+                    engine->oldMemory = engine->liveMemory;
+                    engine->gcThreshold = engine->liveMemory * 2;
+                }
+                break;
+            }
+            case PICCOLO_GC_IDLE: break;
+        }
+        if(deadline != -1 && piccolo_monotonicUsecs() >= deadline)
+            return;
+    }
+}
 
-    struct piccolo_Obj* newObjs = NULL;
-    currObj = engine->objs;
-    int liveObjs = 0;
-    while(currObj != NULL) {
-        struct piccolo_Obj* curr = currObj;
-        currObj = currObj->next;
-        if(curr->marked) {
-            liveObjs++;
-            curr->next = newObjs;
-            newObjs = curr;
+void piccolo_collectGarbage(struct piccolo_Engine* engine) {
+    gcEngine = engine;
+    if(engine->gcState == PICCOLO_GC_IDLE) {
+        if(engine->oldMemory > engine->gcThreshold) {
+            engine->gcEpoch = engine->gcEpoch == 1 ? 2 : 1;
+            engine->gcState = PICCOLO_GC_MARKING;
+            markRoots(engine);
         } else {
-            piccolo_freeObj(engine, curr);
+            collectMinor(engine);
+            engine->oldMemory = engine->liveMemory;
         }
     }
+    if(engine->gcState != PICCOLO_GC_IDLE) {
+        // A heap that grows that much during the collection finishes it at once
+        int64_t deadline = -1;
+        if(engine->gcPauseUsecs > 0 && engine->liveMemory < engine->gcThreshold * 2)
+            deadline = piccolo_monotonicUsecs() + engine->gcPauseUsecs;
+        stepMajor(engine, deadline);
+    }
+    engine->youngMemory = 0;
+    engine->gcPending = false;
+}
 
-    engine->objs = newObjs;
+static void freePages(struct piccolo_Engine* engine, struct piccolo_SlabPage* page) {
+    while(page != NULL) {
+        struct piccolo_SlabPage* next = page->next;
+        for(int i = 0; i < page->slotCount; i++)
+            if(PAGE_SLOT(page, i)->obj.mark != PICCOLO_MARK_FREE)
+                piccolo_freeObjContents(engine, &PAGE_SLOT(page, i)->obj);
+        PICCOLO_REALLOCATE("free slab page", engine, page, PICCOLO_SLAB_PAGE_SIZE, 0);
+        page = next;
+    }
+}
+
+void piccolo_gcFreeHeap(struct piccolo_Engine* engine) {
+#ifdef PICCOLO_PARALLEL_GC
+    stopMarker(engine);
+#endif
+    for(int i = 0; i < PICCOLO_SLAB_CLASSES; i++) {
+        freePages(engine, engine->slabs[i].pages);
+        freePages(engine, engine->slabs[i].sweepPages);
+    }
+    for(int i = 0; i < engine->largeObjs.count; i++)
+        piccolo_freeObj(engine, engine->largeObjs.values[i]);
+    for(int i = 0; i < engine->youngLarge.count; i++)
+        piccolo_freeObj(engine, engine->youngLarge.values[i]);
+    // The ones before sweepLargeIdx were freed or moved to largeObjs already
+    for(int i = engine->sweepLargeIdx; i < engine->sweepLarge.count; i++)
+        piccolo_freeObj(engine, engine->sweepLarge.values[i]);
+    piccolo_freeObjRefArray(engine, &engine->largeObjs);
+    piccolo_freeObjRefArray(engine, &engine->sweepLarge);
+    piccolo_freeObjRefArray(engine, &engine->youngObjs);
+    piccolo_freeObjRefArray(engine, &engine->youngLarge);
+    piccolo_freeObjRefArray(engine, &engine->remembered);
+    piccolo_freeObjRefArray(engine, &engine->gray);
 }
@@ -7,4 +7,22 @@
 void piccolo_gcMarkValue(piccolo_Value value);
 void piccolo_collectGarbage(struct piccolo_Engine* engine);
 
+struct piccolo_Obj* piccolo_gcAllocSlab(struct piccolo_Engine* engine, size_t size);
+void piccolo_gcFreeSlab(struct piccolo_Engine* engine, struct piccolo_Obj* obj, size_t size);
+// Frees every object, with the memory the collector keeps track of them in
+void piccolo_gcFreeHeap(struct piccolo_Engine* engine);
+
+void piccolo_gcRemember(struct piccolo_Engine* engine, struct piccolo_Obj* obj);
+void piccolo_gcBarrierSlow(struct piccolo_Engine* engine, struct piccolo_Obj* obj, struct piccolo_Obj* value);
+
+/*
+    Has to run whenever value is stored in an array, a hashmap or a closed upval, which may be
+    marked by then. Native structs and coroutines don't need it, they are remembered for their
+    whole life and scanned again before a collection frees anything.
+ */
+static inline void piccolo_gcWriteBarrier(struct piccolo_Engine* engine, struct piccolo_Obj* obj, piccolo_Value value) {
+    if(obj->mark == engine->gcEpoch && PICCOLO_IS_OBJ(value) && PICCOLO_AS_OBJ(value)->mark != engine->gcEpoch)
+        piccolo_gcBarrierSlow(engine, obj, PICCOLO_AS_OBJ(value));
+}
+
 #endif
@@ -0,0 +1,735 @@
+
+// For MAP_ANONYMOUS
+#define _DEFAULT_SOURCE
+
+#include "jit.h"
+
+#ifdef PICCOLO_JIT
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "engine.h"
+#include "object.h"
+#include "package.h"
+#include "optimizer.h"
+#include "util/memory.h"
+
+/*
+    Register use inside of compiled code:
+        rbx  locals of the frame
+        r12  where to write the stack top back to
+        r13  stack top
+        r14  constants of the bytecode
+        r15  package of the frame, for globals
+    rax, rcx, rdx, rsi, xmm0 and xmm1 are scratch.
+ */
+enum {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+};
+
+enum {
+    XMM0, XMM1,
+};
+
+enum {
+    CC_BE = 0x6, CC_A = 0x7,
+    CC_E = 0x4, CC_NE = 0x5,
+    CC_P = 0xA, CC_NP = 0xB,
+    CC_LE = 0xE,
+};
+
+#define NO_CC (-1)
+#define OP_ADDSD 0x58
+#define OP_MULSD 0x59
+#define OP_SUBSD 0x5C
+#define OP_DIVSD 0x5E
+
+#define SLOT(idx) ((int32_t)((idx) * (int)sizeof(piccolo_Value)))
+// Jumps either go to the code of an instruction, or back to the interpreter at an instruction
+#define EXIT_AT(offset) (-(offset) - 1)
+
+struct Assembler {
+    struct piccolo_Engine* engine;
+    struct piccolo_ByteArray code;
+    struct piccolo_IntArray fixups;
+    struct piccolo_IntArray fixupTargets;
+};
+
+static void emitByte(struct Assembler* as, uint8_t byte) {
+    piccolo_writeByteArray(as->engine, &as->code, byte);
+}
+
+static void emitInt(struct Assembler* as, int32_t value) {
+    uint32_t bits = (uint32_t)value;
+    for(int i = 0; i < 4; i++)
+        emitByte(as, (bits >> (8 * i)) & 0xFF);
+}
+
+static void patchInt(struct Assembler* as, int pos, int32_t value) {
+    uint32_t bits = (uint32_t)value;
+    for(int i = 0; i < 4; i++)
+        as->code.values[pos + i] = (bits >> (8 * i)) & 0xFF;
+}
+
+static void emitRex(struct Assembler* as, bool wide, int reg, int rm) {
+    uint8_t rex = 0x40 | (wide ? 0x08 : 0) | ((reg & 8) ? 0x04 : 0) | ((rm & 8) ? 0x01 : 0);
+    if(rex != 0x40)
+        emitByte(as, rex);
+}
+
+// [base + disp32]
+static void emitMem(struct Assembler* as, int reg, int base, int32_t disp) {
+    emitByte(as, 0x80 | ((reg & 7) << 3) | (base & 7));
+    if((base & 7) == RSP)
+        emitByte(as, 0x24);
+    emitInt(as, disp);
+}
+
+static void emitRegReg(struct Assembler* as, int reg, int rm) {
+    emitByte(as, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+static void emitPush(struct Assembler* as, int reg) {
+    emitRex(as, false, 0, reg);
+    emitByte(as, 0x50 + (reg & 7));
+}
+
+static void emitPop(struct Assembler* as, int reg) {
+    emitRex(as, false, 0, reg);
+    emitByte(as, 0x58 + (reg & 7));
+}
+
+static void emitLoad(struct Assembler* as, int dst, int base, int32_t disp) {
+    emitRex(as, true, dst, base);
+    emitByte(as, 0x8B);
+    emitMem(as, dst, base, disp);
+}
+
+static void emitStore(struct Assembler* as, int base, int32_t disp, int src) {
+    emitRex(as, true, src, base);
+    emitByte(as, 0x89);
+    emitMem(as, src, base, disp);
+}
+
+static void emitMove(struct Assembler* as, int dst, int src) {
+    emitRex(as, true, src, dst);
+    emitByte(as, 0x89);
+    emitRegReg(as, src, dst);
+}
+
+static void emitLea(struct Assembler* as, int dst, int base, int32_t disp) {
+    emitRex(as, true, dst, base);
+    emitByte(as, 0x8D);
+    emitMem(as, dst, base, disp);
+}
+
+// 32 bit compare of a register with an immediate
+static void emitCmpImm(struct Assembler* as, int reg, int32_t imm) {
+    emitRex(as, false, 0, reg);
+    emitByte(as, 0x81);
+    emitRegReg(as, 7, reg);
+    emitInt(as, imm);
+}
+
+static void emitLoadDouble(struct Assembler* as, int dst, int base, int32_t disp) {
+    emitByte(as, 0xF2);
+    emitRex(as, false, dst, base);
+    emitByte(as, 0x0F);
+    emitByte(as, 0x10);
+    emitMem(as, dst, base, disp);
+}
+
+static void emitStoreDouble(struct Assembler* as, int base, int32_t disp, int src) {
+    emitByte(as, 0xF2);
+    emitRex(as, false, src, base);
+    emitByte(as, 0x0F);
+    emitByte(as, 0x11);
+    emitMem(as, src, base, disp);
+}
+
+static void emitDoubleOp(struct Assembler* as, uint8_t op, int dst, int src) {
+    emitByte(as, 0xF2);
+    emitByte(as, 0x0F);
+    emitByte(as, op);
+    emitRegReg(as, dst, src);
+}
+
+// Sets the flags like an unsigned compare of a with b, unordered sets ZF, PF and CF
+static void emitCompareDoubles(struct Assembler* as, int a, int b) {
+    emitByte(as, 0x66);
+    emitByte(as, 0x0F);
+    emitByte(as, 0x2E);
+    emitRegReg(as, a, b);
+}
+
+// setcc al
+static void emitSetAl(struct Assembler* as, int cc) {
+    emitByte(as, 0x0F);
+    emitByte(as, 0x90 + cc);
+    emitByte(as, 0xC0);
+}
+
+static void emitLong(struct Assembler* as, uint64_t value) {
+    for(int i = 0; i < 8; i++)
+        emitByte(as, (value >> (8 * i)) & 0xFF);
+}
+
+static void emitMoveImm64(struct Assembler* as, int dst, uint64_t imm) {
+    emitRex(as, true, 0, dst);
+    emitByte(as, 0xB8 + (dst & 7));
+    emitLong(as, imm);
+}
+
+static void emitJump(struct Assembler* as, int cc, int target) {
+    if(cc == NO_CC) {
+        emitByte(as, 0xE9);
+    } else {
+        emitByte(as, 0x0F);
+        emitByte(as, 0x80 + cc);
+    }
+    piccolo_writeIntArray(as->engine, &as->fixups, as->code.count);
+    piccolo_writeIntArray(as->engine, &as->fixupTargets, target);
+    emitInt(as, 0);
+}
+
+// Backward jumps count down the execution budget and leave to the interpreter once it runs out
+static void emitBudgetCheck(struct Assembler* as, int exitOffset) {
+    emitMoveImm64(as, RAX, (uint64_t)(uintptr_t)&as->engine->budget);
+    emitRex(as, true, 0, RAX);
+    emitByte(as, 0x83); emitByte(as, 0x28); emitByte(as, 0x01); // sub qword [rax], 1
+    emitJump(as, CC_LE, EXIT_AT(exitOffset));
+}
+
+/*
+    The value layout specific parts. Guards jump back to the interpreter at the given instruction,
+    before the instruction has changed anything.
+ */
+#ifdef PICCOLO_ENABLE_NAN_BOXING
+
+#define NUM_OFFSET 0
+
+// 64 bit add, and, cmp and sub between registers, the opcode is the r/m, reg form
+static void emitAlu(struct Assembler* as, uint8_t op, int dst, int src) {
+    emitRex(as, true, src, dst);
+    emitByte(as, op);
+    emitRegReg(as, src, dst);
+}
+#define ALU_ADD 0x01
+#define ALU_AND 0x21
+#define ALU_SUB 0x29
+#define ALU_CMP 0x39
+
+static void emitCopyValue(struct Assembler* as, int dstBase, int32_t dstDisp, int srcBase, int32_t srcDisp) {
+    emitLoad(as, RAX, srcBase, srcDisp);
+    emitStore(as, dstBase, dstDisp, RAX);
+}
+
+static void emitGuardNum(struct Assembler* as, int base, int32_t disp, int exitOffset) {
+    emitLoad(as, RAX, base, disp);
+    emitMoveImm64(as, RDX, PICCOLO_QNAN);
+    emitAlu(as, ALU_AND, RAX, RDX);
+    emitAlu(as, ALU_CMP, RAX, RDX);
+    emitJump(as, CC_E, EXIT_AT(exitOffset));
+}
+
+static void emitStoreNum(struct Assembler* as, int base, int32_t disp, int src) {
+    emitStoreDouble(as, base, disp, src);
+}
+
+// Stores the boolean in al
+static void emitStoreBool(struct Assembler* as, int base, int32_t disp) {
+    emitByte(as, 0x0F); emitByte(as, 0xB6); emitByte(as, 0xC0); // movzx eax, al
+    emitMoveImm64(as, RDX, PICCOLO_QNAN | PICCOLO_TAG_FALSE);
+    emitAlu(as, ALU_ADD, RAX, RDX);
+    emitStore(as, base, disp, RAX);
+}
+
+// Leaves the boolean as 0 or 1 in eax
+static void emitGuardBool(struct Assembler* as, int base, int32_t disp, int exitOffset) {
+    emitLoad(as, RAX, base, disp);
+    emitMoveImm64(as, RDX, PICCOLO_QNAN | PICCOLO_TAG_FALSE);
+    emitAlu(as, ALU_SUB, RAX, RDX);
+    emitMoveImm64(as, RDX, 1);
+    emitAlu(as, ALU_CMP, RAX, RDX);
+    emitJump(as, CC_A, EXIT_AT(exitOffset));
+}
+
+#else
+
+#define NUM_OFFSET ((int32_t)offsetof(piccolo_Value, as.number))
+#define BOOL_OFFSET ((int32_t)offsetof(piccolo_Value, as.boolean))
+#define TYPE_OFFSET ((int32_t)offsetof(piccolo_Value, type))
+
+_Static_assert(sizeof(enum piccolo_ValueType) == 4, "Value types are compared as 32 bit integers");
+_Static_assert(sizeof(piccolo_Value) == 16, "Values are copied as two 64 bit words");
+
+static void emitCmpMemImm(struct Assembler* as, int base, int32_t disp, int32_t imm) {
+    emitRex(as, false, 0, base);
+    emitByte(as, 0x81);
+    emitMem(as, 7, base, disp);
+    emitInt(as, imm);
+}
+
+static void emitStoreImm(struct Assembler* as, int base, int32_t disp, int32_t imm) {
+    emitRex(as, false, 0, base);
+    emitByte(as, 0xC7);
+    emitMem(as, 0, base, disp);
+    emitInt(as, imm);
+}
+
+static void emitLoadByte(struct Assembler* as, int dst, int base, int32_t disp) {
+    emitRex(as, false, dst, base);
+    emitByte(as, 0x0F);
+    emitByte(as, 0xB6);
+    emitMem(as, dst, base, disp);
+}
+
+static void emitStoreByte(struct Assembler* as, int base, int32_t disp, int src) {
+    emitRex(as, false, src, base);
+    emitByte(as, 0x88);
+    emitMem(as, src, base, disp);
+}
+
+static void emitCopyValue(struct Assembler* as, int dstBase, int32_t dstDisp, int srcBase, int32_t srcDisp) {
+    emitLoad(as, RAX, srcBase, srcDisp);
+    emitLoad(as, RCX, srcBase, srcDisp + 8);
+    emitStore(as, dstBase, dstDisp, RAX);
+    emitStore(as, dstBase, dstDisp + 8, RCX);
+}
+
+static void emitGuardNum(struct Assembler* as, int base, int32_t disp, int exitOffset) {
+    emitCmpMemImm(as, base, disp + TYPE_OFFSET, PICCOLO_VALUE_NUMBER);
+    emitJump(as, CC_NE, EXIT_AT(exitOffset));
+}
+
+static void emitStoreNum(struct Assembler* as, int base, int32_t disp, int src) {
+    emitStoreDouble(as, base, disp + NUM_OFFSET, src);
+    emitStoreImm(as, base, disp + TYPE_OFFSET, PICCOLO_VALUE_NUMBER);
+}
+
+static void emitStoreBool(struct Assembler* as, int base, int32_t disp) {
+    emitStoreByte(as, base, disp + BOOL_OFFSET, RAX);
+    emitStoreImm(as, base, disp + TYPE_OFFSET, PICCOLO_VALUE_BOOL);
+}
+
+static void emitGuardBool(struct Assembler* as, int base, int32_t disp, int exitOffset) {
+    emitCmpMemImm(as, base, disp + TYPE_OFFSET, PICCOLO_VALUE_BOOL);
+    emitJump(as, CC_NE, EXIT_AT(exitOffset));
+    emitLoadByte(as, RAX, base, disp + BOOL_OFFSET);
+}
+
+#endif
+
+static void emitLoadNum(struct Assembler* as, int dst, int base, int32_t disp) {
+    emitLoadDouble(as, dst, base, disp + NUM_OFFSET);
+}
+
+// test eax, eax
+static void emitTestEax(struct Assembler* as) {
+    emitByte(as, 0x85);
+    emitByte(as, 0xC0);
+}
+
+static void regOperand(uint16_t operand, int* base, int32_t* disp) {
+    if(operand & PICCOLO_REG_CONST_BIT) {
+        *base = R14;
+        *disp = SLOT(operand & ~PICCOLO_REG_CONST_BIT);
+    } else {
+        *base = RBX;
+        *disp = SLOT(operand);
+    }
+}
+
+// Loads both operands of a register instruction into xmm0 and xmm1
+static void emitRegOperands(struct Assembler* as, uint16_t a, uint16_t b, int exitOffset) {
+    int aBase, bBase;
+    int32_t aDisp, bDisp;
+    regOperand(a, &aBase, &aDisp);
+    regOperand(b, &bBase, &bDisp);
+    emitGuardNum(as, aBase, aDisp, exitOffset);
+    emitGuardNum(as, bBase, bDisp, exitOffset);
+    emitLoadNum(as, XMM0, aBase, aDisp);
+    emitLoadNum(as, XMM1, bBase, bDisp);
+}
+
+// Loads the second and the top value of the stack into xmm0 and xmm1
+static void emitStackOperands(struct Assembler* as, int exitOffset) {
+    emitGuardNum(as, R13, SLOT(-1), exitOffset);
+    emitGuardNum(as, R13, SLOT(-2), exitOffset);
+    emitLoadNum(as, XMM0, R13, SLOT(-2));
+    emitLoadNum(as, XMM1, R13, SLOT(-1));
+}
+
+static void compileArith(struct Assembler* as, uint8_t op, int offset) {
+    emitStackOperands(as, offset);
+    emitDoubleOp(as, op, XMM0, XMM1);
+    emitStoreNum(as, R13, SLOT(-2), XMM0);
+    emitLea(as, R13, R13, SLOT(-1));
+}
+
+static void compileRegArith(struct Assembler* as, uint8_t op, uint8_t* instruction, int offset) {
+    uint16_t dst = (instruction[1] << 8) | instruction[2];
+    uint16_t a = (instruction[3] << 8) | instruction[4];
+    uint16_t b = (instruction[5] << 8) | instruction[6];
+    emitRegOperands(as, a, b, offset);
+    emitDoubleOp(as, op, XMM0, XMM1);
+    emitStoreNum(as, RBX, SLOT(dst), XMM0);
+}
+
+static void compileInstruction(struct Assembler* as, struct piccolo_Bytecode* bytecode, int offset) {
+    uint8_t* instruction = &bytecode->code.values[offset];
+    uint16_t param = 0;
+    if(offset + 2 < bytecode->code.count)
+        param = (instruction[1] << 8) | instruction[2];
+
+    switch(*instruction) {
+        case PICCOLO_OP_CONST: {
+            emitCopyValue(as, R13, 0, R14, SLOT(param));
+            emitLea(as, R13, R13, SLOT(1));
+            break;
+        }
+        case PICCOLO_OP_ADD:
+        case PICCOLO_OP_ADD_NUM_NUM: {
+            compileArith(as, OP_ADDSD, offset);
+            break;
+        }
+        case PICCOLO_OP_SUB:
+        case PICCOLO_OP_SUB_NUM_NUM: {
+            compileArith(as, OP_SUBSD, offset);
+            break;
+        }
+        case PICCOLO_OP_MUL:
+        case PICCOLO_OP_MUL_NUM_NUM: {
+            compileArith(as, OP_MULSD, offset);
+            break;
+        }
+        case PICCOLO_OP_DIV:
+        case PICCOLO_OP_DIV_NUM_NUM: {
+            compileArith(as, OP_DIVSD, offset);
+            break;
+        }
+        case PICCOLO_OP_GREATER:
+        case PICCOLO_OP_GREATER_NUM_NUM: {
+            emitStackOperands(as, offset);
+            emitCompareDoubles(as, XMM0, XMM1);
+            emitSetAl(as, CC_A);
+            emitStoreBool(as, R13, SLOT(-2));
+            emitLea(as, R13, R13, SLOT(-1));
+            break;
+        }
+        case PICCOLO_OP_LESS:
+        case PICCOLO_OP_LESS_NUM_NUM: {
+            emitStackOperands(as, offset);
+            emitCompareDoubles(as, XMM1, XMM0);
+            emitSetAl(as, CC_A);
+            emitStoreBool(as, R13, SLOT(-2));
+            emitLea(as, R13, R13, SLOT(-1));
+            break;
+        }
+        case PICCOLO_OP_EQUAL:
+        case PICCOLO_OP_NOT_EQUAL: {
+            // Only numbers, the NOT after a fused NOT_EQUAL is compiled on its own
+            emitStackOperands(as, offset);
+            emitCompareDoubles(as, XMM0, XMM1);
+            emitSetAl(as, CC_E);
+            emitByte(as, 0x0F); emitByte(as, 0x9B); emitByte(as, 0xC1); // setnp cl
+            emitByte(as, 0x20); emitByte(as, 0xC8);                     // and al, cl
+            emitStoreBool(as, R13, SLOT(-2));
+            emitLea(as, R13, R13, SLOT(-1));
+            break;
+        }
+        case PICCOLO_OP_NOT: {
+            emitGuardBool(as, R13, SLOT(-1), offset);
+            emitByte(as, 0x83); emitByte(as, 0xF0); emitByte(as, 0x01); // xor eax, 1
+            emitStoreBool(as, R13, SLOT(-1));
+            break;
+        }
+        case PICCOLO_OP_POP_STACK: {
+            emitLea(as, R13, R13, SLOT(-1));
+            break;
+        }
+        case PICCOLO_OP_PEEK_STACK:
+        case PICCOLO_OP_ITER_LOOP: {
+            emitCopyValue(as, R13, 0, R13, SLOT(-(int)param));
+            emitLea(as, R13, R13, SLOT(1));
+            break;
+        }
+        case PICCOLO_OP_SWAP_STACK: {
+            for(int32_t word = 0; word < (int32_t)sizeof(piccolo_Value); word += 8) {
+                emitLoad(as, RDX, R13, SLOT(-1) + word);
+                emitLoad(as, RSI, R13, SLOT(-2) + word);
+                emitStore(as, R13, SLOT(-1) + word, RSI);
+                emitStore(as, R13, SLOT(-2) + word, RDX);
+            }
+            break;
+        }
+        case PICCOLO_OP_GET_LOCAL:
+        case PICCOLO_OP_ADD_CONST_LOCAL: {
+            emitCopyValue(as, R13, 0, RBX, SLOT(param));
+            emitLea(as, R13, R13, SLOT(1));
+            break;
+        }
+        case PICCOLO_OP_SET_LOCAL: {
+            emitCopyValue(as, RBX, SLOT(param), R13, SLOT(-1));
+            break;
+        }
+        case PICCOLO_OP_POP_LOCALS: {
+            emitLea(as, R13, R13, SLOT(-(int)param));
+            break;
+        }
+        case PICCOLO_OP_GET_GLOBAL:
+        case PICCOLO_OP_ADD_CONST_GLOBAL:
+        case PICCOLO_OP_SET_GLOBAL: {
+            // Globals that don't exist yet are created by the interpreter
+            int32_t globals = (int32_t)offsetof(struct piccolo_Package, globals);
+            emitByte(as, 0x41); emitByte(as, 0x8B); emitMem(as, RAX, R15, globals + (int32_t)offsetof(struct piccolo_ValueArray, count)); // mov eax, [r15 + count]
+            emitCmpImm(as, RAX, param);
+            emitJump(as, CC_BE, EXIT_AT(offset));
+            emitLoad(as, RSI, R15, globals + (int32_t)offsetof(struct piccolo_ValueArray, values));
+            if(*instruction == PICCOLO_OP_SET_GLOBAL) {
+                emitCopyValue(as, RSI, SLOT(param), R13, SLOT(-1));
+            } else {
+                emitCopyValue(as, R13, 0, RSI, SLOT(param));
+                emitLea(as, R13, R13, SLOT(1));
+            }
+            break;
+        }
+        case PICCOLO_OP_JUMP: {
+            emitJump(as, NO_CC, offset + param);
+            break;
+        }
+        case PICCOLO_OP_REV_JUMP: {
+            emitBudgetCheck(as, offset - param);
+            emitJump(as, NO_CC, offset - param);
+            break;
+        }
+        case PICCOLO_OP_JUMP_FALSE: {
+            emitGuardBool(as, R13, SLOT(-1), offset);
+            emitLea(as, R13, R13, SLOT(-1));
+            emitTestEax(as);
+            emitJump(as, CC_E, offset + param);
+            break;
+        }
+        case PICCOLO_OP_REV_JUMP_FALSE: {
+            emitGuardBool(as, R13, SLOT(-1), offset);
+            emitLea(as, R13, R13, SLOT(-1));
+            emitTestEax(as);
+            emitJump(as, CC_NE, offset + 3);
+            emitBudgetCheck(as, offset - param);
+            emitJump(as, NO_CC, offset - param);
+            break;
+        }
+        case PICCOLO_OP_LESS_JUMP_FALSE:
+        case PICCOLO_OP_GREATER_JUMP_FALSE: {
+            // LESS or GREATER, JUMP_FALSE
+            uint16_t jumpDist = (instruction[2] << 8) | instruction[3];
+            emitStackOperands(as, offset);
+            emitLea(as, R13, R13, SLOT(-2));
+            if(*instruction == PICCOLO_OP_LESS_JUMP_FALSE)
+                emitCompareDoubles(as, XMM1, XMM0);
+            else
+                emitCompareDoubles(as, XMM0, XMM1);
+            emitJump(as, CC_BE, offset + 1 + jumpDist);
+            emitJump(as, NO_CC, offset + 4);
+            break;
+        }
+        case PICCOLO_OP_REG_MOVE: {
+            uint16_t src = (instruction[3] << 8) | instruction[4];
+            int srcBase;
+            int32_t srcDisp;
+            regOperand(src, &srcBase, &srcDisp);
+            emitCopyValue(as, RBX, SLOT(param), srcBase, srcDisp);
+            break;
+        }
+        case PICCOLO_OP_REG_ADD: {
+            compileRegArith(as, OP_ADDSD, instruction, offset);
+            break;
+        }
+        case PICCOLO_OP_REG_SUB: {
+            compileRegArith(as, OP_SUBSD, instruction, offset);
+            break;
+        }
+        case PICCOLO_OP_REG_MUL: {
+            compileRegArith(as, OP_MULSD, instruction, offset);
+            break;
+        }
+        case PICCOLO_OP_REG_DIV: {
+            compileRegArith(as, OP_DIVSD, instruction, offset);
+            break;
+        }
+        case PICCOLO_OP_REG_LESS_JUMP_FALSE:
+        case PICCOLO_OP_REG_LESS_EQ_JUMP_FALSE:
+        case PICCOLO_OP_REG_GREATER_JUMP_FALSE:
+        case PICCOLO_OP_REG_GREATER_EQ_JUMP_FALSE:
+        case PICCOLO_OP_REG_EQUAL_JUMP_FALSE:
+        case PICCOLO_OP_REG_NOT_EQUAL_JUMP_FALSE: {
+            // a in xmm0 and b in xmm1, jumps when the comparison is false
+            uint16_t a = (instruction[1] << 8) | instruction[2];
+            uint16_t b = (instruction[3] << 8) | instruction[4];
+            int target = offset + ((instruction[5] << 8) | instruction[6]);
+            emitRegOperands(as, a, b, offset);
+            switch(*instruction) {
+                case PICCOLO_OP_REG_LESS_JUMP_FALSE: {
+                    emitCompareDoubles(as, XMM1, XMM0);
+                    emitJump(as, CC_BE, target);
+                    break;
+                }
+                case PICCOLO_OP_REG_LESS_EQ_JUMP_FALSE: {
+                    emitCompareDoubles(as, XMM0, XMM1);
+                    emitJump(as, CC_A, target);
+                    break;
+                }
+                case PICCOLO_OP_REG_GREATER_JUMP_FALSE: {
+                    emitCompareDoubles(as, XMM0, XMM1);
+                    emitJump(as, CC_BE, target);
+                    break;
+                }
+                case PICCOLO_OP_REG_GREATER_EQ_JUMP_FALSE: {
+                    emitCompareDoubles(as, XMM1, XMM0);
+                    emitJump(as, CC_A, target);
+                    break;
+                }
+                case PICCOLO_OP_REG_EQUAL_JUMP_FALSE: {
+                    emitCompareDoubles(as, XMM0, XMM1);
+                    emitJump(as, CC_NE, target);
+                    emitJump(as, CC_P, target);
+                    break;
+                }
+                case PICCOLO_OP_REG_NOT_EQUAL_JUMP_FALSE: {
+                    emitCompareDoubles(as, XMM0, XMM1);
+                    emitByte(as, 0x70 + CC_P); emitByte(as, 6); // skip the je when unordered
+                    emitJump(as, CC_E, target);
+                    break;
+                }
+            }
+            break;
+        }
+        default: {
+            // Everything else is left to the interpreter
+            emitJump(as, NO_CC, EXIT_AT(offset));
+            break;
+        }
+    }
+}
+
+typedef int (*piccolo_JitEntry)(piccolo_Value* locals, piccolo_Value** stackTop, void* entry, piccolo_Value* constants, struct piccolo_Package* package);
+
+void piccolo_compileJit(struct piccolo_Engine* engine, struct piccolo_ObjFunction* function) {
+    struct piccolo_Bytecode* bytecode = &function->bytecode;
+    int count = bytecode->code.count;
+
+    struct Assembler as;
+    as.engine = engine;
+    piccolo_initByteArray(&as.code);
+    piccolo_initIntArray(&as.fixups);
+    piccolo_initIntArray(&as.fixupTargets);
+
+    int* entries = PICCOLO_REALLOCATE("jit entries", engine, NULL, 0, sizeof(int) * count);
+    int* exitStubs = PICCOLO_REALLOCATE("jit exit stubs", engine, NULL, 0, sizeof(int) * (count + 1));
+    for(int i = 0; i < count; i++)
+        entries[i] = -1;
+    for(int i = 0; i <= count; i++)
+        exitStubs[i] = -1;
+
+    // Entry: save the callee saved registers, load the frame and jump to the requested instruction
+    emitPush(&as, RBX);
+    emitPush(&as, R12);
+    emitPush(&as, R13);
+    emitPush(&as, R14);
+    emitPush(&as, R15);
+    emitMove(&as, RBX, RDI);
+    emitMove(&as, R12, RSI);
+    emitLoad(&as, R13, RSI, 0);
+    emitMove(&as, R14, RCX);
+    emitMove(&as, R15, R8);
+    emitByte(&as, 0xFF); emitByte(&as, 0xE2); // jmp rdx
+
+    // Exit: the offset to continue at is already in eax
+    int exit = as.code.count;
+    emitStore(&as, R12, 0, R13);
+    emitPop(&as, R15);
+    emitPop(&as, R14);
+    emitPop(&as, R13);
+    emitPop(&as, R12);
+    emitPop(&as, RBX);
+    emitByte(&as, 0xC3);
+
+    int offset = 0;
+    while(offset < count) {
+        entries[offset] = as.code.count;
+        compileInstruction(&as, bytecode, offset);
+        offset += piccolo_instructionLength(bytecode, offset);
+    }
+
+    for(int i = 0; i < as.fixups.count; i++) {
+        int pos = as.fixups.values[i];
+        int target = as.fixupTargets.values[i];
+        int dest;
+        if(target >= 0 && target < count && entries[target] != -1) {
+            dest = entries[target];
+        } else {
+            int exitOffset = target >= 0 ? target : -target - 1;
+            if(exitOffset > count)
+                exitOffset = count;
+            if(exitStubs[exitOffset] == -1) {
+                exitStubs[exitOffset] = as.code.count;
+                emitByte(&as, 0xB8); // mov eax, exitOffset
+                emitInt(&as, exitOffset);
+                emitByte(&as, 0xE9);
+                emitInt(&as, exit - (as.code.count + 4));
+            }
+            dest = exitStubs[exitOffset];
+        }
+        patchInt(&as, pos, dest - (pos + 4));
+    }
+
+    PICCOLO_REALLOCATE("jit exit stubs", engine, exitStubs, sizeof(int) * (count + 1), 0);
+    piccolo_freeIntArray(engine, &as.fixups);
+    piccolo_freeIntArray(engine, &as.fixupTargets);
+
+    size_t size = as.code.count;
+    void* code = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(code == MAP_FAILED) {
+        piccolo_freeByteArray(engine, &as.code);
+        PICCOLO_REALLOCATE("jit entries", engine, entries, sizeof(int) * count, 0);
+        return;
+    }
+    memcpy(code, as.code.values, size);
+    piccolo_freeByteArray(engine, &as.code);
+    if(mprotect(code, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(code, size);
+        PICCOLO_REALLOCATE("jit entries", engine, entries, sizeof(int) * count, 0);
+        return;
+    }
+
+    struct piccolo_JitCode* jit = PICCOLO_REALLOCATE("jit", engine, NULL, 0, sizeof(struct piccolo_JitCode));
+    jit->code = code;
+    jit->size = size;
+    jit->entries = entries;
+    jit->entryCount = count;
+    function->jit = jit;
+}
+
+void piccolo_freeJit(struct piccolo_Engine* engine, struct piccolo_ObjFunction* function) {
+    struct piccolo_JitCode* jit = function->jit;
+    if(jit == NULL)
+        return;
+    munmap(jit->code, jit->size);
+    PICCOLO_REALLOCATE("jit entries", engine, jit->entries, sizeof(int) * jit->entryCount, 0);
+    PICCOLO_REALLOCATE("jit", engine, jit, sizeof(struct piccolo_JitCode), 0);
+    function->jit = NULL;
+}
+
+int piccolo_runJit(struct piccolo_ObjFunction* function, int ip, piccolo_Value* locals, piccolo_Value** stackTop, piccolo_Value* constants, struct piccolo_Package* package) {
+    struct piccolo_JitCode* jit = function->jit;
+    if(ip >= jit->entryCount || jit->entries[ip] == -1)
+        return ip;
+    piccolo_JitEntry entry = (piccolo_JitEntry)jit->code;
+    return entry(locals, stackTop, jit->code + jit->entries[ip], constants, package);
+}
+
+#endif
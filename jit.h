@@ -0,0 +1,46 @@
+
+#ifndef PICCOLO_JIT_H
+#define PICCOLO_JIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "value.h"
+
+/*
+    Functions that get hot are translated to x86-64 machine code, one template per instruction.
+    The machine code works on the same stack and locals as the interpreter and hands control back
+    to it at any instruction it does not support, so it only exists on x86-64 Linux and can be
+    turned off with PICCOLO_DISABLE_JIT.
+ */
+#if !defined(PICCOLO_DISABLE_JIT) && defined(__x86_64__) && defined(__linux__)
+#define PICCOLO_JIT
+#endif
+
+// Number of calls plus loop iterations after which a function is compiled
+#ifndef PICCOLO_JIT_THRESHOLD
+#define PICCOLO_JIT_THRESHOLD 1000
+#endif
+
+struct piccolo_Engine;
+struct piccolo_Package;
+struct piccolo_ObjFunction;
+
+struct piccolo_JitCode {
+    uint8_t* code;
+    size_t size;
+    // Offset into code of each instruction of the bytecode, -1 for bytes inside of instructions
+    int* entries;
+    int entryCount;
+};
+
+void piccolo_compileJit(struct piccolo_Engine* engine, struct piccolo_ObjFunction* function);
+void piccolo_freeJit(struct piccolo_Engine* engine, struct piccolo_ObjFunction* function);
+
+/*
+    Runs the compiled code of a function starting at the instruction at ip, and returns the offset
+    of the instruction the interpreter has to continue with. stackTop is updated in place.
+ */
+int piccolo_runJit(struct piccolo_ObjFunction* function, int ip, piccolo_Value* locals, piccolo_Value** stackTop, piccolo_Value* constants, struct piccolo_Package* package);
+
+#endif
@@ -2,6 +2,7 @@
 #include "object.h"
 #include "util/memory.h"
 #include "engine.h"
+#include "gc.h"
 #include "package.h"
 #include "util/strutil.h"
 #include <string.h>
@@ -10,6 +11,17 @@
 #include <math.h>
 
 uint32_t piccolo_hashHashmapKey(piccolo_Value key) {
+    if(PICCOLO_IS_INT(key)) {
+        // Ints that a num can be equal to hash like that num
+        int64_t integer = PICCOLO_AS_INT(key);
+        double val = (double)integer;
+        if(val < 9223372036854775808.0 && (int64_t)val == integer) {
+            key = PICCOLO_NUM_VAL(val);
+        } else {
+            uint32_t u = (uint32_t)(integer ^ (integer >> 32));
+            return u <= INT_MAX ? u : ~u;
+        }
+    }
     if(PICCOLO_IS_NUM(key)) {
         double val = PICCOLO_AS_NUM(key);
         int32_t i;
@@ -51,9 +63,14 @@ bool piccolo_isObjOfType(piccolo_Value val, enum piccolo_ObjType type) {
 }
 
 struct piccolo_Obj* allocateObj(struct piccolo_Engine* engine, enum piccolo_ObjType type, size_t size) {
-    struct piccolo_Obj* obj = PICCOLO_REALLOCATE("obj", engine, NULL, 0, size);
-    obj->next = engine->objs;
-    engine->objs = obj;
+    struct piccolo_Obj* obj;
+    if(size <= PICCOLO_SLAB_MAX_SIZE) {
+        obj = piccolo_gcAllocSlab(engine, size);
+        piccolo_writeObjRefArray(engine, &engine->youngObjs, obj);
+    } else {
+        obj = PICCOLO_REALLOCATE("obj", engine, NULL, 0, size);
+        piccolo_writeObjRefArray(engine, &engine->youngLarge, obj);
+    }
     obj->type = type;
     obj->printed = false;
     return obj;
@@ -65,11 +82,17 @@ struct piccolo_ObjNativeStruct* piccolo_allocNativeStruct(struct piccolo_Engine*
     nativeStruct->free = NULL;
     nativeStruct->gcMark = NULL;
     nativeStruct->index = NULL;
+    nativeStruct->properties = NULL;
+    nativeStruct->methods = NULL;
+    nativeStruct->iterFirst = NULL;
+    nativeStruct->iterNext = NULL;
+    nativeStruct->iterGet = NULL;
     nativeStruct->Typename = Typename;
+    piccolo_gcRemember(engine, &nativeStruct->obj);
     return nativeStruct;
 }
 
-void piccolo_freeObj(struct piccolo_Engine* engine, struct piccolo_Obj* obj) {
+size_t piccolo_freeObjContents(struct piccolo_Engine* engine, struct piccolo_Obj* obj) {
     size_t objSize = 10;
     switch(obj->type) {
         case PICCOLO_OBJ_STRING: {
@@ -82,6 +105,10 @@ void piccolo_freeObj(struct piccolo_Engine* engine, struct piccolo_Obj* obj) {
             piccolo_freeValueArray(engine, &((struct piccolo_ObjArray*)obj)->array);
             break;
         }
+        case PICCOLO_OBJ_RANGE: {
+            objSize = sizeof(struct piccolo_ObjArray);
+            break;
+        }
         case PICCOLO_OBJ_HASHMAP: {
             objSize = sizeof(struct piccolo_ObjHashmap);
             piccolo_freeHashmap(engine, &((struct piccolo_ObjHashmap*)obj)->hashmap);
@@ -91,6 +118,9 @@ void piccolo_freeObj(struct piccolo_Engine* engine, struct piccolo_Obj* obj) {
             objSize = sizeof(struct piccolo_ObjFunction);
             struct piccolo_ObjFunction* func = (struct piccolo_ObjFunction*)obj;
             piccolo_freeBytecode(engine, &func->bytecode);
+#ifdef PICCOLO_JIT
+            piccolo_freeJit(engine, func);
+#endif
             break;
         }
         case PICCOLO_OBJ_UPVAL: {
@@ -105,6 +135,13 @@ void piccolo_freeObj(struct piccolo_Engine* engine, struct piccolo_Obj* obj) {
             PICCOLO_REALLOCATE("free upval array", engine, closure->upvals, sizeof(struct piccolo_ObjUpval*) * closure->upvalCnt, 0);
             break;
         }
+        case PICCOLO_OBJ_COROUTINE: {
+            objSize = sizeof(struct piccolo_ObjCoroutine);
+            struct piccolo_ObjCoroutine* coroutine = (struct piccolo_ObjCoroutine*)obj;
+            PICCOLO_REALLOCATE("free coroutine stack", engine, coroutine->saved.stack, sizeof(piccolo_Value) * (coroutine->saved.stackEnd - coroutine->saved.stack), 0);
+            piccolo_freeCallFrameArray(engine, &coroutine->saved.callFrames);
+            break;
+        }
         case PICCOLO_OBJ_NATIVE_FN: {
             objSize = sizeof(struct piccolo_ObjNativeFn);
             break;
@@ -116,9 +153,26 @@ void piccolo_freeObj(struct piccolo_Engine* engine, struct piccolo_Obj* obj) {
                 nativeStruct->free(PICCOLO_GET_PAYLOAD(obj, void));
             break;
         }
-        case PICCOLO_OBJ_PACKAGE: break;
+        case PICCOLO_OBJ_PACKAGE: {
+            objSize = sizeof(struct piccolo_Package);
+            break;
+        }
+#ifdef PICCOLO_ENABLE_NAN_BOXING
+        case PICCOLO_OBJ_INT: {
+            objSize = sizeof(struct piccolo_ObjInt);
+            break;
+        }
+#endif
     }
-    PICCOLO_REALLOCATE("free obj", engine, obj, objSize, 0);
+    return objSize;
+}
+
+void piccolo_freeObj(struct piccolo_Engine* engine, struct piccolo_Obj* obj) {
+    size_t objSize = piccolo_freeObjContents(engine, obj);
+    if(objSize <= PICCOLO_SLAB_MAX_SIZE)
+        piccolo_gcFreeSlab(engine, obj, objSize);
+    else
+        PICCOLO_REALLOCATE("free obj", engine, obj, objSize, 0);
 }
 
 static uint32_t hashString(const char* string, int length) {
@@ -168,6 +222,44 @@ struct piccolo_ObjArray* piccolo_newArray(struct piccolo_Engine* engine, int len
     return array;
 }
 
+struct piccolo_ObjRange* piccolo_newRange(struct piccolo_Engine* engine, int start, int end) {
+    struct piccolo_ObjRange* range = (struct piccolo_ObjRange*)allocateObj(engine, PICCOLO_OBJ_RANGE, sizeof(struct piccolo_ObjArray));
+    range->start = start;
+    range->end = end;
+    return range;
+}
+
+#ifdef PICCOLO_ENABLE_NAN_BOXING
+bool piccolo_isBoxedInt(piccolo_Value value) {
+    return PICCOLO_AS_OBJ(value)->type == PICCOLO_OBJ_INT;
+}
+
+int64_t piccolo_unboxInt(piccolo_Value value) {
+    return ((struct piccolo_ObjInt*)PICCOLO_AS_OBJ(value))->value;
+}
+
+piccolo_Value piccolo_boxInt(struct piccolo_Engine* engine, int64_t integer) {
+    struct piccolo_ObjInt* boxed = (struct piccolo_ObjInt*)PICCOLO_ALLOCATE_OBJ(engine, struct piccolo_ObjInt, PICCOLO_OBJ_INT);
+    boxed->value = integer;
+    return PICCOLO_OBJ_VAL(boxed);
+}
+#endif
+
+int piccolo_rangeLength(struct piccolo_ObjRange* range) {
+    return range->end > range->start ? range->end - range->start : 0;
+}
+
+struct piccolo_ObjArray* piccolo_rangeToArray(struct piccolo_Engine* engine, struct piccolo_ObjRange* range) {
+    int start = range->start;
+    int len = piccolo_rangeLength(range);
+    struct piccolo_ObjArray* array = (struct piccolo_ObjArray*)range;
+    array->obj.type = PICCOLO_OBJ_ARRAY;
+    piccolo_initValueArray(&array->array);
+    for(int i = 0; i < len; i++)
+        piccolo_writeValueArray(engine, &array->array, PICCOLO_NUM_VAL(start + i));
+    return array;
+}
+
 struct piccolo_ObjHashmap* piccolo_newHashmap(struct piccolo_Engine* engine) {
     struct piccolo_ObjHashmap* hashmap = PICCOLO_ALLOCATE_OBJ(engine, struct piccolo_ObjHashmap, PICCOLO_OBJ_HASHMAP);
     piccolo_initHashmap(&hashmap->hashmap);
@@ -178,6 +270,10 @@ struct piccolo_ObjFunction* piccolo_newFunction(struct piccolo_Engine* engine) {
     struct piccolo_ObjFunction* function = PICCOLO_ALLOCATE_OBJ(engine, struct piccolo_ObjFunction, PICCOLO_OBJ_FUNC);
     piccolo_initBytecode(&function->bytecode);
     function->arity = 0;
+#ifdef PICCOLO_JIT
+    function->hotness = 0;
+    function->jit = NULL;
+#endif
     return function;
 }
 
@@ -185,6 +281,7 @@ struct piccolo_ObjUpval* piccolo_newUpval(struct piccolo_Engine* engine, int idx
     struct piccolo_ObjUpval* upval = PICCOLO_ALLOCATE_OBJ(engine, struct piccolo_ObjUpval, PICCOLO_OBJ_UPVAL);
     upval->val.idx = idx;
     upval->open = true;
+    upval->owner = engine->coroutine;
     upval->next = engine->openUpvals;
     engine->openUpvals = upval;
     return upval;
@@ -198,9 +295,30 @@ struct piccolo_ObjClosure* piccolo_newClosure(struct piccolo_Engine* engine, str
     return closure;
 }
 
+struct piccolo_ObjCoroutine* piccolo_newCoroutine(struct piccolo_Engine* engine, struct piccolo_ObjClosure* closure) {
+    struct piccolo_ObjCoroutine* coroutine = PICCOLO_ALLOCATE_OBJ(engine, struct piccolo_ObjCoroutine, PICCOLO_OBJ_COROUTINE);
+    coroutine->closure = closure;
+    coroutine->state = PICCOLO_COROUTINE_SUSPENDED;
+    coroutine->saved.stack = PICCOLO_REALLOCATE("coroutine stack", engine, NULL, 0, sizeof(piccolo_Value) * 64);
+    coroutine->saved.stackTop = coroutine->saved.stack;
+    coroutine->saved.stackEnd = coroutine->saved.stack + 64;
+    piccolo_initCallFrameArray(&coroutine->saved.callFrames);
+    coroutine->saved.openUpvals = NULL;
+    piccolo_gcRemember(engine, &coroutine->obj);
+    return coroutine;
+}
+
 struct piccolo_ObjNativeFn* piccolo_makeNative(struct piccolo_Engine* engine, piccolo_Value (*native)(struct piccolo_Engine* engine, int argc, struct piccolo_Value* args, piccolo_Value self)) {
     struct piccolo_ObjNativeFn* nativeFn = PICCOLO_ALLOCATE_OBJ(engine, struct piccolo_ObjNativeFn, PICCOLO_OBJ_NATIVE_FN);
     nativeFn->native = native;
+    nativeFn->self = PICCOLO_NIL_VAL();
+    nativeFn->arity = -1;
+    return nativeFn;
+}
+
+struct piccolo_ObjNativeFn* piccolo_makeNativeWithArity(struct piccolo_Engine* engine, piccolo_Value (*native)(struct piccolo_Engine* engine, int argc, struct piccolo_Value* args, piccolo_Value self), int arity) {
+    struct piccolo_ObjNativeFn* nativeFn = piccolo_makeNative(engine, native);
+    nativeFn->arity = arity;
     return nativeFn;
 }
 
@@ -4,24 +4,32 @@
 
 #include "value.h"
 #include "bytecode.h"
+#include "jit.h"
 
 enum piccolo_ObjType {
     PICCOLO_OBJ_STRING,
     PICCOLO_OBJ_ARRAY,
+    PICCOLO_OBJ_RANGE,
     PICCOLO_OBJ_HASHMAP,
     PICCOLO_OBJ_FUNC,
     PICCOLO_OBJ_UPVAL,
     PICCOLO_OBJ_CLOSURE,
+    PICCOLO_OBJ_COROUTINE,
     PICCOLO_OBJ_NATIVE_FN,
     PICCOLO_OBJ_NATIVE_STRUCT,
     PICCOLO_OBJ_PACKAGE,
+#ifdef PICCOLO_ENABLE_NAN_BOXING
+    PICCOLO_OBJ_INT,
+#endif
 };
 
 struct piccolo_Obj {
     enum piccolo_ObjType type;
-    struct piccolo_Obj* next;
-    bool marked;
+    // Marked if it equals the engine's gcEpoch, see gc.c
+    uint8_t mark;
     bool printed;
+    // In the engine's remembered set, see gc.c
+    bool remembered;
 };
 
 struct piccolo_ObjString {
@@ -37,6 +45,24 @@ struct piccolo_ObjArray {
     struct piccolo_ValueArray array;
 };
 
+/*
+    The numbers from start up to end, without storing them. Ranges are allocated with the size of
+    an array and turn into one in place the first time they are written to or concatenated.
+ */
+struct piccolo_ObjRange {
+    struct piccolo_Obj obj;
+    int start;
+    int end;
+};
+
+#ifdef PICCOLO_ENABLE_NAN_BOXING
+// Ints that do not fit in the 48 bits of a NaN boxed value
+struct piccolo_ObjInt {
+    struct piccolo_Obj obj;
+    int64_t value;
+};
+#endif
+
 #include "util/hashmap.h"
 struct piccolo_HashmapValue {
     piccolo_Value value;
@@ -54,6 +80,10 @@ struct piccolo_ObjFunction {
     struct piccolo_Obj obj;
     struct piccolo_Bytecode bytecode;
     int arity;
+#ifdef PICCOLO_JIT
+    int hotness;
+    struct piccolo_JitCode* jit;
+#endif
 };
 
 struct piccolo_ObjUpval {
@@ -63,6 +93,8 @@ struct piccolo_ObjUpval {
         int idx;
     } val;
     bool open;
+    // Coroutine whose stack idx is in while the upval is open, NULL for the main stack
+    struct piccolo_ObjCoroutine* owner;
     struct piccolo_ObjUpval* next;
 };
 
@@ -76,10 +108,66 @@ struct piccolo_ObjClosure {
     struct piccolo_Package* package;
 };
 
+struct piccolo_CallFrame {
+    int localStart;
+    int prevIp;
+    int ip;
+    struct piccolo_Bytecode* bytecode;
+    struct piccolo_ObjClosure* closure;
+    struct piccolo_Package* package;
+};
+
+PICCOLO_DYNARRAY_HEADER(struct piccolo_CallFrame, CallFrame)
+
+// The stack and frames of code that is not running, the engine holds those of the running code
+struct piccolo_ExecState {
+    piccolo_Value* stack;
+    piccolo_Value* stackTop;
+    piccolo_Value* stackEnd;
+    struct piccolo_CallFrameArray callFrames;
+    struct piccolo_ObjUpval* openUpvals;
+};
+
+enum piccolo_CoroutineState {
+    PICCOLO_COROUTINE_SUSPENDED,
+    PICCOLO_COROUTINE_RUNNING,
+    // Resumed another coroutine and waits for it to yield or finish
+    PICCOLO_COROUTINE_WAITING,
+    PICCOLO_COROUTINE_DONE,
+};
+
+struct piccolo_ObjCoroutine {
+    struct piccolo_Obj obj;
+    struct piccolo_ObjClosure* closure;
+    enum piccolo_CoroutineState state;
+    // Only valid while SUSPENDED or WAITING
+    struct piccolo_ExecState saved;
+};
+
 struct piccolo_ObjNativeFn {
     struct piccolo_Obj obj;
+    // args points into the engine stack, it may move once the native calls back into the engine
     piccolo_Value (*native)(struct piccolo_Engine* engine, int argc, struct piccolo_Value* args, piccolo_Value self);
     piccolo_Value self;
+    // Argument count the engine checks before calling the native, or -1 if the native checks argc itself
+    int arity;
+};
+
+// A read only piccolo_Value field of a native struct payload. Tables end with an entry whose name is NULL.
+struct piccolo_NativeProperty {
+    const char* name;
+    size_t offset;
+};
+
+/*
+    A native that obj.method(args) calls with the struct as self, without allocating a bound native.
+    Tables end with an entry whose name is NULL.
+ */
+struct piccolo_NativeMethod {
+    const char* name;
+    piccolo_Value (*native)(struct piccolo_Engine* engine, int argc, struct piccolo_Value* args, piccolo_Value self);
+    // Same as the arity of a piccolo_ObjNativeFn
+    int arity;
 };
 
 struct piccolo_ObjNativeStruct {
@@ -87,6 +175,16 @@ struct piccolo_ObjNativeStruct {
     void (*free)(void* payload);
     void (*gcMark)(void* payload);
     piccolo_Value (*index)(void* payload, struct piccolo_Engine* engine, piccolo_Value key, bool set, piccolo_Value value);
+    const struct piccolo_NativeProperty* properties;
+    const struct piccolo_NativeMethod* methods;
+    /*
+        Lets for loops iterate over the struct, the hooks are NULL if it can't be iterated over.
+        The iterator is any value except nil, which iterFirst and iterNext return once there are no
+        more elements.
+     */
+    piccolo_Value (*iterFirst)(void* payload, struct piccolo_Engine* engine);
+    piccolo_Value (*iterNext)(void* payload, struct piccolo_Engine* engine, piccolo_Value iterator);
+    piccolo_Value (*iterGet)(void* payload, struct piccolo_Engine* engine, piccolo_Value iterator);
     const char* Typename;
     size_t payloadSize;
 };
@@ -95,10 +193,12 @@ bool piccolo_isObjOfType(piccolo_Value val, enum piccolo_ObjType type);
 
 #define PICCOLO_IS_STRING(val) (piccolo_isObjOfType(val, PICCOLO_OBJ_STRING))
 #define PICCOLO_IS_ARRAY(val) (piccolo_isObjOfType(val, PICCOLO_OBJ_ARRAY))
+#define PICCOLO_IS_RANGE(val) (piccolo_isObjOfType(val, PICCOLO_OBJ_RANGE))
 #define PICCOLO_IS_HASHMAP(val) (piccolo_isObjOfType(val, PICCOLO_OBJ_HASHMAP))
 #define PICCOLO_IS_FUNC(val) (piccolo_isObjOfType(val, PICCOLO_OBJ_FUNC))
 #define PICCOLO_IS_UPVAL(val) (piccolo_isObjOfType(val, PICCOLO_OBJ_UPVAL))
 #define PICCOLO_IS_CLOSURE(val) (piccolo_isObjOfType(val, PICCOLO_OBJ_CLOSURE))
+#define PICCOLO_IS_COROUTINE(val) (piccolo_isObjOfType(val, PICCOLO_OBJ_COROUTINE))
 #define PICCOLO_IS_NATIVE_FN(val) (piccolo_isObjOfType(val, PICCOLO_OBJ_NATIVE_FN))
 #define PICCOLO_IS_NATIVE_STRUCT(val) (piccolo_isObjOfType(val, PICCOLO_OBJ_NATIVE_STRUCT))
 #define PICCOLO_IS_PACKAGE(val) (piccolo_isObjOfType(val, PICCOLO_OBJ_PACKAGE))
@@ -111,16 +211,23 @@ struct piccolo_ObjNativeStruct* piccolo_allocNativeStruct(struct piccolo_Engine*
 #define PICCOLO_ALLOCATE_NATIVE_STRUCT(engine, type, name) ((struct piccolo_Obj*)piccolo_allocNativeStruct(engine, sizeof(type), name))
 #define PICCOLO_GET_PAYLOAD(obj, type) ((type*)((uint8_t*)obj + sizeof(struct piccolo_ObjNativeStruct)))
 
+// Frees the memory obj owns and returns the size obj itself was allocated with
+size_t piccolo_freeObjContents(struct piccolo_Engine* engine, struct piccolo_Obj* obj);
 void piccolo_freeObj(struct piccolo_Engine* engine, struct piccolo_Obj* obj);
 
 struct piccolo_ObjString* piccolo_takeString(struct piccolo_Engine* engine, char* string);
 struct piccolo_ObjString* piccolo_copyString(struct piccolo_Engine* engine, const char* string, int len);
 struct piccolo_ObjArray* piccolo_newArray(struct piccolo_Engine* engine, int len);
+struct piccolo_ObjRange* piccolo_newRange(struct piccolo_Engine* engine, int start, int end);
+int piccolo_rangeLength(struct piccolo_ObjRange* range);
+struct piccolo_ObjArray* piccolo_rangeToArray(struct piccolo_Engine* engine, struct piccolo_ObjRange* range);
 struct piccolo_ObjHashmap* piccolo_newHashmap(struct piccolo_Engine* engine);
 struct piccolo_ObjFunction* piccolo_newFunction(struct piccolo_Engine* engine);
 struct piccolo_ObjUpval* piccolo_newUpval(struct piccolo_Engine* engine, int idx);
 struct piccolo_ObjClosure* piccolo_newClosure(struct piccolo_Engine* engine, struct piccolo_ObjFunction* function, int upvals);
+struct piccolo_ObjCoroutine* piccolo_newCoroutine(struct piccolo_Engine* engine, struct piccolo_ObjClosure* closure);
 struct piccolo_ObjNativeFn* piccolo_makeNative(struct piccolo_Engine* engine, piccolo_Value (*native)(struct piccolo_Engine* engine, int argc, struct piccolo_Value* args, piccolo_Value self));
+struct piccolo_ObjNativeFn* piccolo_makeNativeWithArity(struct piccolo_Engine* engine, piccolo_Value (*native)(struct piccolo_Engine* engine, int argc, struct piccolo_Value* args, piccolo_Value self), int arity);
 struct piccolo_ObjNativeFn* piccolo_makeBoundNative(struct piccolo_Engine* engine, piccolo_Value (*native)(struct piccolo_Engine* engine, int argc, struct piccolo_Value* args, piccolo_Value self), piccolo_Value self);
 struct piccolo_Package* piccolo_newPackage(struct piccolo_Engine* engine);
 
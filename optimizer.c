@@ -0,0 +1,122 @@
+
+#include "optimizer.h"
+
+#include <stdbool.h>
+
+int piccolo_instructionLength(struct piccolo_Bytecode* bytecode, int offset) {
+    uint8_t* code = bytecode->code.values;
+    switch(code[offset]) {
+        case PICCOLO_OP_CONST:
+        case PICCOLO_OP_PEEK_STACK:
+        case PICCOLO_OP_CREATE_ARRAY:
+        case PICCOLO_OP_UNPACK:
+        case PICCOLO_OP_GET_GLOBAL:
+        case PICCOLO_OP_SET_GLOBAL:
+        case PICCOLO_OP_GET_LOCAL:
+        case PICCOLO_OP_SET_LOCAL:
+        case PICCOLO_OP_POP_LOCALS:
+        case PICCOLO_OP_JUMP:
+        case PICCOLO_OP_JUMP_FALSE:
+        case PICCOLO_OP_REV_JUMP:
+        case PICCOLO_OP_REV_JUMP_FALSE:
+        case PICCOLO_OP_CALL:
+        case PICCOLO_OP_TAIL_CALL:
+        case PICCOLO_OP_RETURN_VALUES:
+        case PICCOLO_OP_GET_UPVAL:
+        case PICCOLO_OP_SET_UPVAL:
+        case PICCOLO_OP_CLOSE_UPVALS:
+        case PICCOLO_OP_ACC_CREATE:
+        case PICCOLO_OP_ACC_APPEND:
+        case PICCOLO_OP_ITER_NEXT:
+        case PICCOLO_OP_ADD_CONST_LOCAL:
+        case PICCOLO_OP_ADD_CONST_GLOBAL:
+        case PICCOLO_OP_ITER_LOOP:
+            return 3;
+        case PICCOLO_OP_GET_MEMBER:
+        case PICCOLO_OP_INVOKE:
+        case PICCOLO_OP_REG_MOVE:
+            return 5;
+        case PICCOLO_OP_REG_ADD:
+        case PICCOLO_OP_REG_SUB:
+        case PICCOLO_OP_REG_MUL:
+        case PICCOLO_OP_REG_DIV:
+        case PICCOLO_OP_REG_MOD:
+        case PICCOLO_OP_REG_LESS_JUMP_FALSE:
+        case PICCOLO_OP_REG_LESS_EQ_JUMP_FALSE:
+        case PICCOLO_OP_REG_GREATER_JUMP_FALSE:
+        case PICCOLO_OP_REG_GREATER_EQ_JUMP_FALSE:
+        case PICCOLO_OP_REG_EQUAL_JUMP_FALSE:
+        case PICCOLO_OP_REG_NOT_EQUAL_JUMP_FALSE:
+            return 7;
+        case PICCOLO_OP_CLOSURE: {
+            int upvals = (code[offset + 1] << 8) | code[offset + 2];
+            return 3 + 3 * upvals;
+        }
+        default:
+            return 1;
+    }
+}
+
+static bool opAt(struct piccolo_Bytecode* bytecode, int offset, enum piccolo_OpCode op) {
+    return offset < bytecode->code.count && bytecode->code.values[offset] == op;
+}
+
+static uint16_t paramAt(struct piccolo_Bytecode* bytecode, int offset) {
+    return (bytecode->code.values[offset + 1] << 8) | bytecode->code.values[offset + 2];
+}
+
+/*
+    Superinstructions only replace the opcode of the first instruction of the sequence they
+    cover. The rest of the sequence stays in place, so jump offsets and jump targets inside the
+    sequence are unaffected, and a fused instruction whose fast path does not apply can simply
+    behave like the instruction it replaced and continue with the original bytes.
+ */
+void piccolo_fuseInstructions(struct piccolo_Bytecode* bytecode) {
+    int offset = 0;
+    while(offset < bytecode->code.count) {
+        int next = offset + piccolo_instructionLength(bytecode, offset);
+        uint8_t* op = &bytecode->code.values[offset];
+        switch(*op) {
+            case PICCOLO_OP_GET_LOCAL: {
+                // GET_LOCAL a, CONST c, ADD, SET_LOCAL b
+                if(opAt(bytecode, offset + 3, PICCOLO_OP_CONST) &&
+                   opAt(bytecode, offset + 6, PICCOLO_OP_ADD) &&
+                   opAt(bytecode, offset + 7, PICCOLO_OP_SET_LOCAL))
+                    *op = PICCOLO_OP_ADD_CONST_LOCAL;
+                break;
+            }
+            case PICCOLO_OP_GET_GLOBAL: {
+                if(opAt(bytecode, offset + 3, PICCOLO_OP_CONST) &&
+                   opAt(bytecode, offset + 6, PICCOLO_OP_ADD) &&
+                   opAt(bytecode, offset + 7, PICCOLO_OP_SET_GLOBAL))
+                    *op = PICCOLO_OP_ADD_CONST_GLOBAL;
+                break;
+            }
+            case PICCOLO_OP_LESS: {
+                if(opAt(bytecode, offset + 1, PICCOLO_OP_JUMP_FALSE))
+                    *op = PICCOLO_OP_LESS_JUMP_FALSE;
+                break;
+            }
+            case PICCOLO_OP_GREATER: {
+                if(opAt(bytecode, offset + 1, PICCOLO_OP_JUMP_FALSE))
+                    *op = PICCOLO_OP_GREATER_JUMP_FALSE;
+                break;
+            }
+            case PICCOLO_OP_EQUAL: {
+                if(opAt(bytecode, offset + 1, PICCOLO_OP_NOT))
+                    *op = PICCOLO_OP_NOT_EQUAL;
+                break;
+            }
+            case PICCOLO_OP_PEEK_STACK: {
+                // The loop header emitted by compileFor
+                if(opAt(bytecode, offset + 3, PICCOLO_OP_PEEK_STACK) &&
+                   paramAt(bytecode, offset) == paramAt(bytecode, offset + 3) &&
+                   opAt(bytecode, offset + 6, PICCOLO_OP_ITER_CONT) &&
+                   opAt(bytecode, offset + 7, PICCOLO_OP_JUMP_FALSE))
+                    *op = PICCOLO_OP_ITER_LOOP;
+                break;
+            }
+        }
+        offset = next;
+    }
+}
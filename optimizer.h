@@ -0,0 +1,10 @@
+
+#ifndef PICCOLO_OPTIMIZER_H
+#define PICCOLO_OPTIMIZER_H
+
+#include "bytecode.h"
+
+int piccolo_instructionLength(struct piccolo_Bytecode* bytecode, int offset);
+void piccolo_fuseInstructions(struct piccolo_Bytecode* bytecode);
+
+#endif
@@ -220,6 +220,7 @@ static struct piccolo_ExprNode* parseBlock(PARSER_PARAMS) {
 static struct piccolo_ExprNode* parseLiteral(PARSER_PARAMS) {
     SKIP_NEWLINES()
     if(parser->currToken.type == PICCOLO_TOKEN_NUM ||
+       parser->currToken.type == PICCOLO_TOKEN_INT ||
        parser->currToken.type == PICCOLO_TOKEN_STRING ||
        parser->currToken.type == PICCOLO_TOKEN_TRUE ||
        parser->currToken.type == PICCOLO_TOKEN_FALSE ||
@@ -230,12 +231,34 @@ static struct piccolo_ExprNode* parseLiteral(PARSER_PARAMS) {
         return (struct piccolo_ExprNode*)literal;
     }
     if(parser->currToken.type == PICCOLO_TOKEN_LEFT_PAREN) {
+        int charIdx = parser->currToken.charIdx;
         advanceParser(engine, parser);
         struct piccolo_ExprNode* value = parseExpr(PARSER_ARGS_REQ_VAL);
 
         while(parser->currToken.type == PICCOLO_TOKEN_NEWLINE)
             advanceParser(engine, parser);
 
+        if(parser->currToken.type == PICCOLO_TOKEN_COMMA && value != NULL) {
+            struct piccolo_TupleNode* tuple = ALLOCATE_NODE(parser, Tuple, PICCOLO_EXPR_TUPLE);
+            tuple->first = value;
+            tuple->count = 1;
+            tuple->charIdx = charIdx;
+            tuple->returned = false;
+            struct piccolo_ExprNode* curr = value;
+            while(parser->currToken.type == PICCOLO_TOKEN_COMMA) {
+                advanceParser(engine, parser);
+                struct piccolo_ExprNode* next = parseExpr(PARSER_ARGS_REQ_VAL);
+                while(parser->currToken.type == PICCOLO_TOKEN_NEWLINE)
+                    advanceParser(engine, parser);
+                if(next == NULL)
+                    break;
+                curr->nextExpr = next;
+                curr = next;
+                tuple->count++;
+            }
+            value = (struct piccolo_ExprNode*)tuple;
+        }
+
         if(parser->currToken.type == PICCOLO_TOKEN_RIGHT_PAREN) {
             advanceParser(engine, parser);
         } else {
@@ -345,6 +368,8 @@ static struct piccolo_ExprNode* parseImport(PARSER_PARAMS) {
                 advanceParser(engine, parser);
                 importAs->value = (struct piccolo_ExprNode*)import;
                 importAs->Mutable = false;
+                importAs->unpackIdx = -1;
+                importAs->scalarReplaced = false;
                 return (struct piccolo_ExprNode*)importAs;
             }
             return (struct piccolo_ExprNode*)import;
@@ -490,6 +515,7 @@ static struct piccolo_ExprNode* parseCall(PARSER_PARAMS, struct piccolo_ExprNode
     functionCall->function = function;
     functionCall->firstArg = firstArg;
     functionCall->charIdx = charIdx;
+    functionCall->tailCall = false;
     function = (struct piccolo_ExprNode*)functionCall;
     
     return function;
@@ -512,7 +538,8 @@ static struct piccolo_ExprNode* parsePostfix(PARSER_PARAMS) {
 static struct piccolo_ExprNode* parseUnary(PARSER_PARAMS) {
     SKIP_NEWLINES()
     if(parser->currToken.type == PICCOLO_TOKEN_MINUS ||
-       parser->currToken.type == PICCOLO_TOKEN_BANG) {
+       parser->currToken.type == PICCOLO_TOKEN_BANG ||
+       parser->currToken.type == PICCOLO_TOKEN_TILDE) {
         struct piccolo_Token op = parser->currToken;
         advanceParser(engine, parser);
         struct piccolo_ExprNode* value = parseUnary(PARSER_ARGS_REQ_VAL);
@@ -575,15 +602,80 @@ static struct piccolo_ExprNode* parseAdditive(PARSER_PARAMS) {
     return expr;
 }
 
-static struct piccolo_ExprNode* parseIn(PARSER_PARAMS) {
+static struct piccolo_ExprNode* parseShift(PARSER_PARAMS) {
     SKIP_NEWLINES()
     struct piccolo_ExprNode* expr = parseAdditive(PARSER_ARGS);
-    while(parser->currToken.type == PICCOLO_TOKEN_IN) {
+    while(parser->currToken.type == PICCOLO_TOKEN_LESS_LESS ||
+          parser->currToken.type == PICCOLO_TOKEN_GREATER_GREATER) {
         struct piccolo_Token op = parser->currToken;
         advanceParser(engine, parser);
         struct piccolo_ExprNode* rightHand = parseAdditive(PARSER_ARGS_REQ_VAL);
         struct piccolo_BinaryNode* binary = ALLOCATE_NODE(parser, Binary, PICCOLO_EXPR_BINARY);
         binary->a = expr;
+        binary->op = op;
+        binary->b = rightHand;
+        expr = (struct piccolo_ExprNode*)binary;
+    }
+    return expr;
+}
+
+static struct piccolo_ExprNode* parseBitAnd(PARSER_PARAMS) {
+    SKIP_NEWLINES()
+    struct piccolo_ExprNode* expr = parseShift(PARSER_ARGS);
+    while(parser->currToken.type == PICCOLO_TOKEN_AMPERSAND) {
+        struct piccolo_Token op = parser->currToken;
+        advanceParser(engine, parser);
+        struct piccolo_ExprNode* rightHand = parseShift(PARSER_ARGS_REQ_VAL);
+        struct piccolo_BinaryNode* binary = ALLOCATE_NODE(parser, Binary, PICCOLO_EXPR_BINARY);
+        binary->a = expr;
+        binary->op = op;
+        binary->b = rightHand;
+        expr = (struct piccolo_ExprNode*)binary;
+    }
+    return expr;
+}
+
+static struct piccolo_ExprNode* parseBitXor(PARSER_PARAMS) {
+    SKIP_NEWLINES()
+    struct piccolo_ExprNode* expr = parseBitAnd(PARSER_ARGS);
+    while(parser->currToken.type == PICCOLO_TOKEN_CARET) {
+        struct piccolo_Token op = parser->currToken;
+        advanceParser(engine, parser);
+        struct piccolo_ExprNode* rightHand = parseBitAnd(PARSER_ARGS_REQ_VAL);
+        struct piccolo_BinaryNode* binary = ALLOCATE_NODE(parser, Binary, PICCOLO_EXPR_BINARY);
+        binary->a = expr;
+        binary->op = op;
+        binary->b = rightHand;
+        expr = (struct piccolo_ExprNode*)binary;
+    }
+    return expr;
+}
+
+static struct piccolo_ExprNode* parseBitOr(PARSER_PARAMS) {
+    SKIP_NEWLINES()
+    struct piccolo_ExprNode* expr = parseBitXor(PARSER_ARGS);
+    while(parser->currToken.type == PICCOLO_TOKEN_PIPE) {
+        struct piccolo_Token op = parser->currToken;
+        advanceParser(engine, parser);
+        struct piccolo_ExprNode* rightHand = parseBitXor(PARSER_ARGS_REQ_VAL);
+        struct piccolo_BinaryNode* binary = ALLOCATE_NODE(parser, Binary, PICCOLO_EXPR_BINARY);
+        binary->a = expr;
+        binary->op = op;
+        binary->b = rightHand;
+        expr = (struct piccolo_ExprNode*)binary;
+    }
+    return expr;
+}
+
+static struct piccolo_ExprNode* parseIn(PARSER_PARAMS) {
+    SKIP_NEWLINES()
+    struct piccolo_ExprNode* expr = parseBitOr(PARSER_ARGS);
+    while(parser->currToken.type == PICCOLO_TOKEN_IN) {
+        struct piccolo_Token op = parser->currToken;
+        advanceParser(engine, parser);
+        struct piccolo_ExprNode* rightHand = parseBitOr(PARSER_ARGS_REQ_VAL);
+        struct piccolo_BinaryNode* binary = ALLOCATE_NODE(parser, Binary, PICCOLO_EXPR_BINARY);
+        binary->a = expr;
         binary->b = rightHand;
         binary->op = op;
         expr = (struct piccolo_ExprNode*)binary;
@@ -647,21 +739,35 @@ static struct piccolo_ExprNode* parseBoolean(PARSER_PARAMS) {
 static struct piccolo_ExprNode* parseVarDecl(PARSER_PARAMS) {
     SKIP_NEWLINES()
     if(parser->currToken.type == PICCOLO_TOKEN_VAR || parser->currToken.type == PICCOLO_TOKEN_CONST) {
-        struct piccolo_VarDeclNode* varDecl = ALLOCATE_NODE(parser, VarDecl, PICCOLO_EXPR_VAR_DECL);
-        varDecl->Mutable = parser->currToken.type == PICCOLO_TOKEN_VAR;
-        advanceParser(engine, parser);
-        if(parser->currToken.type == PICCOLO_TOKEN_IDENTIFIER) {
-            varDecl->name = parser->currToken;
+        int charIdx = parser->currToken.charIdx;
+        bool Mutable = parser->currToken.type == PICCOLO_TOKEN_VAR;
+        struct piccolo_VarDeclNode* first = NULL;
+        struct piccolo_VarDeclNode* last = NULL;
+        int count = 0;
+        do {
             advanceParser(engine, parser);
-        } else {
-            parsingError(engine, parser, "Expected variable name.");
-        }
-
+            struct piccolo_VarDeclNode* varDecl = ALLOCATE_NODE(parser, VarDecl, PICCOLO_EXPR_VAR_DECL);
+            varDecl->Mutable = Mutable;
+            varDecl->unpackIdx = count;
+            varDecl->scalarReplaced = false;
+            if(parser->currToken.type == PICCOLO_TOKEN_IDENTIFIER) {
+                varDecl->name = parser->currToken;
+                advanceParser(engine, parser);
+            } else {
+                parsingError(engine, parser, "Expected variable name.");
+            }
+            if(first == NULL)
+                first = varDecl;
+            else
+                last->expr.nextExpr = (struct piccolo_ExprNode*)varDecl;
+            last = varDecl;
+            count++;
+        } while(parser->currToken.type == PICCOLO_TOKEN_COMMA);
+
+        bool typed = false;
         if(parser->currToken.type == PICCOLO_TOKEN_COLON) {
-            varDecl->typed = true;
+            typed = true;
             advanceParser(engine, parser);
-        } else {
-            varDecl->typed = false;
         }
 
         if(parser->currToken.type == PICCOLO_TOKEN_EQ) {
@@ -670,9 +776,22 @@ static struct piccolo_ExprNode* parseVarDecl(PARSER_PARAMS) {
             parsingError(engine, parser, "Expected =.");
         }
 
-        varDecl->value = parseExpr(PARSER_ARGS_REQ_VAL);
+        struct piccolo_ExprNode* value = parseExpr(PARSER_ARGS_REQ_VAL);
+        for(struct piccolo_VarDeclNode* curr = first; curr != NULL; curr = (struct piccolo_VarDeclNode*)curr->expr.nextExpr) {
+            curr->typed = typed;
+            curr->value = value;
+        }
 
-        return (struct piccolo_ExprNode*)varDecl;
+        if(count == 1) {
+            first->unpackIdx = -1;
+            return (struct piccolo_ExprNode*)first;
+        }
+        struct piccolo_DestructureNode* destructure = ALLOCATE_NODE(parser, Destructure, PICCOLO_EXPR_DESTRUCTURE);
+        destructure->first = first;
+        destructure->count = count;
+        destructure->value = value;
+        destructure->charIdx = charIdx;
+        return (struct piccolo_ExprNode*)destructure;
     }
     return parseBoolean(PARSER_ARGS);
 }
@@ -19,8 +19,10 @@ enum piccolo_ExprNodeType {
     PICCOLO_EXPR_BINARY,
     PICCOLO_EXPR_BLOCK,
     PICCOLO_EXPR_FN_LITERAL,
+    PICCOLO_EXPR_TUPLE,
 
     PICCOLO_EXPR_VAR_DECL,
+    PICCOLO_EXPR_DESTRUCTURE,
     PICCOLO_EXPR_VAR_SET,
     PICCOLO_EXPR_SUBSCRIPT_SET,
     PICCOLO_EXPR_INDEX_SET,
@@ -113,12 +115,34 @@ struct piccolo_FnLiteralNode {
     struct piccolo_TokenArray params;
 };
 
+struct piccolo_TupleNode {
+    struct piccolo_ExprNode expr;
+    struct piccolo_ExprNode* first;
+    int count;
+    int charIdx;
+    // Set by the compiler when the tuple is the result of the enclosing function
+    bool returned;
+};
+
 struct piccolo_VarDeclNode {
     struct piccolo_ExprNode expr;
     struct piccolo_Token name;
     struct piccolo_ExprNode* value;
     bool typed;
     bool Mutable;
+    // Index of the variable in a destructuring declaration, -1 if value is assigned whole
+    int unpackIdx;
+    // Set by the compiler when value is an array or hashmap literal that never escapes, see compileBlock
+    bool scalarReplaced;
+};
+
+struct piccolo_DestructureNode {
+    struct piccolo_ExprNode expr;
+    // Declarations of the variables, linked through nextExpr
+    struct piccolo_VarDeclNode* first;
+    int count;
+    struct piccolo_ExprNode* value;
+    int charIdx;
 };
 
 struct piccolo_VarSetNode {
@@ -172,6 +196,8 @@ struct piccolo_CallNode {
     struct piccolo_ExprNode* function;
     struct piccolo_ExprNode* firstArg;
     int charIdx;
+    // Set by the compiler when the call's result is the result of the enclosing function
+    bool tailCall;
 };
 
 struct piccolo_ImportNode {
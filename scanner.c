@@ -28,6 +28,10 @@ static bool alphanumeric(char c) {
     return alpha(c) || numeric(c);
 }
 
+static bool hexDigit(char c) {
+    return numeric(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
 static enum piccolo_TokenType getKeyword(const char* start, const char* end) {
     #define TOKEN_TYPE(token, keyword)                                                        \
         if(end - start == strlen(keyword) && memcmp(start, keyword, strlen(keyword)) == 0) \
@@ -111,6 +115,10 @@ struct piccolo_Token piccolo_nextToken(struct piccolo_Scanner* scanner) {
                 scanner->current++;
                 return makeToken(scanner, PICCOLO_TOKEN_GREATER_EQ);
             }
+            if(*scanner->current == '>') {
+                scanner->current++;
+                return makeToken(scanner, PICCOLO_TOKEN_GREATER_GREATER);
+            }
             return makeToken(scanner, PICCOLO_TOKEN_GREATER);
         }
         case '<': {
@@ -119,6 +127,10 @@ struct piccolo_Token piccolo_nextToken(struct piccolo_Scanner* scanner) {
                 scanner->current++;
                 return makeToken(scanner, PICCOLO_TOKEN_LESS_EQ);
             }
+            if(*scanner->current == '<') {
+                scanner->current++;
+                return makeToken(scanner, PICCOLO_TOKEN_LESS_LESS);
+            }
             return makeToken(scanner, PICCOLO_TOKEN_LESS);
         }
         case '!': {
@@ -183,6 +195,22 @@ struct piccolo_Token piccolo_nextToken(struct piccolo_Scanner* scanner) {
             scanner->current++;
             return makeToken(scanner, PICCOLO_TOKEN_COLON);
         }
+        case '&': {
+            scanner->current++;
+            return makeToken(scanner, PICCOLO_TOKEN_AMPERSAND);
+        }
+        case '|': {
+            scanner->current++;
+            return makeToken(scanner, PICCOLO_TOKEN_PIPE);
+        }
+        case '^': {
+            scanner->current++;
+            return makeToken(scanner, PICCOLO_TOKEN_CARET);
+        }
+        case '~': {
+            scanner->current++;
+            return makeToken(scanner, PICCOLO_TOKEN_TILDE);
+        }
         case '\n': {
             scanner->current++;
             return makeToken(scanner, PICCOLO_TOKEN_NEWLINE);
@@ -193,10 +221,30 @@ struct piccolo_Token piccolo_nextToken(struct piccolo_Scanner* scanner) {
     }
 
     if(numeric(*scanner->start)) {
+        // Hex and binary literals are always ints
+        if(scanner->current[0] == '0' && (scanner->current[1] == 'x' || scanner->current[1] == 'X') && hexDigit(scanner->current[2])) {
+            scanner->current += 2;
+            while(hexDigit(*scanner->current))
+                scanner->current++;
+            return makeToken(scanner, PICCOLO_TOKEN_INT);
+        }
+        if(scanner->current[0] == '0' && (scanner->current[1] == 'b' || scanner->current[1] == 'B') && (scanner->current[2] == '0' || scanner->current[2] == '1')) {
+            scanner->current += 2;
+            while(*scanner->current == '0' || *scanner->current == '1')
+                scanner->current++;
+            return makeToken(scanner, PICCOLO_TOKEN_INT);
+        }
+
         while(numeric(*scanner->current)) {
             scanner->current++;
         }
 
+        // Decimal ints are marked with an i suffix, 3i
+        if(*scanner->current == 'i' && !alphanumeric(scanner->current[1])) {
+            scanner->current++;
+            return makeToken(scanner, PICCOLO_TOKEN_INT);
+        }
+
         bool hadPeriod = *scanner->current == '.';
         if(*scanner->current == '.')
             scanner->current++;
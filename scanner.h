@@ -17,15 +17,17 @@ enum piccolo_TokenType {
     PICCOLO_TOKEN_LEFT_BRACE, PICCOLO_TOKEN_RIGHT_BRACE,
     PICCOLO_TOKEN_DOT,
     PICCOLO_TOKEN_COLON,
+    PICCOLO_TOKEN_AMPERSAND, PICCOLO_TOKEN_PIPE, PICCOLO_TOKEN_CARET, PICCOLO_TOKEN_TILDE,
 
     // 2 chars
     PICCOLO_TOKEN_EQ_EQ, PICCOLO_TOKEN_BANG_EQ,
     PICCOLO_TOKEN_ARROW,
     PICCOLO_TOKEN_GREATER_EQ, PICCOLO_TOKEN_LESS_EQ,
     PICCOLO_TOKEN_DOT_DOT,
+    PICCOLO_TOKEN_LESS_LESS, PICCOLO_TOKEN_GREATER_GREATER,
 
     // Literals
-    PICCOLO_TOKEN_NUM, PICCOLO_TOKEN_NIL, PICCOLO_TOKEN_TRUE, PICCOLO_TOKEN_FALSE, PICCOLO_TOKEN_STRING,
+    PICCOLO_TOKEN_NUM, PICCOLO_TOKEN_INT, PICCOLO_TOKEN_NIL, PICCOLO_TOKEN_TRUE, PICCOLO_TOKEN_FALSE, PICCOLO_TOKEN_STRING,
 
     // Keywords
     PICCOLO_TOKEN_VAR, PICCOLO_TOKEN_CONST,
@@ -0,0 +1,58 @@
+#include "picStdlib.h"
+#include "../embedding.h"
+#include "../util/memory.h"
+
+static piccolo_Value createNative(struct piccolo_Engine* engine, int argc, piccolo_Value* argv, piccolo_Value self) {
+    if(!PICCOLO_IS_CLOSURE(argv[0])) {
+        piccolo_runtimeError(engine, "Coroutine must be created from a function.");
+        return PICCOLO_NIL_VAL();
+    }
+    struct piccolo_ObjClosure* closure = (struct piccolo_ObjClosure*)PICCOLO_AS_OBJ(argv[0]);
+    if(closure->prototype->arity > 1) {
+        piccolo_runtimeError(engine, "Coroutine function must take at most one parameter.");
+        return PICCOLO_NIL_VAL();
+    }
+    return PICCOLO_OBJ_VAL(piccolo_newCoroutine(engine, closure));
+}
+
+static piccolo_Value resumeNative(struct piccolo_Engine* engine, int argc, piccolo_Value* argv, piccolo_Value self) {
+    if(argc != 1 && argc != 2) {
+        piccolo_runtimeError(engine, "Wrong argument count.");
+        return PICCOLO_NIL_VAL();
+    }
+    if(!PICCOLO_IS_COROUTINE(argv[0])) {
+        piccolo_runtimeError(engine, "Cannot resume %s.", piccolo_getTypeName(argv[0]));
+        return PICCOLO_NIL_VAL();
+    }
+    struct piccolo_ObjCoroutine* coroutine = (struct piccolo_ObjCoroutine*)PICCOLO_AS_OBJ(argv[0]);
+    return piccolo_resumeCoroutine(engine, coroutine, argc == 2 ? argv[1] : PICCOLO_NIL_VAL());
+}
+
+static piccolo_Value yieldNative(struct piccolo_Engine* engine, int argc, piccolo_Value* argv, piccolo_Value self) {
+    if(argc > 1) {
+        piccolo_runtimeError(engine, "Wrong argument count.");
+        return PICCOLO_NIL_VAL();
+    }
+    piccolo_yieldCoroutine(engine);
+    return argc == 1 ? argv[0] : PICCOLO_NIL_VAL();
+}
+
+static piccolo_Value doneNative(struct piccolo_Engine* engine, int argc, piccolo_Value* argv, piccolo_Value self) {
+    if(!PICCOLO_IS_COROUTINE(argv[0])) {
+        piccolo_runtimeError(engine, "Expected a coroutine, got %s.", piccolo_getTypeName(argv[0]));
+        return PICCOLO_NIL_VAL();
+    }
+    struct piccolo_ObjCoroutine* coroutine = (struct piccolo_ObjCoroutine*)PICCOLO_AS_OBJ(argv[0]);
+    return PICCOLO_BOOL_VAL(coroutine->state == PICCOLO_COROUTINE_DONE);
+}
+
+void piccolo_addCoroutineLib(struct piccolo_Engine* engine) {
+    struct piccolo_Package* coroutine = piccolo_createPackage(engine);
+    coroutine->packageName = "coroutine";
+    struct piccolo_Type* any = piccolo_simpleType(engine, PICCOLO_TYPE_ANY);
+    struct piccolo_Type* boolType = piccolo_simpleType(engine, PICCOLO_TYPE_BOOL);
+    piccolo_defineGlobalWithType(engine, coroutine, "create", PICCOLO_OBJ_VAL(piccolo_makeNativeWithArity(engine, createNative, 1)), piccolo_makeFnType(engine, any, 1, any));
+    piccolo_defineGlobal(engine, coroutine, "resume", PICCOLO_OBJ_VAL(piccolo_makeNative(engine, resumeNative)));
+    piccolo_defineGlobal(engine, coroutine, "yield", PICCOLO_OBJ_VAL(piccolo_makeNative(engine, yieldNative)));
+    piccolo_defineGlobalWithType(engine, coroutine, "done", PICCOLO_OBJ_VAL(piccolo_makeNativeWithArity(engine, doneNative, 1)), piccolo_makeFnType(engine, boolType, 1, any));
+}
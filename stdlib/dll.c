@@ -2,7 +2,6 @@
 #include "../embedding.h"
 #include "../util/memory.h"
 #include "picStdlib.h"
-#include "../gc.h"
 #include "../util/file.h"
 #include <stdlib.h>
 #include <stdio.h>
@@ -20,16 +19,9 @@ struct dll {
 #else
     void* handle;
 #endif
-
-    piccolo_Value close, get;
-
 };
 
 static piccolo_Value dllCloseNative(struct piccolo_Engine* engine, int argc, piccolo_Value* argv, piccolo_Value self) {
-    if(argc != 0) {
-        piccolo_runtimeError(engine, "Wrong argument count.");
-        return PICCOLO_NIL_VAL();
-    }
     struct piccolo_Obj* obj = PICCOLO_AS_OBJ(self);
     struct dll* dll = PICCOLO_GET_PAYLOAD(obj, struct dll);
 #ifdef _WIN32
@@ -41,10 +33,6 @@ static piccolo_Value dllCloseNative(struct piccolo_Engine* engine, int argc, pic
 }
 
 static piccolo_Value dllGetNative(struct piccolo_Engine* engine, int argc, piccolo_Value* argv, piccolo_Value self) {
-    if(argc != 1) {
-        piccolo_runtimeError(engine, "Wrong argument count.");
-        return PICCOLO_NIL_VAL();
-    }
     piccolo_Value symbolNameVal = argv[0];
     if(!PICCOLO_IS_STRING(symbolNameVal)) {
         piccolo_runtimeError(engine, "Function name must be a string.");
@@ -72,42 +60,13 @@ static piccolo_Value dllGetNative(struct piccolo_Engine* engine, int argc, picco
     return PICCOLO_OBJ_VAL(piccolo_makeNative(engine, native));
 }
 
-static void gcMarkDll(void* payload) {
-    struct dll* dll = (struct dll*)payload;
-    piccolo_gcMarkValue(dll->close);
-    piccolo_gcMarkValue(dll->get);
-}
-
-static piccolo_Value indexDll(void* payload, struct piccolo_Engine* engine, piccolo_Value key, bool set, piccolo_Value value) {
-    struct dll* dll = (struct dll*)payload;
-    if(!PICCOLO_IS_STRING(key)) {
-        piccolo_runtimeError(engine, "Property must be a string.");
-        return PICCOLO_NIL_VAL();
-    }
-    struct piccolo_ObjString* keyStr = (struct piccolo_ObjString*)PICCOLO_AS_OBJ(key);
-    if(strcmp(keyStr->string, "close") == 0) {
-        if(set) {
-            piccolo_runtimeError(engine, "Cannot set close.");
-            return PICCOLO_NIL_VAL();
-        }
-        return dll->close;
-    }
-    if(strcmp(keyStr->string, "get") == 0) {
-        if(set) {
-            piccolo_runtimeError(engine, "Cannot set get.");
-            return PICCOLO_NIL_VAL();
-        }
-        return dll->get;
-    }
-    piccolo_runtimeError(engine, "Invalid property.");
-    return PICCOLO_NIL_VAL();
-}
+static const struct piccolo_NativeMethod dllMethods[] = {
+    {"close", dllCloseNative, 0},
+    {"get", dllGetNative, 1},
+    {NULL, NULL, 0}
+};
 
 static piccolo_Value openNative(struct piccolo_Engine* engine, int argc, piccolo_Value* argv, piccolo_Value self) {
-    if(argc != 1) {
-        piccolo_runtimeError(engine, "Wrong argument count.");
-        return PICCOLO_NIL_VAL();
-    }
     piccolo_Value pathVal = argv[0];
     if(!PICCOLO_IS_STRING(pathVal)) {
         piccolo_runtimeError(engine, "Argument must be a string.");
@@ -115,8 +74,7 @@ static piccolo_Value openNative(struct piccolo_Engine* engine, int argc, piccolo
     }
     char* path = ((struct piccolo_ObjString*)PICCOLO_AS_OBJ(pathVal))->string;
     struct piccolo_ObjNativeStruct* dllNativeStruct = (struct piccolo_ObjNativeStruct*)PICCOLO_ALLOCATE_NATIVE_STRUCT(engine, struct dll, "dll");
-    dllNativeStruct->gcMark = gcMarkDll;
-    dllNativeStruct->index = indexDll;
+    dllNativeStruct->methods = dllMethods;
     struct dll* dll = PICCOLO_GET_PAYLOAD(dllNativeStruct, struct dll);
 
 #ifdef _WIN32
@@ -152,8 +110,6 @@ static piccolo_Value openNative(struct piccolo_Engine* engine, int argc, piccolo
         }
     }
 #endif
-    dll->close = PICCOLO_OBJ_VAL(piccolo_makeBoundNative(engine, dllCloseNative, PICCOLO_OBJ_VAL(dllNativeStruct)));
-    dll->get = PICCOLO_OBJ_VAL(piccolo_makeBoundNative(engine, dllGetNative, PICCOLO_OBJ_VAL(dllNativeStruct)));
     return PICCOLO_OBJ_VAL(dllNativeStruct);
 }
 
@@ -162,7 +118,7 @@ void piccolo_addDLLLib(struct piccolo_Engine* engine) {
     dll->packageName = "dll";
     struct piccolo_Type* str = piccolo_simpleType(engine, PICCOLO_TYPE_STR);
     struct piccolo_Type* any = piccolo_simpleType(engine, PICCOLO_TYPE_ANY);
-    piccolo_defineGlobalWithType(engine, dll, "open", PICCOLO_OBJ_VAL(piccolo_makeNative(engine, openNative)), piccolo_makeFnType(engine, any, 1, str));
+    piccolo_defineGlobalWithType(engine, dll, "open", PICCOLO_OBJ_VAL(piccolo_makeNativeWithArity(engine, openNative, 1)), piccolo_makeFnType(engine, any, 1, str));
     #ifdef __APPLE__
     const char* extension = "dylib";
     #endif
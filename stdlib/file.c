@@ -2,16 +2,13 @@
 #include "picStdlib.h"
 #include "../util/file.h"
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
 #include "../embedding.h"
 #include "../gc.h"
 #include "../util/strutil.h"
 
 static piccolo_Value readNative(struct piccolo_Engine* engine, int argc, piccolo_Value* argv, piccolo_Value self) {
-    if(argc != 1) {
-        piccolo_runtimeError(engine, "Wrong argument count.");
-        return PICCOLO_NIL_VAL();
-    }
     piccolo_Value pathVal = argv[0];
     if(!PICCOLO_IS_STRING(pathVal)) {
         piccolo_runtimeError(engine, "Path must be a string.");
@@ -28,10 +25,6 @@ static piccolo_Value readNative(struct piccolo_Engine* engine, int argc, piccolo
 }
 
 static piccolo_Value writeNative(struct piccolo_Engine* engine, int argc, piccolo_Value* argv, piccolo_Value self) {
-    if(argc != 2) {
-        piccolo_runtimeError(engine, "Wrong argument count.");
-        return PICCOLO_NIL_VAL();
-    }
     piccolo_Value pathVal = argv[0];
     if(!PICCOLO_IS_STRING(pathVal)) {
         piccolo_runtimeError(engine, "Path must be a string.");
@@ -55,20 +48,20 @@ static piccolo_Value writeNative(struct piccolo_Engine* engine, int argc, piccol
 struct file {
     FILE* file;
     piccolo_Value path, mode;
-    piccolo_Value write, writeByte, readChar, close;
 };
 
 static void gcMarkFile(void* payload) {
     struct file* file = (struct file*)payload;
     piccolo_gcMarkValue(file->path);
     piccolo_gcMarkValue(file->mode);
-
-    piccolo_gcMarkValue(file->write);
-    piccolo_gcMarkValue(file->writeByte);
-    piccolo_gcMarkValue(file->readChar);
-    piccolo_gcMarkValue(file->close);
 }
 
+static const struct piccolo_NativeProperty fileProperties[] = {
+    {"path", offsetof(struct file, path)},
+    {"mode", offsetof(struct file, mode)},
+    {NULL, 0}
+};
+
 static piccolo_Value indexFile(void* payload, struct piccolo_Engine* engine, piccolo_Value key, bool set, piccolo_Value value) {
     struct file* file = (struct file*)payload;
     if(!PICCOLO_IS_STRING(key)) {
@@ -91,44 +84,11 @@ static piccolo_Value indexFile(void* payload, struct piccolo_Engine* engine, pic
         return file->mode;
     }
 
-    if(strcmp(keyStr->string, "write") == 0) {
-        if(set) {
-            piccolo_runtimeError(engine, "Cannot set write.");
-            return PICCOLO_NIL_VAL();
-        }
-        return file->write;
-    }
-    if(strcmp(keyStr->string, "writeByte") == 0) {
-        if(set) {
-            piccolo_runtimeError(engine, "Cannot set write.");
-            return PICCOLO_NIL_VAL();
-        }
-        return file->writeByte;
-    }
-    if(strcmp(keyStr->string, "readChar") == 0) {
-        if(set) {
-            piccolo_runtimeError(engine, "Cannot set readChar.");
-            return PICCOLO_NIL_VAL();
-        }
-        return file->readChar;
-    }
-    if(strcmp(keyStr->string, "close") == 0) {
-        if(set) {
-            piccolo_runtimeError(engine, "Cannot set close.");
-            return PICCOLO_NIL_VAL();
-        }
-        return file->close;
-    }
-
     piccolo_runtimeError(engine, "Invalid property.");
     return PICCOLO_NIL_VAL();
 }
 
 static piccolo_Value fileWriteNative(struct piccolo_Engine* engine, int argc, piccolo_Value* argv, piccolo_Value self) {
-    if(argc != 1) {
-        piccolo_runtimeError(engine, "Wrong argument count.");
-        return PICCOLO_NIL_VAL();
-    }
     piccolo_Value data = argv[0];
     if(!PICCOLO_IS_STRING(data)) {
         piccolo_runtimeError(engine, "Data must be a string.");
@@ -141,25 +101,17 @@ static piccolo_Value fileWriteNative(struct piccolo_Engine* engine, int argc, pi
 }
 
 static piccolo_Value fileWriteByteNative(struct piccolo_Engine* engine, int argc, piccolo_Value* argv, piccolo_Value self) {
-    if(argc != 1) {
-        piccolo_runtimeError(engine, "Wrong argument count.");
-        return PICCOLO_NIL_VAL();
-    }
     piccolo_Value byte = argv[0];
-    if(!PICCOLO_IS_NUM(byte)) {
+    if(!PICCOLO_IS_NUMERIC(byte)) {
         piccolo_runtimeError(engine, "Byte must be a number.");
         return PICCOLO_NIL_VAL();
     }
     struct file* file = PICCOLO_GET_PAYLOAD(PICCOLO_AS_OBJ(self), struct file);
-    fprintf(file->file, "%c", (int)PICCOLO_AS_NUM(byte));
+    fprintf(file->file, "%c", (int)PICCOLO_TO_NUM(byte));
     return PICCOLO_NIL_VAL();
 }
 
 static piccolo_Value fileReadCharNative(struct piccolo_Engine* engine, int argc, piccolo_Value* argv, piccolo_Value self) {
-    if(argc != 0) {
-        piccolo_runtimeError(engine, "Wrong argument count.");
-        return PICCOLO_NIL_VAL();
-    }
     struct file* file = PICCOLO_GET_PAYLOAD(PICCOLO_AS_OBJ(self), struct file);
     char c = fgetc(file->file);
     if(c == EOF) {
@@ -176,20 +128,55 @@ static piccolo_Value fileReadCharNative(struct piccolo_Engine* engine, int argc,
 }
 
 static piccolo_Value fileCloseNative(struct piccolo_Engine* engine, int argc, piccolo_Value* argv, piccolo_Value self) {
-    if(argc != 0) {
-        piccolo_runtimeError(engine, "Wrong argument count.");
-        return PICCOLO_NIL_VAL();
-    }
     struct file* file = PICCOLO_GET_PAYLOAD(PICCOLO_AS_OBJ(self), struct file);
     fclose(file->file);
     return PICCOLO_NIL_VAL();
 }
 
+static const struct piccolo_NativeMethod fileMethods[] = {
+    {"write", fileWriteNative, 1},
+    {"writeByte", fileWriteByteNative, 1},
+    {"readChar", fileReadCharNative, 0},
+    {"close", fileCloseNative, 0},
+    {NULL, NULL, 0}
+};
+
+// Files iterate over their remaining lines, the iterator is the line itself
+static piccolo_Value readLine(struct piccolo_Engine* engine, FILE* file) {
+    int c = fgetc(file);
+    if(c == EOF)
+        return PICCOLO_NIL_VAL();
+    int len = 0;
+    int capacity = 64;
+    char* line = PICCOLO_REALLOCATE("line", engine, NULL, 0, capacity);
+    while(c != EOF && c != '\n') {
+        if(len + 1 == capacity) {
+            line = PICCOLO_REALLOCATE("line", engine, line, capacity, capacity * 2);
+            capacity *= 2;
+        }
+        line[len++] = (char)c;
+        c = fgetc(file);
+    }
+    if(len > 0 && line[len - 1] == '\r')
+        len--;
+    struct piccolo_ObjString* lineStr = piccolo_copyString(engine, line, len);
+    PICCOLO_REALLOCATE("line", engine, line, capacity, 0);
+    return PICCOLO_OBJ_VAL(lineStr);
+}
+
+static piccolo_Value fileIterFirst(void* payload, struct piccolo_Engine* engine) {
+    return readLine(engine, ((struct file*)payload)->file);
+}
+
+static piccolo_Value fileIterNext(void* payload, struct piccolo_Engine* engine, piccolo_Value iterator) {
+    return readLine(engine, ((struct file*)payload)->file);
+}
+
+static piccolo_Value fileIterGet(void* payload, struct piccolo_Engine* engine, piccolo_Value iterator) {
+    return iterator;
+}
+
 static piccolo_Value openNative(struct piccolo_Engine* engine, int argc, piccolo_Value* argv, piccolo_Value self) {
-    if(argc != 2) {
-        piccolo_runtimeError(engine, "Wrong argument count.");
-        return PICCOLO_NIL_VAL();
-    }
     piccolo_Value pathVal = argv[0];
     if(!PICCOLO_IS_STRING(pathVal)) {
         piccolo_runtimeError(engine, "Path must be a string.");
@@ -219,16 +206,15 @@ static piccolo_Value openNative(struct piccolo_Engine* engine, int argc, piccolo
     struct piccolo_ObjNativeStruct* fileObj = (struct piccolo_ObjNativeStruct*)PICCOLO_ALLOCATE_NATIVE_STRUCT(engine, struct file, "file");
     fileObj->gcMark = gcMarkFile;
     fileObj->index = indexFile;
+    fileObj->properties = fileProperties;
+    fileObj->methods = fileMethods;
+    fileObj->iterFirst = fileIterFirst;
+    fileObj->iterNext = fileIterNext;
+    fileObj->iterGet = fileIterGet;
     struct file* payload = PICCOLO_GET_PAYLOAD(fileObj, struct file);
     payload->file = file;
     payload->path = pathVal;
     payload->mode = modeVal;
-
-    payload->write = PICCOLO_OBJ_VAL(piccolo_makeBoundNative(engine, fileWriteNative, PICCOLO_OBJ_VAL(fileObj)));
-    payload->writeByte = PICCOLO_OBJ_VAL(piccolo_makeBoundNative(engine, fileWriteByteNative, PICCOLO_OBJ_VAL(fileObj)));
-    payload->readChar = PICCOLO_OBJ_VAL(piccolo_makeBoundNative(engine, fileReadCharNative, PICCOLO_OBJ_VAL(fileObj)));
-    payload->close = PICCOLO_OBJ_VAL(piccolo_makeBoundNative(engine, fileCloseNative, PICCOLO_OBJ_VAL(fileObj)));
-
     return PICCOLO_OBJ_VAL(fileObj);
 }
 
@@ -236,7 +222,7 @@ void piccolo_addFileLib(struct piccolo_Engine* engine) {
     struct piccolo_Package* file = piccolo_createPackage(engine);
     file->packageName = "file";
     struct piccolo_Type* str = piccolo_simpleType(engine, PICCOLO_TYPE_STR);
-    piccolo_defineGlobalWithType(engine, file, "read", PICCOLO_OBJ_VAL(piccolo_makeNative(engine, readNative)), piccolo_makeFnType(engine, str, 1, str));
-    piccolo_defineGlobalWithType(engine, file, "write", PICCOLO_OBJ_VAL(piccolo_makeNative(engine, writeNative)), piccolo_makeFnType(engine, piccolo_simpleType(engine, PICCOLO_TYPE_NIL), 2, str, str));
-    piccolo_defineGlobalWithType(engine, file, "open", PICCOLO_OBJ_VAL(piccolo_makeNative(engine, openNative)), piccolo_makeFnType(engine, piccolo_simpleType(engine, PICCOLO_TYPE_ANY), 2, str, str));
+    piccolo_defineGlobalWithType(engine, file, "read", PICCOLO_OBJ_VAL(piccolo_makeNativeWithArity(engine, readNative, 1)), piccolo_makeFnType(engine, str, 1, str));
+    piccolo_defineGlobalWithType(engine, file, "write", PICCOLO_OBJ_VAL(piccolo_makeNativeWithArity(engine, writeNative, 2)), piccolo_makeFnType(engine, piccolo_simpleType(engine, PICCOLO_TYPE_NIL), 2, str, str));
+    piccolo_defineGlobalWithType(engine, file, "open", PICCOLO_OBJ_VAL(piccolo_makeNativeWithArity(engine, openNative, 2)), piccolo_makeFnType(engine, piccolo_simpleType(engine, PICCOLO_TYPE_ANY), 2, str, str));
 }
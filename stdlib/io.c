@@ -14,11 +14,6 @@ static piccolo_Value printNative(struct piccolo_Engine* engine, int argc, struct
 }
 
 static piccolo_Value inputNative(struct piccolo_Engine* engine, int argc, struct piccolo_Value* args, piccolo_Value self) {
-    if(argc != 0) {
-        piccolo_runtimeError(engine, "Wrong argument count.");
-        return PICCOLO_NIL_VAL();
-    }
-
     size_t lenMax = 64;
     size_t len = 0;
     char* line = (char*)PICCOLO_REALLOCATE("input string", engine, NULL, 0, lenMax);
@@ -49,5 +44,5 @@ void piccolo_addIOLib(struct piccolo_Engine* engine) {
     io->packageName = "io";
     struct piccolo_Type* str = piccolo_simpleType(engine, PICCOLO_TYPE_STR);
     piccolo_defineGlobal(engine, io, "print", PICCOLO_OBJ_VAL(piccolo_makeNative(engine, printNative)));
-    piccolo_defineGlobalWithType(engine, io, "input", PICCOLO_OBJ_VAL(piccolo_makeNative(engine, inputNative)), piccolo_makeFnType(engine, str, 0));
+    piccolo_defineGlobalWithType(engine, io, "input", PICCOLO_OBJ_VAL(piccolo_makeNativeWithArity(engine, inputNative, 0)), piccolo_makeFnType(engine, str, 0));
 }
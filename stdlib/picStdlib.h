@@ -12,5 +12,7 @@ void piccolo_addStrLib(struct piccolo_Engine* engine);
 void piccolo_addFileLib(struct piccolo_Engine* engine);
 void piccolo_addDLLLib(struct piccolo_Engine* engine);
 void piccolo_addOSLib(struct piccolo_Engine* engine);
+void piccolo_addCoroutineLib(struct piccolo_Engine* engine);
+void piccolo_addPipelineLib(struct piccolo_Engine* engine);
 
 #endif
@@ -0,0 +1,262 @@
+
+#include "picStdlib.h"
+#include "../embedding.h"
+#include "../gc.h"
+
+#include <limits.h>
+
+/*
+    Pipelines are native structs that pull elements from their source one at a time, so a chain
+    of them never holds more than the current element of every stage. A pipeline can be iterated
+    over again, which starts over from its source, but not by two loops at once.
+ */
+
+enum stageType {
+    STAGE_MAP,
+    STAGE_FILTER,
+    STAGE_TAKE,
+    STAGE_ZIP,
+    STAGE_CHUNK,
+};
+
+struct source {
+    piccolo_Value container;
+    piccolo_Value iterator;
+    bool started;
+    bool done;
+};
+
+struct stage {
+    enum stageType type;
+    struct source source;
+    // Second source of zip
+    struct source other;
+    piccolo_Value fn;
+    int count;
+    int taken;
+    piccolo_Value current;
+};
+
+static void gcMarkStage(void* payload) {
+    struct stage* stage = (struct stage*)payload;
+    piccolo_gcMarkValue(stage->source.container);
+    piccolo_gcMarkValue(stage->source.iterator);
+    piccolo_gcMarkValue(stage->other.container);
+    piccolo_gcMarkValue(stage->other.iterator);
+    piccolo_gcMarkValue(stage->fn);
+    piccolo_gcMarkValue(stage->current);
+}
+
+static void resetSource(struct source* source) {
+    source->iterator = PICCOLO_NIL_VAL();
+    source->started = false;
+    source->done = false;
+}
+
+// Moves the source to its next element, false once it has none left or raised an error
+static bool pull(struct piccolo_Engine* engine, struct source* source, piccolo_Value* value) {
+    if(source->done)
+        return false;
+    if(source->started)
+        source->iterator = piccolo_iterNext(engine, source->container, source->iterator);
+    else
+        source->iterator = piccolo_iterFirst(engine, source->container);
+    source->started = true;
+    if(engine->hadError || !piccolo_iterCont(engine, source->container, source->iterator)) {
+        source->done = true;
+        return false;
+    }
+    *value = piccolo_iterGet(engine, source->container, source->iterator);
+    return !engine->hadError;
+}
+
+static piccolo_Value callFn(struct piccolo_Engine* engine, piccolo_Value fn, piccolo_Value arg) {
+    if(PICCOLO_IS_CLOSURE(fn))
+        return piccolo_callFunction(engine, (struct piccolo_ObjClosure*)PICCOLO_AS_OBJ(fn), 1, &arg);
+    struct piccolo_ObjNativeFn* native = (struct piccolo_ObjNativeFn*)PICCOLO_AS_OBJ(fn);
+    return native->native(engine, 1, &arg, native->self);
+}
+
+static bool advance(struct piccolo_Engine* engine, struct stage* stage) {
+    piccolo_Value value;
+    switch(stage->type) {
+        case STAGE_MAP: {
+            if(!pull(engine, &stage->source, &value))
+                return false;
+            stage->current = callFn(engine, stage->fn, value);
+            return !engine->hadError;
+        }
+        case STAGE_FILTER: {
+            // current keeps the element alive while the predicate runs
+            while(pull(engine, &stage->source, &stage->current)) {
+                piccolo_Value keep = callFn(engine, stage->fn, stage->current);
+                if(engine->hadError)
+                    return false;
+                if(!PICCOLO_IS_BOOL(keep)) {
+                    piccolo_runtimeError(engine, "Filter function must return a bool.");
+                    return false;
+                }
+                if(PICCOLO_AS_BOOL(keep))
+                    return true;
+            }
+            return false;
+        }
+        case STAGE_TAKE: {
+            if(stage->taken >= stage->count || !pull(engine, &stage->source, &value))
+                return false;
+            stage->taken++;
+            stage->current = value;
+            return true;
+        }
+        case STAGE_ZIP: {
+            // current keeps the first element alive while the second source runs
+            if(!pull(engine, &stage->source, &stage->current) || !pull(engine, &stage->other, &value))
+                return false;
+            struct piccolo_ObjArray* pair = piccolo_newArray(engine, 2);
+            pair->array.values[0] = stage->current;
+            pair->array.values[1] = value;
+            stage->current = PICCOLO_OBJ_VAL(pair);
+            return true;
+        }
+        case STAGE_CHUNK: {
+            struct piccolo_ObjArray* chunk = piccolo_newArray(engine, 0);
+            stage->current = PICCOLO_OBJ_VAL(chunk);
+            // The source may run a collection that promotes the chunk
+            while(chunk->array.count < stage->count && pull(engine, &stage->source, &value)) {
+                piccolo_writeValueArray(engine, &chunk->array, value);
+                piccolo_gcWriteBarrier(engine, &chunk->obj, value);
+            }
+            return chunk->array.count > 0 && !engine->hadError;
+        }
+    }
+    return false;
+}
+
+static piccolo_Value stageIterFirst(void* payload, struct piccolo_Engine* engine) {
+    struct stage* stage = (struct stage*)payload;
+    resetSource(&stage->source);
+    resetSource(&stage->other);
+    stage->taken = 0;
+    return advance(engine, stage) ? PICCOLO_BOOL_VAL(true) : PICCOLO_NIL_VAL();
+}
+
+static piccolo_Value stageIterNext(void* payload, struct piccolo_Engine* engine, piccolo_Value iterator) {
+    return advance(engine, (struct stage*)payload) ? PICCOLO_BOOL_VAL(true) : PICCOLO_NIL_VAL();
+}
+
+static piccolo_Value stageIterGet(void* payload, struct piccolo_Engine* engine, piccolo_Value iterator) {
+    return ((struct stage*)payload)->current;
+}
+
+static bool isIterable(piccolo_Value value) {
+    if(PICCOLO_IS_ARRAY(value) || PICCOLO_IS_RANGE(value) || PICCOLO_IS_STRING(value) || PICCOLO_IS_HASHMAP(value))
+        return true;
+    return PICCOLO_IS_NATIVE_STRUCT(value) && ((struct piccolo_ObjNativeStruct*)PICCOLO_AS_OBJ(value))->iterFirst != NULL;
+}
+
+static piccolo_Value newStage(struct piccolo_Engine* engine, enum stageType type, piccolo_Value source) {
+    if(!isIterable(source)) {
+        piccolo_runtimeError(engine, "Cannot iterate over %s.", piccolo_getTypeName(source));
+        return PICCOLO_NIL_VAL();
+    }
+    struct piccolo_ObjNativeStruct* stageObj = (struct piccolo_ObjNativeStruct*)PICCOLO_ALLOCATE_NATIVE_STRUCT(engine, struct stage, "pipeline");
+    stageObj->gcMark = gcMarkStage;
+    stageObj->iterFirst = stageIterFirst;
+    stageObj->iterNext = stageIterNext;
+    stageObj->iterGet = stageIterGet;
+    struct stage* stage = PICCOLO_GET_PAYLOAD(stageObj, struct stage);
+    stage->type = type;
+    stage->source.container = source;
+    stage->other.container = PICCOLO_NIL_VAL();
+    resetSource(&stage->source);
+    resetSource(&stage->other);
+    stage->fn = PICCOLO_NIL_VAL();
+    stage->count = 0;
+    stage->taken = 0;
+    stage->current = PICCOLO_NIL_VAL();
+    return PICCOLO_OBJ_VAL(stageObj);
+}
+
+static bool checkFn(struct piccolo_Engine* engine, piccolo_Value fn) {
+    bool valid = false;
+    if(PICCOLO_IS_CLOSURE(fn)) {
+        valid = ((struct piccolo_ObjClosure*)PICCOLO_AS_OBJ(fn))->prototype->arity == 1;
+    } else if(PICCOLO_IS_NATIVE_FN(fn)) {
+        int arity = ((struct piccolo_ObjNativeFn*)PICCOLO_AS_OBJ(fn))->arity;
+        valid = arity == -1 || arity == 1;
+    }
+    if(!valid)
+        piccolo_runtimeError(engine, "Expected a function that takes one parameter.");
+    return valid;
+}
+
+static bool checkCount(struct piccolo_Engine* engine, piccolo_Value count) {
+    if(!PICCOLO_IS_NUMERIC(count) || PICCOLO_TO_NUM(count) < 0 || PICCOLO_TO_NUM(count) > INT_MAX) {
+        piccolo_runtimeError(engine, "Count must be a non negative number.");
+        return false;
+    }
+    return true;
+}
+
+static piccolo_Value mapNative(struct piccolo_Engine* engine, int argc, piccolo_Value* argv, piccolo_Value self) {
+    if(!checkFn(engine, argv[1]))
+        return PICCOLO_NIL_VAL();
+    piccolo_Value stage = newStage(engine, STAGE_MAP, argv[0]);
+    if(!PICCOLO_IS_NIL(stage))
+        PICCOLO_GET_PAYLOAD(PICCOLO_AS_OBJ(stage), struct stage)->fn = argv[1];
+    return stage;
+}
+
+static piccolo_Value filterNative(struct piccolo_Engine* engine, int argc, piccolo_Value* argv, piccolo_Value self) {
+    if(!checkFn(engine, argv[1]))
+        return PICCOLO_NIL_VAL();
+    piccolo_Value stage = newStage(engine, STAGE_FILTER, argv[0]);
+    if(!PICCOLO_IS_NIL(stage))
+        PICCOLO_GET_PAYLOAD(PICCOLO_AS_OBJ(stage), struct stage)->fn = argv[1];
+    return stage;
+}
+
+static piccolo_Value takeNative(struct piccolo_Engine* engine, int argc, piccolo_Value* argv, piccolo_Value self) {
+    if(!checkCount(engine, argv[1]))
+        return PICCOLO_NIL_VAL();
+    piccolo_Value stage = newStage(engine, STAGE_TAKE, argv[0]);
+    if(!PICCOLO_IS_NIL(stage))
+        PICCOLO_GET_PAYLOAD(PICCOLO_AS_OBJ(stage), struct stage)->count = (int)PICCOLO_TO_NUM(argv[1]);
+    return stage;
+}
+
+static piccolo_Value zipNative(struct piccolo_Engine* engine, int argc, piccolo_Value* argv, piccolo_Value self) {
+    if(!isIterable(argv[1])) {
+        piccolo_runtimeError(engine, "Cannot iterate over %s.", piccolo_getTypeName(argv[1]));
+        return PICCOLO_NIL_VAL();
+    }
+    piccolo_Value stage = newStage(engine, STAGE_ZIP, argv[0]);
+    if(!PICCOLO_IS_NIL(stage))
+        PICCOLO_GET_PAYLOAD(PICCOLO_AS_OBJ(stage), struct stage)->other.container = argv[1];
+    return stage;
+}
+
+static piccolo_Value chunkNative(struct piccolo_Engine* engine, int argc, piccolo_Value* argv, piccolo_Value self) {
+    if(!checkCount(engine, argv[1]))
+        return PICCOLO_NIL_VAL();
+    if(PICCOLO_TO_NUM(argv[1]) < 1) {
+        piccolo_runtimeError(engine, "Chunk size must be at least 1.");
+        return PICCOLO_NIL_VAL();
+    }
+    piccolo_Value stage = newStage(engine, STAGE_CHUNK, argv[0]);
+    if(!PICCOLO_IS_NIL(stage))
+        PICCOLO_GET_PAYLOAD(PICCOLO_AS_OBJ(stage), struct stage)->count = (int)PICCOLO_TO_NUM(argv[1]);
+    return stage;
+}
+
+void piccolo_addPipelineLib(struct piccolo_Engine* engine) {
+    struct piccolo_Package* pipeline = piccolo_createPackage(engine);
+    pipeline->packageName = "pipeline";
+    struct piccolo_Type* any = piccolo_simpleType(engine, PICCOLO_TYPE_ANY);
+    struct piccolo_Type* num = piccolo_simpleType(engine, PICCOLO_TYPE_NUM);
+    piccolo_defineGlobalWithType(engine, pipeline, "map", PICCOLO_OBJ_VAL(piccolo_makeNativeWithArity(engine, mapNative, 2)), piccolo_makeFnType(engine, any, 2, any, any));
+    piccolo_defineGlobalWithType(engine, pipeline, "filter", PICCOLO_OBJ_VAL(piccolo_makeNativeWithArity(engine, filterNative, 2)), piccolo_makeFnType(engine, any, 2, any, any));
+    piccolo_defineGlobalWithType(engine, pipeline, "take", PICCOLO_OBJ_VAL(piccolo_makeNativeWithArity(engine, takeNative, 2)), piccolo_makeFnType(engine, any, 2, any, num));
+    piccolo_defineGlobalWithType(engine, pipeline, "zip", PICCOLO_OBJ_VAL(piccolo_makeNativeWithArity(engine, zipNative, 2)), piccolo_makeFnType(engine, any, 2, any, any));
+    piccolo_defineGlobalWithType(engine, pipeline, "chunk", PICCOLO_OBJ_VAL(piccolo_makeNativeWithArity(engine, chunkNative, 2)), piccolo_makeFnType(engine, any, 2, any, num));
+}
@@ -6,12 +6,9 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <inttypes.h>
 
 static piccolo_Value getCodeNative(struct piccolo_Engine* engine, int argc, piccolo_Value* argv, piccolo_Value self) {
-    if(argc != 1) {
-        piccolo_runtimeError(engine, "Wrong argument count.");
-        return PICCOLO_NIL_VAL();
-    }
     piccolo_Value val = argv[0];
     if(!PICCOLO_IS_STRING(val)) {
         piccolo_runtimeError(engine, "Argument must be a string.");
@@ -40,17 +37,16 @@ static piccolo_Value getCodeNative(struct piccolo_Engine* engine, int argc, picc
 }
 
 static piccolo_Value numToStrNative(struct piccolo_Engine* engine, int argc, piccolo_Value* argv, piccolo_Value self) {
-    if(argc != 1) {
-        piccolo_runtimeError(engine, "Wrong argument count.");
-        return PICCOLO_NIL_VAL();
-    }
     piccolo_Value val = argv[0];
-    if(!PICCOLO_IS_NUM(val)) {
+    if(!PICCOLO_IS_NUMERIC(val)) {
         piccolo_runtimeError(engine, "Argument must be a number.");
         return PICCOLO_NIL_VAL();
     }
     char buf[32];
-    sprintf(buf, "%g", PICCOLO_AS_NUM(val));
+    if(PICCOLO_IS_INT(val))
+        sprintf(buf, "%" PRId64, PICCOLO_AS_INT(val));
+    else
+        sprintf(buf, "%g", PICCOLO_AS_NUM(val));
     return PICCOLO_OBJ_VAL(piccolo_copyString(engine, buf, strlen(buf)));
 }
 
@@ -59,6 +55,6 @@ void piccolo_addStrLib(struct piccolo_Engine* engine) {
     str->packageName = "str";
     struct piccolo_Type* strType = piccolo_simpleType(engine, PICCOLO_TYPE_STR);
     struct piccolo_Type* num = piccolo_simpleType(engine, PICCOLO_TYPE_NUM);
-    piccolo_defineGlobalWithType(engine, str, "utfCode", PICCOLO_OBJ_VAL(piccolo_makeNative(engine, getCodeNative)), piccolo_makeFnType(engine, num, 1, strType));
-    piccolo_defineGlobalWithType(engine, str, "numToStr", PICCOLO_OBJ_VAL(piccolo_makeNative(engine, numToStrNative)), piccolo_makeFnType(engine, strType, 1, num));
+    piccolo_defineGlobalWithType(engine, str, "utfCode", PICCOLO_OBJ_VAL(piccolo_makeNativeWithArity(engine, getCodeNative, 1)), piccolo_makeFnType(engine, num, 1, strType));
+    piccolo_defineGlobalWithType(engine, str, "numToStr", PICCOLO_OBJ_VAL(piccolo_makeNativeWithArity(engine, numToStrNative, 1)), piccolo_makeFnType(engine, strType, 1, num));
 }
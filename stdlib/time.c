@@ -6,23 +6,16 @@
 
 static piccolo_Value clockNative(struct piccolo_Engine* engine, int argc, struct piccolo_Value* args, piccolo_Value self) {
     double time = (double)clock() / (double)CLOCKS_PER_SEC;
-    if(argc != 0) {
-        piccolo_runtimeError(engine, "Wrong argument count.");
-    }
     return PICCOLO_NUM_VAL(time);
 }
 
 static piccolo_Value sleepNative(struct piccolo_Engine* engine, int argc, struct piccolo_Value* args, piccolo_Value self) {
-    if(argc != 1) {
-        piccolo_runtimeError(engine, "Wrong argument count.");
+    if(!PICCOLO_IS_NUMERIC(args[0])) {
+        piccolo_runtimeError(engine, "Sleep time must be a number.");
     } else {
-        if(!PICCOLO_IS_NUM(args[0])) {
-            piccolo_runtimeError(engine, "Sleep time must be a number.");
-        } else {
-            double time = PICCOLO_AS_NUM(args[0]);
-            clock_t startTime = clock();
-            while(clock() - startTime < time * CLOCKS_PER_SEC) {}
-        }
+        double time = PICCOLO_TO_NUM(args[0]);
+        clock_t startTime = clock();
+        while(clock() - startTime < time * CLOCKS_PER_SEC) {}
     }
     return PICCOLO_NIL_VAL();
 }
@@ -32,6 +25,6 @@ void piccolo_addTimeLib(struct piccolo_Engine* engine) {
     time->packageName = "time";
     struct piccolo_Type* num = piccolo_simpleType(engine, PICCOLO_TYPE_NUM);
     struct piccolo_Type* nil = piccolo_simpleType(engine, PICCOLO_TYPE_NIL);
-    piccolo_defineGlobalWithType(engine, time, "clock", PICCOLO_OBJ_VAL(piccolo_makeNative(engine, clockNative)), piccolo_makeFnType(engine, num, 0));
-    piccolo_defineGlobalWithType(engine, time, "sleep", PICCOLO_OBJ_VAL(piccolo_makeNative(engine, sleepNative)), piccolo_makeFnType(engine, nil, 1, num));
+    piccolo_defineGlobalWithType(engine, time, "clock", PICCOLO_OBJ_VAL(piccolo_makeNativeWithArity(engine, clockNative, 0)), piccolo_makeFnType(engine, num, 0));
+    piccolo_defineGlobalWithType(engine, time, "sleep", PICCOLO_OBJ_VAL(piccolo_makeNativeWithArity(engine, sleepNative, 1)), piccolo_makeFnType(engine, nil, 1, num));
 }
@@ -25,6 +25,10 @@ void piccolo_getTypename(struct piccolo_Type* type, char* dest) {
             sprintf(dest, "num");
             break;
         }
+        case PICCOLO_TYPE_INT: {
+            sprintf(dest, "int");
+            break;
+        }
         case PICCOLO_TYPE_STR: {
             sprintf(dest, "str");
             break;
@@ -43,6 +47,19 @@ void piccolo_getTypename(struct piccolo_Type* type, char* dest) {
             snprintf(dest, 256, "[%s]", buf);
             break;
         }
+        case PICCOLO_TYPE_TUPLE: {
+            dest += sprintf(dest, "(");
+            size_t sizeLeft = 256 - 1;
+            for(int i = 0; i < type->subtypes.tuple.types.count; i++) {
+                char buf[256];
+                piccolo_getTypename(type->subtypes.tuple.types.values[i], buf);
+                size_t taken = snprintf(dest, sizeLeft, i == 0 ? "%s" : ", %s", buf);
+                dest += taken;
+                sizeLeft -= taken;
+            }
+            snprintf(dest, sizeLeft, ")");
+            break;
+        }
         case PICCOLO_TYPE_HASHMAP: {
             char keyBuf[256];
             piccolo_getTypename(type->subtypes.hashmap.key, keyBuf);
@@ -141,6 +158,9 @@ void piccolo_freeType(struct piccolo_Engine* engine, struct piccolo_Type* type)
         piccolo_freeTokenArray(engine, &type->subtypes.hashmap.strKeys);
         piccolo_freeTypeArray(engine, &type->subtypes.hashmap.strTypes);
     }
+    if(type->type == PICCOLO_TYPE_TUPLE) {
+        piccolo_freeTypeArray(engine, &type->subtypes.tuple.types);
+    }
     if(type->type == PICCOLO_TYPE_UNION) {
         piccolo_freeTypeArray(engine, &type->subtypes.unionTypes.types);
     }
@@ -151,7 +171,11 @@ static bool isAny(struct piccolo_Type* type) {
 }
 
 static bool isNum(struct piccolo_Type* type) {
-    return type->type == PICCOLO_TYPE_NUM || type->type == PICCOLO_TYPE_ANY;
+    return type->type == PICCOLO_TYPE_NUM || type->type == PICCOLO_TYPE_INT || type->type == PICCOLO_TYPE_ANY;
+}
+
+static bool isInt(struct piccolo_Type* type) {
+    return type->type == PICCOLO_TYPE_INT;
 }
 
 static bool isStr(struct piccolo_Type* type) {
@@ -174,6 +198,10 @@ static bool isArr(struct piccolo_Type* type) {
     return type->type == PICCOLO_TYPE_ARRAY || type->type == PICCOLO_TYPE_ANY;
 }
 
+static bool isTuple(struct piccolo_Type* type) {
+    return type->type == PICCOLO_TYPE_TUPLE;
+}
+
 static bool isHashmap(struct piccolo_Type* type) {
     return type->type == PICCOLO_TYPE_HASHMAP || type->type == PICCOLO_TYPE_ANY;
 }
@@ -269,6 +297,20 @@ struct piccolo_Type* piccolo_fnType(struct piccolo_Engine* engine, struct piccol
     return fnType;
 }
 
+struct piccolo_Type* piccolo_tupleType(struct piccolo_Engine* engine, struct piccolo_TypeArray* types) {
+    struct piccolo_Type* curr = engine->types;
+    while(curr != NULL) {
+        if(curr->type == PICCOLO_TYPE_TUPLE && typeArrEq(&curr->subtypes.tuple.types, types)) {
+            piccolo_freeTypeArray(engine, types);
+            return curr;
+        }
+        curr = curr->next;
+    }
+    struct piccolo_Type* tupleType = allocType(engine, PICCOLO_TYPE_TUPLE);
+    tupleType->subtypes.tuple.types = *types;
+    return tupleType;
+}
+
 struct piccolo_Type* piccolo_pkgType(struct piccolo_Engine* engine, struct piccolo_Package* pkg) {
     struct piccolo_Type* curr = engine->types;
     while(curr != NULL) {
@@ -301,6 +343,8 @@ static bool isSubtype(struct piccolo_Type* super, struct piccolo_Type* sub) {
         return true;
     if(super == sub)
         return true;
+    if(super->type == PICCOLO_TYPE_NUM && sub->type == PICCOLO_TYPE_INT)
+        return true;
     if(super->type == PICCOLO_TYPE_UNION) {
         if(sub->type == PICCOLO_TYPE_UNION) {
             for(int i = 0; i < sub->subtypes.unionTypes.types.count; i++) {
@@ -326,6 +370,23 @@ static bool isSubtype(struct piccolo_Type* super, struct piccolo_Type* sub) {
         if(sub->type == PICCOLO_TYPE_ARRAY) {
             return isSubtype(super->subtypes.listElem, sub->subtypes.listElem);
         }
+        // Tuples that are not destructured right away are arrays
+        if(sub->type == PICCOLO_TYPE_TUPLE) {
+            for(int i = 0; i < sub->subtypes.tuple.types.count; i++)
+                if(!isSubtype(super->subtypes.listElem, sub->subtypes.tuple.types.values[i]))
+                    return false;
+            return true;
+        }
+    }
+    if(super->type == PICCOLO_TYPE_TUPLE) {
+        if(sub->type == PICCOLO_TYPE_TUPLE) {
+            if(super->subtypes.tuple.types.count != sub->subtypes.tuple.types.count)
+                return false;
+            for(int i = 0; i < sub->subtypes.tuple.types.count; i++)
+                if(!isSubtype(super->subtypes.tuple.types.values[i], sub->subtypes.tuple.types.values[i]))
+                    return false;
+            return true;
+        }
     }
     if(super->type == PICCOLO_TYPE_HASHMAP) {
         if(sub->type == PICCOLO_TYPE_HASHMAP) {
@@ -400,11 +461,20 @@ static struct piccolo_Type* mergeTypes(struct piccolo_Engine* engine, struct pic
     return piccolo_unionType(engine, &res); // TODO: add union type
 }
 
+// Arithmetic on two ints stays exact, anything involving a num is done on nums
+static struct piccolo_Type* arithmeticType(struct piccolo_Engine* engine, struct piccolo_Type* aType, struct piccolo_Type* bType) {
+    if(aType->type == PICCOLO_TYPE_NUM || bType->type == PICCOLO_TYPE_NUM)
+        return piccolo_simpleType(engine, PICCOLO_TYPE_NUM);
+    if(isInt(aType) && isInt(bType))
+        return piccolo_simpleType(engine, PICCOLO_TYPE_INT);
+    return piccolo_simpleType(engine, PICCOLO_TYPE_ANY);
+}
+
 static struct piccolo_Type* getSubscriptType(struct piccolo_Engine* engine, struct piccolo_Compiler* compiler, struct piccolo_Type* valType, struct piccolo_Token* subscript) {
     #define IS_SUBSCRIPT(str) (subscript->length == strlen(str) && memcmp(str, subscript->start, subscript->length) == 0)
     if(isAny(valType)) {
         return piccolo_simpleType(engine, PICCOLO_TYPE_ANY);
-    } else if(isArr(valType) || isStr(valType)) {
+    } else if(isArr(valType) || isTuple(valType) || isStr(valType)) {
         if(IS_SUBSCRIPT("length")) {
             return piccolo_simpleType(engine, PICCOLO_TYPE_NUM);
         }
@@ -444,6 +514,12 @@ static struct piccolo_Type* getIndexType(struct piccolo_Engine* engine, struct p
     if(isArr(targetType) && isNum(indexType)) {
         return targetType->subtypes.listElem;
     }
+    if(isTuple(targetType) && isNum(indexType)) {
+        struct piccolo_Type* elemType = NULL;
+        for(int i = 0; i < targetType->subtypes.tuple.types.count; i++)
+            elemType = mergeTypes(engine, elemType, targetType->subtypes.tuple.types.values[i]);
+        return elemType;
+    }
     if(isStr(targetType) && isNum(indexType))
         return piccolo_simpleType(engine, PICCOLO_TYPE_STR);
     if(isHashmap(targetType)) {
@@ -464,6 +540,23 @@ static struct piccolo_Type* getIndexType(struct piccolo_Engine* engine, struct p
     return piccolo_simpleType(engine, PICCOLO_TYPE_ANY);
 }
 
+// The type of one of the values a destructuring declaration takes apart
+static struct piccolo_Type* unpackedType(struct piccolo_Engine* engine, struct piccolo_Type* valType, int idx) {
+    if(isTuple(valType) && idx < valType->subtypes.tuple.types.count)
+        return valType->subtypes.tuple.types.values[idx];
+    if(valType->type == PICCOLO_TYPE_ARRAY)
+        return valType->subtypes.listElem;
+    return piccolo_simpleType(engine, PICCOLO_TYPE_ANY);
+}
+
+static struct piccolo_Type* getDeclType(struct piccolo_Engine* engine, struct piccolo_Compiler* compiler, struct piccolo_VarDeclNode* decl) {
+    if(!decl->typed)
+        return piccolo_simpleType(engine, PICCOLO_TYPE_ANY);
+    if(decl->unpackIdx != -1)
+        return piccolo_getType(engine, compiler, (struct piccolo_ExprNode*)decl);
+    return piccolo_getType(engine, compiler, decl->value);
+}
+
 static struct piccolo_Type* getType(struct piccolo_Engine* engine, struct piccolo_Compiler* compiler, struct piccolo_ExprNode* expr) {
     switch(expr->type) {
         case PICCOLO_EXPR_LITERAL: {
@@ -471,6 +564,8 @@ static struct piccolo_Type* getType(struct piccolo_Engine* engine, struct piccol
             switch(literal->token.type) {
                 case PICCOLO_TOKEN_NUM:
                     return piccolo_simpleType(engine, PICCOLO_TYPE_NUM);
+                case PICCOLO_TOKEN_INT:
+                    return piccolo_simpleType(engine, PICCOLO_TYPE_INT);
                 case PICCOLO_TOKEN_STRING:
                     return piccolo_simpleType(engine, PICCOLO_TYPE_STR);
                 case PICCOLO_TOKEN_FALSE:
@@ -536,7 +631,7 @@ static struct piccolo_Type* getType(struct piccolo_Engine* engine, struct piccol
             struct piccolo_VarNode* var = (struct piccolo_VarNode*)expr;
             if(var->decl == NULL)
                 return piccolo_simpleType(engine, PICCOLO_TYPE_ANY);
-            return var->decl->typed ? piccolo_getType(engine, compiler, var->decl->value) : piccolo_simpleType(engine, PICCOLO_TYPE_ANY);
+            return getDeclType(engine, compiler, var->decl);
         }
         case PICCOLO_EXPR_RANGE: {
             struct piccolo_RangeNode* range = (struct piccolo_RangeNode*)expr;
@@ -568,7 +663,7 @@ static struct piccolo_Type* getType(struct piccolo_Engine* engine, struct piccol
             switch(unary->op.type) {
                 case PICCOLO_TOKEN_MINUS: {
                     if(isNum(valType)) {
-                        return piccolo_simpleType(engine, PICCOLO_TYPE_NUM);
+                        return piccolo_simpleType(engine, isInt(valType) ? PICCOLO_TYPE_INT : PICCOLO_TYPE_NUM);
                     } else {
                         char buf[256];
                         piccolo_getTypename(valType, buf);
@@ -586,6 +681,16 @@ static struct piccolo_Type* getType(struct piccolo_Engine* engine, struct piccol
                         return piccolo_simpleType(engine, PICCOLO_TYPE_ANY);
                     }
                 }
+                case PICCOLO_TOKEN_TILDE: {
+                    if(isNum(valType)) {
+                        return piccolo_simpleType(engine, PICCOLO_TYPE_INT);
+                    } else {
+                        char buf[256];
+                        piccolo_getTypename(valType, buf);
+                        piccolo_compilationError(engine, compiler, unary->op.charIdx, "Cannot complement %s.", buf);
+                        return piccolo_simpleType(engine, PICCOLO_TYPE_ANY);
+                    }
+                }
             }
         }
         case PICCOLO_EXPR_BINARY: {
@@ -601,7 +706,7 @@ static struct piccolo_Type* getType(struct piccolo_Engine* engine, struct piccol
             switch(binary->op.type) {
                 case PICCOLO_TOKEN_PLUS: {
                     if(isNum(aType) && isNum(bType)) {
-                        return piccolo_simpleType(engine, PICCOLO_TYPE_NUM);
+                        return arithmeticType(engine, aType, bType);
                     }
                     if(isStr(aType) && isStr(bType)) {
                         return piccolo_simpleType(engine, PICCOLO_TYPE_STR);
@@ -614,27 +719,30 @@ static struct piccolo_Type* getType(struct piccolo_Engine* engine, struct piccol
                 }
                 case PICCOLO_TOKEN_MINUS: {
                     if(isNum(aType) && isNum(bType)) {
-                        return piccolo_simpleType(engine, PICCOLO_TYPE_NUM);
+                        return arithmeticType(engine, aType, bType);
                     }
                     piccolo_compilationError(engine, compiler, binary->op.charIdx, "Cannot subtract %s from %s.", bBuf, aBuf);
                     break;
                 }
                 case PICCOLO_TOKEN_SLASH: {
                     if(isNum(aType) && isNum(bType)) {
-                        return piccolo_simpleType(engine, PICCOLO_TYPE_NUM);
+                        return arithmeticType(engine, aType, bType);
                     }
                     piccolo_compilationError(engine, compiler, binary->op.charIdx, "Cannot divide %s by %s.", aBuf, bBuf);
                     break;
                 }
                 case PICCOLO_TOKEN_PERCENT: {
                     if(isNum(aType) && isNum(bType)) {
-                        return piccolo_simpleType(engine, PICCOLO_TYPE_NUM);
+                        return arithmeticType(engine, aType, bType);
                     }
                     piccolo_compilationError(engine, compiler, binary->op.charIdx, "Cannot modulo %s by %s.", aBuf, bBuf);
                     break;
                 }
                 case PICCOLO_TOKEN_STAR: {
-                    if(isNum(aType) && (isNum(bType) || isStr(bType) || isArr(bType))) {
+                    if(isNum(aType) && isNum(bType)) {
+                        return arithmeticType(engine, aType, bType);
+                    }
+                    if(isNum(aType) && (isStr(bType) || isArr(bType))) {
                         return bType;
                     }
                     if(isNum(bType) && (isNum(aType) || isStr(aType) || isArr(aType))) {
@@ -643,6 +751,17 @@ static struct piccolo_Type* getType(struct piccolo_Engine* engine, struct piccol
                     piccolo_compilationError(engine, compiler, binary->op.charIdx, "Cannot multiply %s by %s.", aBuf, bBuf);
                     break;
                 }
+                case PICCOLO_TOKEN_AMPERSAND:
+                case PICCOLO_TOKEN_PIPE:
+                case PICCOLO_TOKEN_CARET:
+                case PICCOLO_TOKEN_LESS_LESS:
+                case PICCOLO_TOKEN_GREATER_GREATER: {
+                    if(isNum(aType) && isNum(bType)) {
+                        return piccolo_simpleType(engine, PICCOLO_TYPE_INT);
+                    }
+                    piccolo_compilationError(engine, compiler, binary->op.charIdx, "Cannot apply '%.*s' to %s and %s.", binary->op.length, binary->op.start, aBuf, bBuf);
+                    break;
+                }
                 case PICCOLO_TOKEN_AND: {
                     if(isBool(aType) && isBool(bType)) {
                         return piccolo_simpleType(engine, PICCOLO_TYPE_BOOL);
@@ -697,16 +816,36 @@ static struct piccolo_Type* getType(struct piccolo_Engine* engine, struct piccol
             struct piccolo_Type* resType = piccolo_getType(engine, compiler, fn->value);
             return piccolo_fnType(engine, &paramTypes, resType);
         }
+        case PICCOLO_EXPR_TUPLE: {
+            struct piccolo_TupleNode* tuple = (struct piccolo_TupleNode*)expr;
+            struct piccolo_TypeArray elemTypes;
+            piccolo_initTypeArray(&elemTypes);
+            for(struct piccolo_ExprNode* curr = tuple->first; curr != NULL; curr = curr->nextExpr)
+                piccolo_writeTypeArray(engine, &elemTypes, piccolo_getType(engine, compiler, curr));
+            return piccolo_tupleType(engine, &elemTypes);
+        }
         case PICCOLO_EXPR_VAR_DECL: {
             struct piccolo_VarDeclNode* varDecl = (struct piccolo_VarDeclNode*)expr;
+            if(varDecl->unpackIdx != -1)
+                return unpackedType(engine, piccolo_getType(engine, compiler, varDecl->value), varDecl->unpackIdx);
             return piccolo_getType(engine, compiler, varDecl->value);
         }
+        case PICCOLO_EXPR_DESTRUCTURE: {
+            struct piccolo_DestructureNode* destructure = (struct piccolo_DestructureNode*)expr;
+            struct piccolo_Type* valType = piccolo_getType(engine, compiler, destructure->value);
+            if(isTuple(valType) ? valType->subtypes.tuple.types.count != destructure->count : !isArr(valType)) {
+                char buf[256];
+                piccolo_getTypename(valType, buf);
+                piccolo_compilationError(engine, compiler, destructure->charIdx, "Cannot destructure %s into %d variables.", buf, destructure->count);
+            }
+            return piccolo_simpleType(engine, PICCOLO_TYPE_NIL);
+        }
         case PICCOLO_EXPR_VAR_SET: {
             struct piccolo_VarSetNode* varSet = (struct piccolo_VarSetNode*)expr;
             struct piccolo_Type* valType = piccolo_getType(engine, compiler, varSet->value);
             if(varSet->decl == NULL || !varSet->decl->typed)    
                 return piccolo_simpleType(engine, PICCOLO_TYPE_ANY);
-            struct piccolo_Type* targetType = piccolo_getType(engine, compiler, varSet->decl->value);
+            struct piccolo_Type* targetType = getDeclType(engine, compiler, varSet->decl);
             if(!isSubtype(targetType, valType)) {
                 char varTypeBuf[256];
                 piccolo_getTypename(targetType, varTypeBuf);
@@ -769,7 +908,7 @@ static struct piccolo_Type* getType(struct piccolo_Engine* engine, struct piccol
             struct piccolo_ForNode* forNode = (struct piccolo_ForNode*)expr;
             struct piccolo_Type* containerType = piccolo_getType(engine, compiler, forNode->container);
             struct piccolo_Type* valType = piccolo_getType(engine, compiler, forNode->value);
-            if(!isArr(containerType) && !isHashmap(containerType) && !isStr(containerType)) {
+            if(!isArr(containerType) && !isTuple(containerType) && !isHashmap(containerType) && !isStr(containerType)) {
                 char buf[256];
                 piccolo_getTypename(containerType, buf);
                 piccolo_compilationError(engine, compiler, forNode->containerCharIdx, "Cannot iterate over %s.", buf);
@@ -10,11 +10,13 @@ PICCOLO_DYNARRAY_HEADER(struct piccolo_Token, Token)
 enum piccolo_TypeType {
     PICCOLO_TYPE_ANY,
     PICCOLO_TYPE_NUM,
+    PICCOLO_TYPE_INT,
     PICCOLO_TYPE_STR,
     PICCOLO_TYPE_BOOL,
     PICCOLO_TYPE_NIL,
 
     PICCOLO_TYPE_ARRAY,
+    PICCOLO_TYPE_TUPLE,
     PICCOLO_TYPE_HASHMAP,
 
     PICCOLO_TYPE_FN,
@@ -41,6 +43,9 @@ struct piccolo_Type {
             struct piccolo_Type* result;
             struct piccolo_TypeArray params;
         } fn;
+        struct {
+            struct piccolo_TypeArray types;
+        } tuple;
         struct {
             struct piccolo_TypeArray types;
         } unionTypes;
@@ -57,6 +62,7 @@ struct piccolo_ExprNode;
 
 struct piccolo_Type* piccolo_simpleType(struct piccolo_Engine* engine, enum piccolo_TypeType type);
 struct piccolo_Type* piccolo_arrayType(struct piccolo_Engine* engine, struct piccolo_Type* elemType);
+struct piccolo_Type* piccolo_tupleType(struct piccolo_Engine* engine, struct piccolo_TypeArray* types);
 struct piccolo_Type* piccolo_hashmapType(struct piccolo_Engine* engine, struct piccolo_Type* keyType, struct piccolo_Type* valType, struct piccolo_TokenArray* strKeys, struct piccolo_TypeArray* strTypes);
 struct piccolo_Type* piccolo_fnType(struct piccolo_Engine* engine, struct piccolo_TypeArray* params, struct piccolo_Type* res);
 struct piccolo_Type* piccolo_pkgType(struct piccolo_Engine* engine, struct piccolo_Package* pkg);
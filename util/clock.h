@@ -0,0 +1,10 @@
+
+#ifndef PICCOLO_CLOCK_H
+#define PICCOLO_CLOCK_H
+
+#include <stdint.h>
+
+// Microseconds of a monotonic wall clock, only differences between two readings mean anything
+int64_t piccolo_monotonicUsecs();
+
+#endif
@@ -7,6 +7,11 @@
 
 void* piccolo_reallocate(struct piccolo_Engine* engine, void* data, size_t oldSize, size_t newSize) {
     engine->liveMemory += newSize - oldSize;
+    if(newSize > oldSize) {
+        engine->youngMemory += newSize - oldSize;
+        if(engine->youngMemory > engine->nurserySize)
+            engine->gcPending = true;
+    }
     if(newSize == 0) {
         free(data);
         return NULL;
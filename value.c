@@ -6,6 +6,7 @@
 #include "debug/disassembler.h"
 
 #include <string.h>
+#include <inttypes.h>
 
 PICCOLO_DYNARRAY_IMPL(piccolo_Value, Value)
 
@@ -30,6 +31,16 @@ static void printObject(struct piccolo_Obj* obj) {
         }
         printf("]");
     }
+    if(obj->type == PICCOLO_OBJ_RANGE) {
+        struct piccolo_ObjRange* range = (struct piccolo_ObjRange*)obj;
+        printf("[");
+        for(int i = range->start; i < range->end; i++) {
+            piccolo_printValue(PICCOLO_NUM_VAL(i));
+            if(i < range->end - 1)
+                printf(", ");
+        }
+        printf("]");
+    }
     if(obj->type == PICCOLO_OBJ_HASHMAP) {
         struct piccolo_ObjHashmap* hashmap = (struct piccolo_ObjHashmap*)obj;
         printf("{");
@@ -56,6 +67,9 @@ static void printObject(struct piccolo_Obj* obj) {
     if(obj->type == PICCOLO_OBJ_CLOSURE) {
         printf("<fn>");
     }
+    if(obj->type == PICCOLO_OBJ_COROUTINE) {
+        printf("<coroutine>");
+    }
     if(obj->type == PICCOLO_OBJ_NATIVE_FN) {
         printf("<native fn>");
     }
@@ -79,6 +93,10 @@ void piccolo_printValue(piccolo_Value value) {
         printf("%g", PICCOLO_AS_NUM(value));
         return;
     }
+    if(PICCOLO_IS_INT(value)) {
+        printf("%" PRId64, PICCOLO_AS_INT(value));
+        return;
+    }
     if(PICCOLO_IS_BOOL(value)) {
         printf(PICCOLO_AS_BOOL(value) ? "true" : "false");
         return;
@@ -95,6 +113,9 @@ char* piccolo_getTypeName(piccolo_Value value) {
     if(PICCOLO_IS_NUM(value)) {
         return "num";
     }
+    if(PICCOLO_IS_INT(value)) {
+        return "int";
+    }
     if(PICCOLO_IS_BOOL(value)) {
         return "bool";
     }
@@ -102,7 +123,8 @@ char* piccolo_getTypeName(piccolo_Value value) {
         enum piccolo_ObjType type = PICCOLO_AS_OBJ(value)->type;
         if(type == PICCOLO_OBJ_STRING)
             return "str";
-        if(type == PICCOLO_OBJ_ARRAY)
+        // Ranges are arrays as far as the language is concerned
+        if(type == PICCOLO_OBJ_ARRAY || type == PICCOLO_OBJ_RANGE)
             return "array";
         if(type == PICCOLO_OBJ_HASHMAP)
             return "hashmap";
@@ -110,6 +132,8 @@ char* piccolo_getTypeName(piccolo_Value value) {
             return "raw fn";
         if(type == PICCOLO_OBJ_CLOSURE)
             return "fn";
+        if(type == PICCOLO_OBJ_COROUTINE)
+            return "coroutine";
         if(type == PICCOLO_OBJ_NATIVE_FN)
             return "native fn";
         if(type == PICCOLO_OBJ_PACKAGE)
@@ -118,10 +142,26 @@ char* piccolo_getTypeName(piccolo_Value value) {
     return "Unknown";
 }
 
+// An int is only equal to a num holding exactly the same integer
+static bool intEqualsNum(int64_t integer, double num) {
+    if(!(num >= -9223372036854775808.0 && num < 9223372036854775808.0))
+        return false;
+    return (int64_t)num == integer && (double)(int64_t)num == num;
+}
+
 bool piccolo_valuesEqual(struct piccolo_Value a, struct piccolo_Value b) {
     if(PICCOLO_IS_NUM(a) && PICCOLO_IS_NUM(b)) {
         return PICCOLO_AS_NUM(a) == PICCOLO_AS_NUM(b);
     }
+    if(PICCOLO_IS_INT(a) && PICCOLO_IS_INT(b)) {
+        return PICCOLO_AS_INT(a) == PICCOLO_AS_INT(b);
+    }
+    if(PICCOLO_IS_INT(a) && PICCOLO_IS_NUM(b)) {
+        return intEqualsNum(PICCOLO_AS_INT(a), PICCOLO_AS_NUM(b));
+    }
+    if(PICCOLO_IS_NUM(a) && PICCOLO_IS_INT(b)) {
+        return intEqualsNum(PICCOLO_AS_INT(b), PICCOLO_AS_NUM(a));
+    }
     if(PICCOLO_IS_BOOL(a) && PICCOLO_IS_BOOL(b)) {
         return PICCOLO_AS_BOOL(a) == PICCOLO_AS_BOOL(b);
     }
@@ -3,12 +3,98 @@
 #define PICCOLO_VALUE_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "util/dynarray.h"
 
+struct piccolo_Engine;
+
+//#define PICCOLO_ENABLE_NAN_BOXING
+
+#ifdef PICCOLO_ENABLE_NAN_BOXING
+
+#include <string.h>
+
+/*
+    Values are packed into a single 64 bit word. Anything that is not a quiet NaN with the
+    PICCOLO_QNAN bits set is a number. Nil and the booleans are quiet NaNs with a small tag in the
+    low bits, and objects are quiet NaNs with the sign bit set and the pointer in the low 48 bits.
+    Ints that fit in 48 bits are quiet NaNs with PICCOLO_TAG_INT set, larger ones are boxed.
+ */
+
+#define PICCOLO_SIGN_BIT ((uint64_t)0x8000000000000000)
+#define PICCOLO_QNAN ((uint64_t)0x7ffc000000000000)
+
+#define PICCOLO_TAG_NIL 1
+#define PICCOLO_TAG_FALSE 2
+#define PICCOLO_TAG_TRUE 3
+
+#define PICCOLO_TAG_INT ((uint64_t)0x0002000000000000)
+#define PICCOLO_INT_PAYLOAD ((uint64_t)0x0000ffffffffffff)
+
+struct piccolo_Value {
+    uint64_t bits;
+};
+
+typedef struct piccolo_Value piccolo_Value;
+
+static inline double piccolo_valueToNum(piccolo_Value value) {
+    double num;
+    memcpy(&num, &value.bits, sizeof(double));
+    return num;
+}
+
+static inline piccolo_Value piccolo_numToValue(double num) {
+    piccolo_Value value;
+    memcpy(&value.bits, &num, sizeof(double));
+    return value;
+}
+
+bool piccolo_isBoxedInt(piccolo_Value value);
+int64_t piccolo_unboxInt(piccolo_Value value);
+piccolo_Value piccolo_boxInt(struct piccolo_Engine* engine, int64_t integer);
+
+static inline bool piccolo_isInlineInt(piccolo_Value value) {
+    return (value.bits & (PICCOLO_SIGN_BIT | PICCOLO_QNAN | PICCOLO_TAG_INT)) == (PICCOLO_QNAN | PICCOLO_TAG_INT);
+}
+
+static inline int64_t piccolo_valueToInt(piccolo_Value value) {
+    if(piccolo_isInlineInt(value))
+        return (int64_t)(value.bits << 16) >> 16;
+    return piccolo_unboxInt(value);
+}
+
+static inline piccolo_Value piccolo_intToValue(struct piccolo_Engine* engine, int64_t integer) {
+    if((int64_t)((uint64_t)integer << 16) >> 16 == integer) {
+        piccolo_Value value = {PICCOLO_QNAN | PICCOLO_TAG_INT | ((uint64_t)integer & PICCOLO_INT_PAYLOAD)};
+        return value;
+    }
+    return piccolo_boxInt(engine, integer);
+}
+
+#define PICCOLO_IS_NIL(value) ((value).bits == (PICCOLO_QNAN | PICCOLO_TAG_NIL))
+#define PICCOLO_IS_NUM(value) (((value).bits & PICCOLO_QNAN) != PICCOLO_QNAN)
+#define PICCOLO_IS_BOOL(value) (((value).bits | 1) == (PICCOLO_QNAN | PICCOLO_TAG_TRUE))
+#define PICCOLO_IS_OBJ(value) (((value).bits & (PICCOLO_QNAN | PICCOLO_SIGN_BIT)) == (PICCOLO_QNAN | PICCOLO_SIGN_BIT))
+#define PICCOLO_IS_INT(value) (piccolo_isInlineInt(value) || (PICCOLO_IS_OBJ(value) && piccolo_isBoxedInt(value)))
+
+#define PICCOLO_AS_NUM(value) (piccolo_valueToNum(value))
+#define PICCOLO_AS_BOOL(value) ((value).bits == (PICCOLO_QNAN | PICCOLO_TAG_TRUE))
+#define PICCOLO_AS_OBJ(value) ((struct piccolo_Obj*)(uintptr_t)((value).bits & ~(PICCOLO_SIGN_BIT | PICCOLO_QNAN)))
+#define PICCOLO_AS_INT(value) (piccolo_valueToInt(value))
+
+#define PICCOLO_NIL_VAL() ((piccolo_Value){PICCOLO_QNAN | PICCOLO_TAG_NIL})
+#define PICCOLO_NUM_VAL(num) (piccolo_numToValue(num))
+#define PICCOLO_BOOL_VAL(bool) ((piccolo_Value){(bool) ? (PICCOLO_QNAN | PICCOLO_TAG_TRUE) : (PICCOLO_QNAN | PICCOLO_TAG_FALSE)})
+#define PICCOLO_OBJ_VAL(object) ((piccolo_Value){PICCOLO_SIGN_BIT | PICCOLO_QNAN | (uint64_t)(uintptr_t)(object)})
+#define PICCOLO_INT_VAL(engine, integer) (piccolo_intToValue(engine, integer))
+
+#else
+
 enum piccolo_ValueType {
     PICCOLO_VALUE_NIL,
     PICCOLO_VALUE_NUMBER,
+    PICCOLO_VALUE_INT,
     PICCOLO_VALUE_BOOL,
     PICCOLO_VALUE_OBJ,
 };
@@ -17,6 +103,7 @@ struct piccolo_Value {
     enum piccolo_ValueType type;
     union {
         double number;
+        int64_t integer;
         bool boolean;
         struct piccolo_Obj* obj;
     } as;
@@ -24,19 +111,28 @@ struct piccolo_Value {
 
 typedef struct piccolo_Value piccolo_Value;
 
-#define PICCOLO_IS_NIL(value) (value.type == PICCOLO_VALUE_NIL)
-#define PICCOLO_IS_NUM(value) (value.type == PICCOLO_VALUE_NUMBER)
-#define PICCOLO_IS_BOOL(value) (value.type == PICCOLO_VALUE_BOOL)
-#define PICCOLO_IS_OBJ(value) (value.type == PICCOLO_VALUE_OBJ)
+#define PICCOLO_IS_NIL(value) ((value).type == PICCOLO_VALUE_NIL)
+#define PICCOLO_IS_NUM(value) ((value).type == PICCOLO_VALUE_NUMBER)
+#define PICCOLO_IS_BOOL(value) ((value).type == PICCOLO_VALUE_BOOL)
+#define PICCOLO_IS_OBJ(value) ((value).type == PICCOLO_VALUE_OBJ)
+#define PICCOLO_IS_INT(value) ((value).type == PICCOLO_VALUE_INT)
 
-#define PICCOLO_AS_NUM(value) (value.as.number)
-#define PICCOLO_AS_BOOL(value) (value.as.boolean)
-#define PICCOLO_AS_OBJ(value) (value.as.obj)
+#define PICCOLO_AS_NUM(value) ((value).as.number)
+#define PICCOLO_AS_BOOL(value) ((value).as.boolean)
+#define PICCOLO_AS_OBJ(value) ((value).as.obj)
+#define PICCOLO_AS_INT(value) ((value).as.integer)
 
 #define PICCOLO_NIL_VAL() ((piccolo_Value){PICCOLO_VALUE_NIL, {.number = 0}})
 #define PICCOLO_NUM_VAL(num) ((piccolo_Value){PICCOLO_VALUE_NUMBER, {.number = (num)}})
 #define PICCOLO_BOOL_VAL(bool) ((piccolo_Value){PICCOLO_VALUE_BOOL, {.boolean = (bool)}})
 #define PICCOLO_OBJ_VAL(object)((piccolo_Value){PICCOLO_VALUE_OBJ, {.obj = ((struct piccolo_Obj*)object)}})
+#define PICCOLO_INT_VAL(engine, i) ((piccolo_Value){PICCOLO_VALUE_INT, {.integer = (i)}})
+
+#endif
+
+// Natives that take a number accept both nums and ints
+#define PICCOLO_IS_NUMERIC(value) (PICCOLO_IS_NUM(value) || PICCOLO_IS_INT(value))
+#define PICCOLO_TO_NUM(value) (PICCOLO_IS_INT(value) ? (double)PICCOLO_AS_INT(value) : PICCOLO_AS_NUM(value))
 
 PICCOLO_DYNARRAY_HEADER(piccolo_Value, Value)
 